@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "adaptive.h"
+
+static const char *const metric_names[ADAPT_N_METRICS] = {
+    "delivery ratio", "retransmissions/pkt", "average delay (s)",
+};
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// the counters of the whole run so far, a batch is the difference of two of them
+static void totals(const SimContext *ctx, AdaptBatch *t) {
+    const Sender   *s  = &ctx->sender;
+    const Receiver *rv = &ctx->receiver;
+    long deliveries = 0;
+    t->logical = t->unique = 0;
+    for (int f = 0; f < s->n_flows; f++) {
+        t->logical += s->sent[f] + s->lost_local[f];
+        t->unique  += rv->unique_ok[f];
+        deliveries += rv->received_ok[f];
+    }
+    t->retransmissions = deliveries - t->unique;
+    network_totals(&ctx->net, &t->sum_delay, &t->count_delay);
+}
+
+void adaptive_init(AdaptiveStop *a, const SimContext *ctx, const SimConfig *cfg, double precision, double batch_s) {
+    memset(a, 0, sizeof(*a));
+    a->precision = precision;
+    if (!(batch_s > 0.0)) {
+        double interval = cfg->send_interval;
+        if (cfg->n_intervals > 0) {
+            interval = 0.0;
+            for (int i = 0; i < cfg->n_intervals; i++) interval += cfg->intervals[i];
+            interval /= cfg->n_intervals;
+        }
+        batch_s = ADAPT_BATCH_SENDS * interval;
+    }
+    a->batch = sim_ticks(ctx, batch_s);
+    if (a->batch < 1) a->batch = 1;
+}
+
+static void add_batch(AdaptiveStop *a, const AdaptBatch *d) {
+    if (a->n == ADAPT_MAX_BATCHES) {
+        // every batch is full: two neighbours become one, and the next batches are as long
+        for (int i = 0; i < ADAPT_MAX_BATCHES / 2; i++) {
+            const AdaptBatch *p = &a->b[2 * i], *q = &a->b[2 * i + 1];
+            AdaptBatch *m = &a->b[i];
+            m->logical         = p->logical + q->logical;
+            m->unique          = p->unique + q->unique;
+            m->retransmissions = p->retransmissions + q->retransmissions;
+            m->sum_delay       = p->sum_delay + q->sum_delay;
+            m->count_delay     = p->count_delay + q->count_delay;
+        }
+        a->n = ADAPT_MAX_BATCHES / 2;
+        a->batch *= 2;
+        a->merges++;
+    }
+    a->b[a->n++] = *d;
+}
+
+// MSER: the d <= n/2 that minimises the variance of the mean of x[d..n), from suffix sums in O(n)
+static int mser_truncation(const double *x, int n) {
+    double sum = 0.0, sq = 0.0, best = INFINITY;
+    int    best_d = 0;
+    for (int d = n - 1; d >= 0; d--) {
+        sum += x[d];
+        sq  += x[d] * x[d];
+        if (d > n / 2) continue;
+        int    m  = n - d;
+        double ss = sq - sum * sum / m;
+        double stat = (ss > 0.0 ? ss : 0.0) / ((double)m * m);
+        if (stat <= best) {   // <=: the smallest d wins a tie, nothing is discarded without a reason
+            best   = stat;
+            best_d = d;
+        }
+    }
+    return best_d;
+}
+
+// the warm-up and the intervals over the rest, 1 if every interval is narrow enough
+static int precise_enough(AdaptiveStop *a) {
+    for (int i = 0; i < a->n; i++) {
+        const AdaptBatch *d = &a->b[i];
+        a->x[0][i] = (double)d->unique / d->logical;
+        a->x[1][i] = (double)d->retransmissions / d->unique;
+        a->x[2][i] = d->sum_delay / d->count_delay;
+    }
+    a->warmup = 0;
+    for (int m = 0; m < ADAPT_N_METRICS; m++) {
+        int d = mser_truncation(a->x[m], a->n);
+        if (d > a->warmup) a->warmup = d;
+    }
+    int kept = a->n - a->warmup;
+    int ok = kept >= ADAPT_MIN_BATCHES;
+    for (int m = 0; m < ADAPT_N_METRICS; m++) {
+        estimate(a->x[m] + a->warmup, kept, &a->est[m]);
+        ok = ok && a->est[m].ci95 <= a->precision * fabs(a->est[m].mean);
+    }
+    return ok;
+}
+
+void adaptive_run(SimContext *ctx, AdaptiveStop *a) {
+    double start = wall_seconds();
+    AdaptBatch prev, cur;
+    totals(ctx, &prev);
+    SimTime end = ctx->now + a->batch;
+    while (!ctx->stop) {
+        sim_run_until(ctx, end);
+        if (ctx->stop || sim_next_time(ctx) == SIM_TIME_MAX) break;
+        end += a->batch;
+        totals(ctx, &cur);
+        AdaptBatch d = {
+            .logical         = cur.logical - prev.logical,
+            .unique          = cur.unique - prev.unique,
+            .retransmissions = cur.retransmissions - prev.retransmissions,
+            .sum_delay       = cur.sum_delay - prev.sum_delay,
+            .count_delay     = cur.count_delay - prev.count_delay,
+        };
+        if (d.logical < ADAPT_BATCH_PKTS || d.unique < ADAPT_BATCH_PKTS || d.count_delay <= 0)
+            continue;   // too few packets yet: the batch goes on
+        prev = cur;
+        add_batch(a, &d);
+        if (precise_enough(a)) {
+            a->reached     = 1;
+            a->stop_time   = sim_seconds(ctx, ctx->now);
+            a->stop_events = ctx->events;
+            // no new packet from now on, the ones in flight still go through their protocol
+            for (int f = ctx->flow_lo; f < ctx->flow_hi; f++)
+                if (ctx->sender.duration[f] > ctx->now) ctx->sender.duration[f] = ctx->now;
+            break;
+        }
+    }
+    sim_run(ctx);
+    if (!a->reached) {
+        if (a->n > 0) precise_enough(a);   // the estimates of what was run, for the report
+        a->stop_time   = sim_seconds(ctx, ctx->now);
+        a->stop_events = ctx->events;
+    }
+    a->wall = wall_seconds() - start;
+}
+
+void adaptive_print_report(const AdaptiveStop *a, const SimContext *ctx) {
+    double batch_s = sim_seconds(ctx, a->batch);
+    if (a->reached)
+        printf("\nAdaptive stop: %.2f%% precision reached at t = %.6f s after %ld events\n",
+               100.0 * a->precision, a->stop_time, a->stop_events);
+    else
+        printf("\nAdaptive stop: %.2f%% precision NOT reached, the flows ended at t = %.6f s after %ld events\n",
+               100.0 * a->precision, a->stop_time, a->stop_events);
+    printf("Batches: %d of at least %.6f s (%d merges), %d discarded as warm-up (MSER), %.3f s wall for the whole run\n",
+           a->n, batch_s, a->merges, a->warmup, a->wall);
+    if (a->n - a->warmup < 2) {
+        printf("too few batches for an interval (at least %d after the warm-up)\n", ADAPT_MIN_BATCHES);
+        return;
+    }
+    printf("%-24s %14s %14s %14s   %s\n", "metric", "mean", "ci95 (+/-)", "relative", "95% interval");
+    for (int m = 0; m < ADAPT_N_METRICS; m++) {
+        const Estimate *e = &a->est[m];
+        double rel = e->mean != 0.0 ? e->ci95 / fabs(e->mean) : 0.0;
+        printf("%-24s %14.6f %14.6f %13.2f%%   [%.6f, %.6f]\n",
+               metric_names[m], e->mean, e->ci95, 100.0 * rel, e->mean - e->ci95, e->mean + e->ci95);
+    }
+}
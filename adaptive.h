@@ -0,0 +1,69 @@
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+#include "sim.h"
+#include "replicate.h"
+
+/*
+Adaptive stopping (sim --precision R [--batch S]): the run goes on until its estimates are
+precise enough instead of until the end of the sending duration, which becomes an upper bound.
+
+The run is cut in batches of S simulated seconds (50 send intervals by default). Each batch
+gives one value of each metric of the summary, from the counters added during the batch:
+    delivery ratio    unique packets / logical packets
+    retransmissions   duplicate deliveries per unique packet
+    average delay     one-way network delay
+A batch with fewer than ADAPT_BATCH_PKTS packets sent or received gives no value, it goes on
+into the next one (a ratio of a few packets is a biased estimate of the ratio of the totals).
+Only ADAPT_MAX_BATCHES batches are kept: when they are all used, neighbours are merged two by
+two and the batches are twice as long from then on. A check costs the same however long the
+run, and longer batches are also less correlated with each other, as batch means assume.
+
+The first batches hold the handshake and the start of the flows. The warm-up is cut with
+MSER (White's marginal standard error rule): for every d up to half the batches, the variance
+of the mean of batches d.. is measured as sum of squared deviations / (n - d)^2, and the d
+with the smallest one is where the transient ends. Each metric gets its own d, the largest one
+is discarded from all three.
+
+After each batch, once ADAPT_MIN_BATCHES batches are left past the warm-up, the batch means
+give a 95% confidence interval (Student t, see estimate in replicate.h). The run stops when
+the half-width of every metric is at most R times its mean: the senders stop producing, the
+packets already in flight are finished off, then the usual summary is printed.
+*/
+
+#define ADAPT_N_METRICS   3
+#define ADAPT_MIN_BATCHES 10    // kept after the warm-up before an interval is trusted
+#define ADAPT_MAX_BATCHES 256   // then two neighbours become one batch
+#define ADAPT_BATCH_SENDS 50    // default batch length in send intervals
+#define ADAPT_BATCH_PKTS  50    // fewest packets sent and received in a batch
+
+// what happened during one batch: the differences of the counters of the summary
+typedef struct {
+    long   logical;
+    long   unique;
+    long   retransmissions;
+    double sum_delay;
+    long   count_delay;
+} AdaptBatch;
+
+typedef struct AdaptiveStop {
+    double     precision;                        // largest relative half-width of the 95% intervals
+    SimTime    batch;                            // ticks, doubled at every merge
+    int        merges;
+    AdaptBatch b[ADAPT_MAX_BATCHES];
+    double     x[ADAPT_N_METRICS][ADAPT_MAX_BATCHES];   // value of every metric in every batch
+    int        n;                                // batches
+    int        warmup;                           // batches discarded at the start
+    int        reached;                          // 1 = stopped on precision, 0 = the duration ran out first
+    Estimate   est[ADAPT_N_METRICS];             // over the batches after the warm-up
+    double     stop_time;                        // simulated seconds when the estimates were final
+    long       stop_events;                      // events handled by then
+    double     wall;                             // wall seconds of the whole run
+} AdaptiveStop;
+
+// batch_s <= 0: ADAPT_BATCH_SENDS send intervals of cfg
+void adaptive_init(AdaptiveStop *a, const SimContext *ctx, const SimConfig *cfg, double precision, double batch_s);
+// runs ctx (from sim_init or a restore) until the precision is reached or every flow has finished
+void adaptive_run(SimContext *ctx, AdaptiveStop *a);
+void adaptive_print_report(const AdaptiveStop *a, const SimContext *ctx);
+
+#endif
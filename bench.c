@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "sim.h"
+
+/*
+Benchmarks of the event engine, one CSV line per measurement on stdout:
+
+  hold      classic hold model straight on heap_insert/pop_next_event: the queue is filled
+            with `pending` events, then every operation pops the earliest one and inserts it
+            again at time + exponential(1). The pending set stays the same size.
+  schedule  schedule_event + pop + release through a SimContext, by bursts of `pending`
+            events (what a handler and the main loop pay per event).
+  sim       whole runs of the simulator (--quiet) for a few sizes.
+
+ns_per_event and events_per_sec count one pop + one insert as one event. Each measurement
+runs in a child process of its own (fork), so peak_rss_kb (getrusage) is the peak of that
+measurement: the pages of the parent it starts with, the same for every line, plus its own.
+
+usage: sim_bench [--quick] [--seed N]
+*/
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;   // kilobytes on Linux
+}
+
+/* 1 in a new child process, which runs one measurement and exits; 0 in the parent, once that
+   child is done. The parent never allocates anything big, so every child starts the same. */
+static int in_child(void) {
+    fflush(stdout);   // or the child would print the parent's buffered lines again
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("sim_bench: fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) return 1;
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "sim_bench: a measurement failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+static void report(const char *bench, const char *backend, const char *param, long pending,
+                   long events, double seconds) {
+    printf("%s,%s,%s,%ld,%ld,%.6f,%.2f,%.0f,%ld\n", bench, backend, param, pending, events, seconds,
+           events > 0 ? seconds * 1e9 / events : 0.0, seconds > 0.0 ? events / seconds : 0.0, peak_rss_kb());
+    fflush(stdout);
+}
+
+typedef struct {
+    const char *name;
+    QueueKind   kind;
+    int         arity;
+} Backend;
+
+static const Backend backends[] = {
+    { "heap",     QUEUE_BINARY_HEAP, 2 },
+    { "dary2",    QUEUE_DARY_HEAP,   2 },
+    { "dary4",    QUEUE_DARY_HEAP,   4 },
+    { "dary8",    QUEUE_DARY_HEAP,   8 },
+    { "calendar", QUEUE_CALENDAR,    4 },
+};
+#define N_BACKENDS (int)(sizeof(backends) / sizeof(backends[0]))
+
+#define HOLD_MEAN_TICKS 1000000.0   // mean of the exponential increments (1 ms at 1 ns per tick)
+
+static SimTime exp_sample(Rng *r) {
+    return (SimTime)(-log(1.0 - frand01(r)) * HOLD_MEAN_TICKS);
+}
+
+static Event *new_event(EventQueue *q, SimTime time, unsigned long long seq) {
+    Event *e = event_pool_alloc(&q->pool);
+    if (!e) {
+        fprintf(stderr, "sim_bench: event pool exhausted\n");
+        exit(EXIT_FAILURE);
+    }
+    e->time      = time;
+    e->src       = 0;
+    e->dst       = 0;
+    e->packet_id = 0;
+    e->handler   = H_NONE;
+    e->seq       = seq;
+    return e;
+}
+
+static void bench_hold(const Backend *b, long pending, long ops, unsigned long long seed) {
+    EventQueue q;
+    Rng rng;
+    rng_seed(&rng, seed, 0, 0);
+    event_queue_init(&q, b->kind, b->arity, 0);
+    unsigned long long seq = 0;
+    for (long i = 0; i < pending; i++)
+        heap_insert(&q, new_event(&q, exp_sample(&rng), seq++));
+
+    double start = wall_seconds();
+    for (long i = 0; i < ops; i++) {
+        Event *e = pop_next_event(&q);
+        e->time += exp_sample(&rng);   // the popped event is reused, like a handler scheduling its successor
+        e->seq   = seq++;
+        heap_insert(&q, e);
+    }
+    double seconds = wall_seconds() - start;
+    char param[32];
+    snprintf(param, sizeof(param), "arity=%d", b->arity);
+    report("hold", b->name, param, pending, ops, seconds);
+    event_queue_destroy(&q);
+}
+
+static void bench_schedule(const Backend *b, long burst, long total, unsigned long long seed) {
+    SimConfig cfg;
+    sim_config_default(&cfg);
+    cfg.trace_level = TRACE_OFF;
+    cfg.queue_kind  = b->kind;
+    cfg.queue_arity = b->arity;
+    SimContext *ctx = malloc(sizeof(SimContext));
+    if (!ctx || !sim_alloc(ctx, &cfg, seed, 0)) {
+        fprintf(stderr, "sim_bench: cannot set up a context\n");
+        exit(EXIT_FAILURE);
+    }
+    Rng rng;
+    rng_seed(&rng, seed, 1, 0);
+
+    long done = 0;
+    double start = wall_seconds();
+    while (done < total) {
+        for (long i = 0; i < burst; i++)
+            schedule_event(ctx, ctx->now + exp_sample(&rng), 0, 0, 0, H_NONE);
+        for (long i = 0; i < burst; i++) {
+            Event *e = pop_next_event(&ctx->queue);
+            ctx->now = e->time;
+            event_release(ctx, e);
+        }
+        done += burst;
+    }
+    double seconds = wall_seconds() - start;
+    char param[32];
+    snprintf(param, sizeof(param), "arity=%d", b->arity);
+    report("schedule", b->name, param, burst, done, seconds);
+    sim_destroy(ctx);
+    free(ctx);
+}
+
+typedef struct {
+    double interval;
+    double duration;
+    int    flows;
+} Scenario;
+
+static void bench_sim(const Backend *b, const Scenario *sc, unsigned long long seed) {
+    SimConfig cfg;
+    sim_config_default(&cfg);
+    cfg.trace_level   = TRACE_OFF;
+    cfg.queue_kind    = b->kind;
+    cfg.queue_arity   = b->arity;
+    cfg.send_interval = sc->interval;
+    cfg.duration      = sc->duration;
+    cfg.n_flows       = sc->flows;
+    SimContext *ctx = malloc(sizeof(SimContext));
+    double start = wall_seconds();
+    if (!ctx || !sim_init(ctx, &cfg, seed, 0)) {
+        fprintf(stderr, "sim_bench: cannot set up %d flows\n", sc->flows);
+        exit(EXIT_FAILURE);
+    }
+    sim_run(ctx);
+    double seconds = wall_seconds() - start;
+    char param[64];
+    snprintf(param, sizeof(param), "interval=%g duration=%g flows=%d", sc->interval, sc->duration, sc->flows);
+    // the pending set of a real run changes all the time, its high-water mark is reported
+    report("sim", b->name, param, ctx->queue.pool.high_water, ctx->events, seconds);
+    sim_destroy(ctx);
+    free(ctx);
+}
+
+int main(int argc, char **argv) {
+    int quick = 0;
+    unsigned long long seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) quick = 1;                               // smaller sizes, a few seconds
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+    }
+    static const long hold_sizes[] = { 1000, 10000, 100000, 1000000 };
+    static const Scenario scenarios[] = {
+        { 0.05,   1.0,   1 },
+        { 0.001,  10.0,  1 },
+        { 0.01,   2.0,   1000 },
+        { 0.01,   1.0,   20000 },
+    };
+    int n_hold      = quick ? 3 : 4;
+    int n_scenarios = quick ? 3 : 4;
+    long hold_ops   = quick ? 200000 : 2000000;
+
+    printf("bench,backend,param,pending,events,seconds,ns_per_event,events_per_sec,peak_rss_kb\n");
+    for (int b = 0; b < N_BACKENDS; b++)
+        for (int i = 0; i < n_hold; i++)
+            if (in_child()) {
+                bench_hold(&backends[b], hold_sizes[i], hold_ops, seed);
+                exit(0);
+            }
+    for (int b = 0; b < N_BACKENDS; b++)
+        for (int k = 0; k < 2; k++)
+            if (in_child()) {
+                bench_schedule(&backends[b], k == 0 ? 16 : 4096, hold_ops, seed);
+                exit(0);
+            }
+    for (int b = 0; b < N_BACKENDS; b++)
+        for (int i = 0; i < n_scenarios; i++)
+            if (in_child()) {
+                bench_sim(&backends[b], &scenarios[i], seed);
+                exit(0);
+            }
+    return 0;
+}
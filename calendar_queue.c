@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include "calendar_queue.h"
+
+#define CQ_MIN_BUCKETS 16
+#define CQ_SAMPLE      25   // how many of the next events are used to estimate the width
+
+#define CQ_INIT_WIDTH  (1LL << 30)   // ticks, about a second at 1 ns per tick until the first resize measures it
+
+static long long cq_day(const CalendarQueue *q, SimTime t) {
+    return t / q->width;
+}
+
+static int cq_bucket(const CalendarQueue *q, SimTime t) {
+    return (int)(cq_day(q, t) & (q->nbuckets - 1));
+}
+
+// the side array of links must be able to hold any pool index the pool can give
+static int cq_ensure_next(CalendarQueue *q, int idx) {
+    if (idx < q->next_cap) return 1;
+    int new_cap = q->next_cap * 2;
+    if (new_cap <= idx) new_cap = idx + EVENT_POOL_CHUNK;
+    int *new_next = realloc(q->next, new_cap * sizeof(int));
+    if (!new_next) return 0;
+    q->next     = new_next;
+    q->next_cap = new_cap;
+    return 1;
+}
+
+// allocates nbuckets empty buckets (the old array is freed by the caller)
+static int cq_alloc_buckets(CalendarQueue *q, int nbuckets) {
+    int *head = malloc(nbuckets * sizeof(int));
+    if (!head) return 0;
+    for (int b = 0; b < nbuckets; b++) head[b] = -1;
+    q->head     = head;
+    q->nbuckets = nbuckets;
+    return 1;
+}
+
+// sorted insert in the bucket list, after every event with the same time (FIFO ties)
+static void cq_link(CalendarQueue *q, Event *e) {
+    int b = cq_bucket(q, e->time);
+    int *link = &q->head[b];
+    int depth = 0;
+    while (*link >= 0 && !event_before(e, event_pool_at(q->pool, *link))) {
+        link = &q->next[*link];
+        depth++;
+    }
+    PROF_SIFT(q->link_walk, depth);
+    q->next[e->pool_idx] = *link;
+    *link = e->pool_idx;
+}
+
+// finds the bucket whose head is the earliest event (size > 0), remembered in peek_bucket/peek_day
+static void cq_find_min(CalendarQueue *q) {
+    int b = q->last_bucket;
+    long long day = q->cur_day;
+    // one year of days starting at the current one
+    for (int n = 0; n < q->nbuckets; n++) {
+        int idx = q->head[b];
+        if (idx >= 0 && cq_day(q, event_pool_at(q->pool, idx)->time) <= day) {
+            q->peek_bucket = b;
+            q->peek_day    = day;
+            PROF_SIFT(q->day_scan, n + 1);
+            return;
+        }
+        b = (b + 1) & (q->nbuckets - 1);
+        day++;
+    }
+    // nothing in the whole year (events are sparse): direct search of the smallest head
+    Event *best = NULL;
+    for (int i = 0; i < q->nbuckets; i++) {
+        if (q->head[i] < 0) continue;
+        Event *e = event_pool_at(q->pool, q->head[i]);
+        if (!best || event_before(e, best)) { best = e; q->peek_bucket = i; }
+    }
+    q->peek_day = cq_day(q, best->time);
+    PROF_SIFT(q->day_scan, 2 * q->nbuckets);   // a whole year, then every head
+}
+
+// removes and returns the earliest event, without triggering a resize
+static Event* cq_unlink_min(CalendarQueue *q) {
+    if (q->size == 0) return NULL;
+    if (q->peek_bucket < 0) cq_find_min(q);   // a cq_peek since the last change already found it
+    int b   = q->peek_bucket;
+    int idx = q->head[b];
+    q->head[b]     = q->next[idx];
+    q->last_bucket = b;
+    q->cur_day     = q->peek_day;
+    q->size--;
+    q->peek_bucket = -1;
+    return event_pool_at(q->pool, idx);
+}
+
+/* Rebuilds the calendar with nbuckets buckets.
+   The new width is 3 times the average separation of the next CQ_SAMPLE events,
+   ignoring separations larger than twice the average (Brown's heuristic). */
+static void cq_resize(CalendarQueue *q, int nbuckets) {
+    if (q->resizing) return;
+    q->resizing = 1;
+
+    Event *sample[CQ_SAMPLE];
+    int ns = q->size < CQ_SAMPLE ? q->size : CQ_SAMPLE;
+    for (int i = 0; i < ns; i++) sample[i] = cq_unlink_min(q);
+    if (ns >= 2) {
+        double avg = (double)(sample[ns - 1]->time - sample[0]->time) / (ns - 1);
+        double sum = 0.0;
+        int    cnt = 0;
+        for (int i = 1; i < ns; i++) {
+            double sep = (double)(sample[i]->time - sample[i - 1]->time);
+            if (sep <= 2.0 * avg) { sum += sep; cnt++; }
+        }
+        SimTime w = cnt > 0 ? (SimTime)(3.0 * sum / cnt + 0.5) : 0;
+        if (w > 0) q->width = w;   // all sampled events at the same time: keep the old width
+    }
+
+    // move every event to the new calendar
+    int *old_head = q->head;
+    int  old_n    = q->nbuckets;
+    if (!cq_alloc_buckets(q, nbuckets)) {   // no memory: stay with the old size
+        q->head = old_head;
+        q->nbuckets = old_n;
+    } else {
+        for (int b = 0; b < old_n; b++) {
+            int idx = old_head[b];
+            while (idx >= 0) {
+                int nxt = q->next[idx];
+                cq_link(q, event_pool_at(q->pool, idx));
+                idx = nxt;
+            }
+        }
+        free(old_head);
+    }
+    for (int i = 0; i < ns; i++) {
+        cq_link(q, sample[i]);
+        q->size++;
+    }
+    // restart the search at the earliest event
+    if (ns > 0) {
+        q->cur_day     = cq_day(q, sample[0]->time);
+        q->last_bucket = cq_bucket(q, sample[0]->time);
+    } else {
+        q->cur_day     = 0;
+        q->last_bucket = 0;
+    }
+    q->peek_bucket = -1;
+    q->resizes++;
+    q->resizing = 0;
+}
+
+int cq_init(CalendarQueue *q, EventPool *pool) {
+    q->pool        = pool;
+    q->next        = NULL;
+    q->next_cap    = 0;
+    q->width       = CQ_INIT_WIDTH;
+    q->size        = 0;
+    q->last_bucket = 0;
+    q->cur_day     = 0;
+    q->resizing    = 0;
+    q->resizes     = 0;
+    q->peek_bucket = -1;
+    q->peek_day    = 0;
+#ifdef SIM_PROFILE
+    q->link_walk   = (SiftStats){ 0, 0, 0 };
+    q->day_scan    = (SiftStats){ 0, 0, 0 };
+#endif
+    return cq_alloc_buckets(q, CQ_MIN_BUCKETS);
+}
+
+void cq_destroy(CalendarQueue *q) {
+    free(q->head);
+    free(q->next);
+    q->head = NULL;
+    q->next = NULL;
+    q->next_cap = 0;
+    q->size = 0;
+}
+
+int cq_insert(CalendarQueue *q, Event *e) {
+    if (!cq_ensure_next(q, e->pool_idx)) return 0;
+    if (q->size == 0 || cq_day(q, e->time) < q->cur_day) {
+        // empty calendar, or the event is earlier than every pending one (the search may have
+        // been moved forward by a resize): the search starts at this event's day
+        q->cur_day     = cq_day(q, e->time);
+        q->last_bucket = cq_bucket(q, e->time);
+    }
+    Event *min = q->peek_bucket >= 0 ? event_pool_at(q->pool, q->head[q->peek_bucket]) : NULL;
+    cq_link(q, e);
+    q->size++;
+    // a known minimum stays known: either it is still the earliest or the new event is
+    if (min && event_before(e, min)) {
+        q->peek_bucket = cq_bucket(q, e->time);
+        q->peek_day    = cq_day(q, e->time);
+    }
+    if (q->size > 2 * q->nbuckets) cq_resize(q, 2 * q->nbuckets);
+    return 1;
+}
+
+Event* cq_peek(CalendarQueue *q) {
+    if (q->size == 0) return NULL;
+    if (q->peek_bucket < 0) cq_find_min(q);
+    return event_pool_at(q->pool, q->head[q->peek_bucket]);
+}
+
+Event* cq_pop(CalendarQueue *q) {
+    Event *e = cq_unlink_min(q);
+    if (e && q->nbuckets > CQ_MIN_BUCKETS && q->size < q->nbuckets / 2)
+        cq_resize(q, q->nbuckets / 2);
+    return e;
+}
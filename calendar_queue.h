@@ -0,0 +1,52 @@
+#ifndef CALENDAR_QUEUE_H
+#define CALENDAR_QUEUE_H
+#include "event.h"
+#include "event_pool.h"
+#include "profile.h"
+
+/*
+Calendar queue (R. Brown, "Calendar queues: a fast O(1) priority queue implementation
+for the simulation event set problem", CACM 1988).
+
+Time is cut in "days" of `width` ticks and the calendar has nbuckets days per "year".
+An event at time t goes in bucket (t / width) mod nbuckets, each bucket is a list sorted
+by (time, seq). To pop, we walk the days of the current year starting from the last
+popped one and take the head of the first bucket whose head belongs to the current day.
+With the right width most buckets hold one or two events so insert and pop are O(1).
+
+The number of buckets follows the number of events (doubled above 2 * nbuckets,
+halved below nbuckets / 2) and every resize re-estimates the width from the
+separation between the next events, so the queue adapts to RTO / delay changes.
+
+Lists are linked through a side array indexed by the event pool index, the events
+themselves are not modified. Ties are broken with Event.seq, so the pop order is the
+same as the binary and d-ary heaps.
+*/
+
+typedef struct {
+    EventPool *pool;        // where the events live (pool index -> Event*)
+    int       *head;        // head[b] = pool index of the first event of bucket b, -1 if empty
+    int       *next;        // next[idx] = pool index of the next event in the same bucket, -1 at the end
+    int        next_cap;    // size of the next array
+    int        nbuckets;    // always a power of two
+    SimTime    width;       // length of one day (ticks, >= 1)
+    int        size;        // number of events in the calendar
+    int        last_bucket; // bucket of the last popped event, the search starts here
+    long long  cur_day;     // absolute day number (time / width) of last_bucket
+    int        resizing;    // 1 while resize moves events around (no nested resize)
+    long       resizes;     // how many times the calendar was resized
+    int        peek_bucket; // bucket of the earliest event once a search found it, -1 = unknown
+    long long  peek_day;    // its day (what cur_day becomes when it is popped)
+#ifdef SIM_PROFILE
+    SiftStats  link_walk;   // list links walked by a sorted insert
+    SiftStats  day_scan;    // buckets looked at by a pop
+#endif
+} CalendarQueue;
+
+int    cq_init(CalendarQueue *q, EventPool *pool);
+void   cq_destroy(CalendarQueue *q);
+int    cq_insert(CalendarQueue *q, Event *e);
+Event* cq_pop(CalendarQueue *q);
+Event* cq_peek(CalendarQueue *q);   // the event cq_pop would return, the search is kept for that pop
+
+#endif
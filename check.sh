@@ -0,0 +1,20 @@
+#!/bin/sh
+# regression checks for make check: each line runs sim and compares one line of its summary
+fail=0
+
+expect() {
+    want="$1"; shift
+    got=$(./sim "$@" | grep -F "${want%%:*}:" | head -n 1)
+    if [ "$got" != "$want" ]; then
+        echo "FAIL: ./sim $*"
+        echo "  want: $want"
+        echo "  got:  $got"
+        fail=1
+    fi
+}
+
+# a sequence window that cannot grow drops receipts as invalid (72442 unique before the ring grew)
+expect "Receiver unique packets  : 190320" --quiet 1e-5 2 --seed 3
+
+[ $fail -eq 0 ] && echo "all checks passed"
+exit $fail
@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "checkpoint.h"
+
+// the options the state depends on, compared with the restoring run's before anything is read
+typedef struct {
+    char               magic[8];
+    unsigned int       version;
+    int                n_flows;
+    int                n_ports;
+    int                use_wheel;
+    double             ticks_per_s;
+    SimTime            wheel_tick;
+    double             link_bw;
+    double             link_buffer;
+    int                link_shared;
+    int                topo_links;      // -1 = no topology
+    int                topo_queues;     // 1 = the topology has link queues
+    unsigned long long trace_records;   // 0 = no network trace
+    int                window;          // 0 = per-packet protocol
+    int                ack_every;
+    unsigned long long seed;
+    unsigned long long stream;
+    SimTime            now;
+    unsigned long long event_seq;
+    long               events;
+    int                stop;
+    int                pool_high_water;   // the queue counters the summary prints
+    long               pool_allocs;
+    long               lane_events;
+    SimTime            lane_time;
+    int                lane_n;            // the first lane_n saved events are the lane
+} CkHeader;
+
+static void header_of(const SimContext *ctx, CkHeader *h) {
+    memset(h, 0, sizeof(*h));   // the padding goes to the file too
+    memcpy(h->magic, CHECKPOINT_MAGIC, 8);
+    h->version       = CHECKPOINT_VERSION;
+    h->n_flows       = ctx->sender.n_flows;
+    h->n_ports       = ctx->net.n_ports;
+    h->use_wheel     = ctx->timers.enabled;
+    h->ticks_per_s   = ctx->ticks_per_s;
+    h->wheel_tick    = ctx->timers.tick;
+    h->link_bw       = ctx->net.link_bw;
+    h->link_buffer   = ctx->net.link_buffer;
+    h->link_shared   = ctx->net.link_shared;
+    h->topo_links    = ctx->net.topo ? ctx->net.topo->n_links : -1;
+    h->topo_queues   = ctx->net.topo_q != NULL;
+    h->trace_records = ctx->net.trace ? ctx->net.trace->n : 0;
+    h->window        = ctx->sender.window;
+    h->ack_every     = ctx->receiver.ack_every;
+    h->seed          = ctx->seed;
+    h->stream        = ctx->stream;
+    h->now           = ctx->now;
+    h->event_seq     = ctx->event_seq;
+    h->events        = ctx->events;
+    h->stop          = ctx->stop;
+    h->pool_high_water = ctx->queue.pool.high_water;
+    h->pool_allocs     = ctx->queue.pool.allocs;
+    h->lane_events     = ctx->queue.lane_events;
+    h->lane_time       = ctx->queue.lane_time;
+    h->lane_n          = ctx->queue.lane_n;
+}
+
+/* ---------------------------------------------------------------- writing */
+
+// buffered write(2): the forked child must not rely on stdio or malloc
+typedef struct {
+    int           fd;
+    int           err;
+    size_t        n;
+    unsigned char buf[1 << 16];
+} CkOut;
+
+static void out_flush(CkOut *o) {
+    size_t done = 0;
+    while (done < o->n && !o->err) {
+        ssize_t w = write(o->fd, o->buf + done, o->n - done);
+        if (w > 0)              done += (size_t)w;
+        else if (errno != EINTR) o->err = 1;
+    }
+    o->n = 0;
+}
+
+static void put(CkOut *o, const void *p, size_t len) {
+    const unsigned char *s = p;
+    while (len > 0 && !o->err) {
+        size_t k = sizeof(o->buf) - o->n;
+        if (k > len) k = len;
+        memcpy(o->buf + o->n, s, k);
+        o->n += k;
+        s    += k;
+        len  -= k;
+        if (o->n == sizeof(o->buf)) out_flush(o);
+    }
+}
+
+// RTO slots flow f has written: packet p uses slot p % n_slots, the others are still zero
+// (a ring only grows once its packets go past its size)
+static int rto_used(const Sender *s, int f) {
+    return s->next_pkt_id[f] < (unsigned long long)s->n_slots[f] ? (int)s->next_pkt_id[f] : s->n_slots[f];
+}
+
+// the ring as it is: base, head, size, then the words
+static void put_seqwins(CkOut *o, const SeqWindow *w, int n) {
+    for (int i = 0; i < n; i++) {
+        put(o, &w[i].base, sizeof(unsigned long long));
+        put(o, &w[i].head, sizeof(int));
+        put(o, &w[i].words, sizeof(int));
+        put(o, w[i].bits, (size_t)w[i].words * sizeof(unsigned long long));
+    }
+}
+
+static void put_sender(CkOut *o, const Sender *s) {
+    size_t n = (size_t)s->n_flows;
+    put(o, s->sent,        n * sizeof(int));
+    put(o, s->lost_local,  n * sizeof(int));
+    put(o, s->next_pkt_id, n * sizeof(unsigned long long));
+    put(o, s->syn_acked,   n);
+    put_seqwins(o, s->acked, (int)n);
+    put(o, s->syn_timer,   n * sizeof(TimerHandle));
+    for (size_t f = 0; f < n; f++) {
+        put(o, &s->n_slots[f], sizeof(int));
+        put(o, s->rto[f], rto_used(s, (int)f) * sizeof(RtoSlot));
+    }
+    put(o, s->snd_base,    n * sizeof(unsigned long long));
+    put(o, s->snd_next,    n * sizeof(unsigned long long));
+    put(o, s->srtt,        n * sizeof(double));
+    put(o, s->rttvar,      n * sizeof(double));
+    put(o, s->cur_rto,     n * sizeof(SimTime));
+    put(o, s->rtx_timer,   n * sizeof(TimerHandle));
+    put(o, s->done,        n);
+}
+
+static void put_receiver(CkOut *o, const Receiver *r) {
+    size_t n = (size_t)r->n_flows;
+    put(o, r->received_ok,     n * sizeof(int));
+    put(o, r->unique_ok,       n * sizeof(int));
+    put(o, r->invalid_packets, n * sizeof(int));
+    put(o, r->finished,        n);
+    put(o, &r->n_finished,     sizeof(int));
+    put_seqwins(o, r->seen, (int)n);
+    put(o, r->rcv_next,        n * sizeof(unsigned long long));
+    put(o, r->ack_pending,     n * sizeof(int));
+    put(o, r->ack_timer,       n * sizeof(TimerHandle));
+}
+
+// the buffers of a port only need what has not been used yet
+static void put_network(CkOut *o, const Network *n) {
+    for (int i = 0; i < n->n_ports; i++) {
+        const NetPort *p = &n->port[i];
+        put(o, p->rng.s, sizeof(p->rng.s));
+        put(o, &p->rng.pos, sizeof(int));
+        put(o, p->rng.buf + p->rng.pos, (RNG_BATCH - p->rng.pos) * sizeof(double));
+        put(o, &p->delay_pos, sizeof(int));
+        put(o, p->delay_buf + p->delay_pos, (RNG_BATCH - p->delay_pos) * sizeof(double));
+        put(o, &p->sum_delay, sizeof(double));
+        put(o, &p->count_delay, sizeof(long));
+        put(o, &p->trace_pos, sizeof(unsigned long long));
+        put(o, &p->drops, sizeof(long));
+        if (n->link_bw > 0.0) put(o, &p->link, sizeof(LinkQueue));
+    }
+    if (n->link_bw > 0.0 && n->link_shared) put(o, &n->shared_link, sizeof(LinkQueue));
+    put(o, &n->hop_events, sizeof(long));
+    if (n->topo_q) put(o, n->topo_q, 2 * (size_t)n->topo->n_links * sizeof(LinkQueue));
+    put(o, &n->transit_cap, sizeof(int));
+    put(o, &n->transit_free, sizeof(int));
+    put(o, n->transit, (size_t)n->transit_cap * sizeof(NetTransit));
+}
+
+// the due list is saved from due_pos on, what is before it has been fired or cancelled
+static void put_timers(CkOut *o, const TimerWheel *w) {
+    int due_left = w->due_n - w->due_pos;
+    put(o, &w->cur_tick, sizeof(long long));
+    put(o, &w->due_tick, sizeof(long long));
+    put(o, &due_left, sizeof(int));
+    put(o, w->due + w->due_pos, (size_t)due_left * sizeof(TimerDue));
+    put(o, w->head, sizeof(w->head));
+    put(o, w->level_count, sizeof(w->level_count));
+    put(o, &w->count, sizeof(int));
+    put(o, &w->nodes_cap, sizeof(int));
+    put(o, &w->free_node, sizeof(int));
+    put(o, w->nodes, (size_t)w->nodes_cap * sizeof(TimerNode));
+    long counters[4] = { w->armed, w->cancelled, w->fired, w->late_cancels };
+    put(o, counters, sizeof(counters));
+}
+
+static void put_hist(CkOut *o, const Histogram *h) {
+    put(o, &h->count, sizeof(long));
+    put(o, &h->sum_ns, sizeof(unsigned long long));
+    put(o, &h->min, sizeof(double));
+    put(o, &h->max, sizeof(double));
+    int used = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) used += h->counts[b] != 0;
+    put(o, &used, sizeof(int));
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        if (h->counts[b] == 0) continue;
+        put(o, &b, sizeof(int));
+        put(o, &h->counts[b], sizeof(long));
+    }
+}
+
+static void count_event(void *arg, const Event *e) {
+    (void)e;
+    (*(long *)arg)++;
+}
+
+// time, seq, src, dst, packet_id, then the handler id on one byte: 29 bytes per event
+static void put_event(void *arg, const Event *e) {
+    CkOut *o = arg;
+    SimTime            time = e->time;
+    unsigned long long seq  = e->seq;
+    int                v[3] = { e->src, e->dst, e->packet_id };
+    unsigned char      handler = (unsigned char)e->handler;
+    put(o, &time, sizeof(time));
+    put(o, &seq, sizeof(seq));
+    put(o, v, sizeof(v));
+    put(o, &handler, 1);
+}
+
+int checkpoint_write(const SimContext *ctx, const char *path) {
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) return 0;
+    CkOut o;
+    o.fd  = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    o.err = o.fd < 0;
+    o.n   = 0;
+    if (o.err) return 0;
+
+    CkHeader h;
+    header_of(ctx, &h);
+    put(&o, &h, sizeof(h));
+    put_sender(&o, &ctx->sender);
+    put_receiver(&o, &ctx->receiver);
+    put_network(&o, &ctx->net);
+    put_timers(&o, &ctx->timers);
+    put_hist(&o, &ctx->lat.one_way);
+    put_hist(&o, &ctx->lat.rtt);
+    put_hist(&o, &ctx->lat.delivery);
+    put(&o, &ctx->lat.delivery_missing, sizeof(long));
+    long n_events = 0;
+    event_queue_foreach(&ctx->queue, count_event, &n_events);
+    put(&o, &n_events, sizeof(long));
+    event_queue_foreach(&ctx->queue, put_event, &o);
+    out_flush(&o);
+
+    // on disk before it replaces the previous checkpoint
+    if (fsync(o.fd) != 0) o.err = 1;
+    if (close(o.fd) != 0) o.err = 1;
+    if (!o.err && rename(tmp, path) != 0) o.err = 1;
+    if (o.err) unlink(tmp);
+    return !o.err;
+}
+
+/* ---------------------------------------------------------------- reading */
+
+typedef struct {
+    FILE *in;
+    int   err;
+} CkIn;
+
+static void get(CkIn *in, void *p, size_t len) {
+    if (in->err) return;
+    if (fread(p, 1, len, in->in) != len) in->err = 1;
+}
+
+static void get_seqwins(CkIn *in, SeqWindow *w, int n) {
+    for (int i = 0; i < n && !in->err; i++) {
+        int words = 0;
+        get(in, &w[i].base, sizeof(unsigned long long));
+        get(in, &w[i].head, sizeof(int));
+        get(in, &words, sizeof(int));
+        if (in->err || words < SEQWIN_WORDS || (words & (words - 1)) || w[i].head < 0 || w[i].head >= words) {
+            in->err = 1;
+            return;
+        }
+        if (words != w[i].words) {
+            unsigned long long *bits = realloc(w[i].bits, (size_t)words * sizeof(unsigned long long));
+            if (!bits) {
+                in->err = 1;
+                return;
+            }
+            w[i].bits  = bits;
+            w[i].words = words;
+        }
+        get(in, w[i].bits, (size_t)words * sizeof(unsigned long long));
+    }
+}
+
+static void get_sender(CkIn *in, Sender *s) {
+    size_t n = (size_t)s->n_flows;
+    get(in, s->sent,        n * sizeof(int));
+    get(in, s->lost_local,  n * sizeof(int));
+    get(in, s->next_pkt_id, n * sizeof(unsigned long long));
+    get(in, s->syn_acked,   n);
+    get_seqwins(in, s->acked, (int)n);
+    get(in, s->syn_timer,   n * sizeof(TimerHandle));
+    for (size_t f = 0; f < n && !in->err; f++) {
+        int n_slots = 0;
+        get(in, &n_slots, sizeof(int));
+        if (in->err || n_slots < RTO_SLOTS || (n_slots & (n_slots - 1))) {
+            in->err = 1;
+            return;
+        }
+        if (n_slots != s->n_slots[f]) {
+            RtoSlot *rto = calloc(n_slots, sizeof(RtoSlot));
+            if (!rto) {
+                in->err = 1;
+                return;
+            }
+            free(s->rto[f]);
+            s->rto[f]     = rto;
+            s->n_slots[f] = n_slots;
+        }
+        get(in, s->rto[f], rto_used(s, (int)f) * sizeof(RtoSlot));
+    }
+    get(in, s->snd_base,    n * sizeof(unsigned long long));
+    get(in, s->snd_next,    n * sizeof(unsigned long long));
+    get(in, s->srtt,        n * sizeof(double));
+    get(in, s->rttvar,      n * sizeof(double));
+    get(in, s->cur_rto,     n * sizeof(SimTime));
+    get(in, s->rtx_timer,   n * sizeof(TimerHandle));
+    get(in, s->done,        n);
+}
+
+static void get_receiver(CkIn *in, Receiver *r) {
+    size_t n = (size_t)r->n_flows;
+    get(in, r->received_ok,     n * sizeof(int));
+    get(in, r->unique_ok,       n * sizeof(int));
+    get(in, r->invalid_packets, n * sizeof(int));
+    get(in, r->finished,        n);
+    get(in, &r->n_finished,     sizeof(int));
+    get_seqwins(in, r->seen, (int)n);
+    get(in, r->rcv_next,        n * sizeof(unsigned long long));
+    get(in, r->ack_pending,     n * sizeof(int));
+    get(in, r->ack_timer,       n * sizeof(TimerHandle));
+}
+
+static void get_network(CkIn *in, Network *n) {
+    for (int i = 0; i < n->n_ports && !in->err; i++) {
+        NetPort *p = &n->port[i];
+        get(in, p->rng.s, sizeof(p->rng.s));
+        get(in, &p->rng.pos, sizeof(int));
+        if (p->rng.pos < 0 || p->rng.pos > RNG_BATCH) in->err = 1;
+        get(in, p->rng.buf + p->rng.pos, (RNG_BATCH - p->rng.pos) * sizeof(double));
+        get(in, &p->delay_pos, sizeof(int));
+        if (p->delay_pos < 0 || p->delay_pos > RNG_BATCH) in->err = 1;
+        get(in, p->delay_buf + p->delay_pos, (RNG_BATCH - p->delay_pos) * sizeof(double));
+        get(in, &p->sum_delay, sizeof(double));
+        get(in, &p->count_delay, sizeof(long));
+        get(in, &p->trace_pos, sizeof(unsigned long long));
+        get(in, &p->drops, sizeof(long));
+        if (n->link_bw > 0.0) get(in, &p->link, sizeof(LinkQueue));
+    }
+    if (n->link_bw > 0.0 && n->link_shared) get(in, &n->shared_link, sizeof(LinkQueue));
+    get(in, &n->hop_events, sizeof(long));
+    if (n->topo_q) get(in, n->topo_q, 2 * (size_t)n->topo->n_links * sizeof(LinkQueue));
+    int cap = 0, free_idx = -1;
+    get(in, &cap, sizeof(int));
+    get(in, &free_idx, sizeof(int));
+    if (in->err || cap < 0 || cap > EVENT_MAX_NODES || free_idx < -1 || free_idx >= cap) {
+        in->err = 1;
+        return;
+    }
+    free(n->transit);
+    n->transit      = cap > 0 ? malloc((size_t)cap * sizeof(NetTransit)) : NULL;
+    n->transit_cap  = n->transit ? cap : 0;
+    n->transit_free = n->transit ? free_idx : -1;
+    if (cap > 0 && !n->transit) in->err = 1;
+    get(in, n->transit, (size_t)n->transit_cap * sizeof(NetTransit));
+}
+
+static void get_timers(CkIn *in, TimerWheel *w) {
+    int due_n = 0, nodes_cap = 0;
+    get(in, &w->cur_tick, sizeof(long long));
+    get(in, &w->due_tick, sizeof(long long));
+    get(in, &due_n, sizeof(int));
+    if (in->err || due_n < 0) {
+        in->err = 1;
+        return;
+    }
+    free(w->due);
+    w->due     = due_n > 0 ? malloc((size_t)due_n * sizeof(TimerDue)) : NULL;
+    w->due_cap = w->due ? due_n : 0;
+    w->due_n   = w->due_cap;
+    w->due_pos = 0;
+    if (due_n > 0 && !w->due) in->err = 1;
+    get(in, w->due, (size_t)w->due_n * sizeof(TimerDue));
+    get(in, w->head, sizeof(w->head));
+    get(in, w->level_count, sizeof(w->level_count));
+    get(in, &w->count, sizeof(int));
+    get(in, &nodes_cap, sizeof(int));
+    get(in, &w->free_node, sizeof(int));
+    if (in->err || nodes_cap < 0 || w->free_node < -1 || w->free_node >= nodes_cap) {
+        in->err = 1;
+        return;
+    }
+    free(w->nodes);
+    w->nodes     = nodes_cap > 0 ? malloc((size_t)nodes_cap * sizeof(TimerNode)) : NULL;
+    w->nodes_cap = w->nodes ? nodes_cap : 0;
+    if (nodes_cap > 0 && !w->nodes) in->err = 1;
+    get(in, w->nodes, (size_t)w->nodes_cap * sizeof(TimerNode));
+    for (int i = 0; i < w->nodes_cap && !in->err; i++)
+        if (w->nodes[i].list >= 0 && w->nodes[i].handler >= N_HANDLERS) in->err = 1;
+    long counters[4];
+    get(in, counters, sizeof(counters));
+    w->armed        = counters[0];
+    w->cancelled    = counters[1];
+    w->fired        = counters[2];
+    w->late_cancels = counters[3];
+}
+
+static void get_hist(CkIn *in, Histogram *h) {
+    hist_init(h);
+    int used = 0;
+    get(in, &h->count, sizeof(long));
+    get(in, &h->sum_ns, sizeof(unsigned long long));
+    get(in, &h->min, sizeof(double));
+    get(in, &h->max, sizeof(double));
+    get(in, &used, sizeof(int));
+    for (int i = 0; i < used && !in->err; i++) {
+        int b = -1;
+        get(in, &b, sizeof(int));
+        if (b < 0 || b >= HIST_BUCKETS) in->err = 1;
+        else get(in, &h->counts[b], sizeof(long));
+    }
+}
+
+/* the events go through schedule_event_with_seq like any other, into the queue this run uses.
+   The lane comes first in the file (event_queue_foreach), in order: those events go back to the
+   lane and no other does, so the lane fills and moves on as it did in the run that was saved. */
+static void get_events(CkIn *in, SimContext *ctx, int lane_n, SimTime lane_time) {
+    long n_events = -1;
+    get(in, &n_events, sizeof(long));
+    if (n_events < 0) in->err = 1;
+    for (long i = 0; i < n_events && !in->err; i++) {
+        ctx->queue.lane_time = i < lane_n ? lane_time : -1;   // no event is at -1
+        SimTime            time;
+        unsigned long long seq;
+        int                v[3];
+        unsigned char      handler;
+        get(in, &time, sizeof(time));
+        get(in, &seq, sizeof(seq));
+        get(in, v, sizeof(v));
+        get(in, &handler, 1);
+        int src_max = handler == H_NET_HOP ? ctx->net.transit_cap : ctx->net.n_ports;
+        if (in->err || handler >= N_HANDLERS || v[0] < 0 || v[0] >= src_max || v[1] < 0 || v[1] >= ctx->net.n_ports) {
+            in->err = 1;
+            break;
+        }
+        schedule_event_with_seq(ctx, time, v[0], v[1], v[2], (HandlerId)handler, seq);
+    }
+}
+
+int checkpoint_restore(SimContext *ctx, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    CkHeader h, want;
+    header_of(ctx, &want);
+    CkIn in = { f, 0 };
+    get(&in, &h, sizeof(h));
+    if (in.err || memcmp(h.magic, CHECKPOINT_MAGIC, 8) != 0 || h.version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "%s: not a checkpoint of this version of sim\n", path);
+        fclose(f);
+        return 0;
+    }
+    if (h.n_flows != want.n_flows || h.n_ports != want.n_ports || h.use_wheel != want.use_wheel ||
+        h.ticks_per_s != want.ticks_per_s || h.wheel_tick != want.wheel_tick || h.link_bw != want.link_bw ||
+        h.link_buffer != want.link_buffer || h.link_shared != want.link_shared || h.topo_links != want.topo_links ||
+        h.topo_queues != want.topo_queues || h.trace_records != want.trace_records ||
+        h.window != want.window || h.ack_every != want.ack_every) {
+        fprintf(stderr, "%s: taken with other options (%d flows, wheel %s, link %g bit/s, topology %s, trace %s, "
+                        "window %d), restore it with the options of the run that wrote it\n",
+                path, h.n_flows, h.use_wheel ? "on" : "off", h.link_bw,
+                h.topo_links >= 0 ? "yes" : "no", h.trace_records ? "yes" : "no", h.window);
+        fclose(f);
+        return 0;
+    }
+    get_sender(&in, &ctx->sender);
+    get_receiver(&in, &ctx->receiver);
+    get_network(&in, &ctx->net);
+    get_timers(&in, &ctx->timers);
+    get_hist(&in, &ctx->lat.one_way);
+    get_hist(&in, &ctx->lat.rtt);
+    get_hist(&in, &ctx->lat.delivery);
+    get(&in, &ctx->lat.delivery_missing, sizeof(long));
+    ctx->seed      = h.seed;
+    ctx->stream    = h.stream;
+    ctx->now       = h.now;
+    ctx->events    = h.events;
+    ctx->stop      = h.stop;
+    get_events(&in, ctx, h.lane_n, h.lane_time);
+    ctx->queue.lane_time = h.lane_time;
+    ctx->event_seq = h.event_seq;   // after the events: schedule_event_with_seq does not take a seq
+    // after the events too, putting them back counted them as allocations
+    ctx->queue.pool.allocs = h.pool_allocs;
+    ctx->queue.lane_events = h.lane_events;
+    if (ctx->queue.pool.high_water < h.pool_high_water) ctx->queue.pool.high_water = h.pool_high_water;
+    fclose(f);
+    if (in.err) fprintf(stderr, "%s: truncated or damaged checkpoint\n", path);
+    return !in.err;
+}
+
+/* ---------------------------------------------------------------- periodic checkpoints */
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void checkpoint_init(Checkpointer *c, const char *path, SimTime first, SimTime every, SimTime now) {
+    c->path      = path;
+    c->every     = every > 0 ? every : 0;
+    c->next      = first;
+    while (c->every > 0 && c->next <= now) c->next += c->every;
+    c->writer    = 0;
+    c->taken     = 0;
+    c->skipped   = 0;
+    c->failed    = 0;
+    c->stall_max = 0.0;
+}
+
+static void reap(Checkpointer *c, int status) {
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "checkpoint: the writer of %s failed, the previous checkpoint is kept\n", c->path);
+        c->failed++;
+    }
+    c->writer = 0;
+}
+
+// a child writes the state as it is now while the parent goes on
+static void take(Checkpointer *c, const SimContext *ctx) {
+    if (c->writer > 0) {
+        // still writing the previous one: its file must not be replaced half-way
+        int status;
+        pid_t r = waitpid(c->writer, &status, WNOHANG);
+        if (r == 0) {
+            c->skipped++;
+            return;
+        }
+        if (r > 0) reap(c, status);
+        else       c->writer = 0;
+    }
+    double t0 = wall_seconds();
+    pid_t pid = fork();
+    if (pid == 0) _exit(checkpoint_write(ctx, c->path) ? 0 : 1);   // _exit: the parent's stdio buffers stay in the parent
+    if (pid < 0) {
+        perror("checkpoint: fork, writing in the main loop instead");
+        if (!checkpoint_write(ctx, c->path)) c->failed++;
+    } else {
+        c->writer = pid;
+    }
+    double stall = wall_seconds() - t0;
+    if (stall > c->stall_max) c->stall_max = stall;
+    c->taken++;
+    fprintf(stderr, "checkpoint: t = %.6f s, %d pending events -> %s (main loop paused %.2f ms)\n",
+            sim_seconds(ctx, ctx->now), ctx->queue.pool.in_use, c->path, 1e3 * stall);
+}
+
+void checkpoint_run(SimContext *ctx, Checkpointer *c) {
+    while (!ctx->stop) {
+        sim_run_until(ctx, c->next);
+        SimTime t = sim_next_time(ctx);
+        if (ctx->stop || t == SIM_TIME_MAX) break;
+        take(c, ctx);   // every event before c->next has run, none after
+        if (c->every == 0) {
+            sim_run(ctx);
+            break;
+        }
+        while (c->next <= t) c->next += c->every;   // nothing happens before t, no need for identical checkpoints
+    }
+    if (c->writer > 0) {
+        int status;
+        pid_t r;
+        while ((r = waitpid(c->writer, &status, 0)) < 0 && errno == EINTR) {}
+        if (r > 0) reap(c, status);
+    }
+    fprintf(stderr, "checkpoint: %d taken (%d skipped while the previous one was written, %d failed), "
+                    "longest pause %.2f ms\n", c->taken, c->skipped, c->failed, 1e3 * c->stall_max);
+}
@@ -0,0 +1,72 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <sys/types.h>
+#include "sim.h"
+
+/*
+Checkpoint and restore of a sequential run (sim --checkpoint FILE, sim --restore FILE).
+
+A checkpoint holds everything that changes while a run goes on: the clock and seq counter,
+the pending events, the timing wheel, the per-flow sender and receiver state, the network
+ports (random streams included), the link queues and packets in transit, and the latency
+histograms. Handlers are saved as their HandlerId, never as pointers, and the events are saved
+without their pool index or queue position: the restored run puts them back in whatever queue
+--queue asks for, and since the queues all pop by (time, seq) it runs the same events in the
+same order. A restored run prints exactly what the uninterrupted run would have printed, except
+the chunk counts of the event pool line, which can differ: they describe the pool of the process
+that ran. Its high-water mark and allocation count, and the zero-delay lane count, are saved.
+
+What the command line gives (intervals, durations, delays, topology, trace) is not saved: a
+checkpoint is restored with the same options, which the header checks as far as it can.
+
+Taking a checkpoint forks the simulation. The child gets a copy-on-write image of the memory as
+it was at that instant and writes the file from it, while the parent carries on right away: the
+main loop only pays for the fork (copying the page tables), not for writing the pending set.
+The file is written as FILE.tmp and renamed once complete, so a crash during a write leaves the
+previous checkpoint intact.
+
+File layout (native byte order, read back by the same build):
+  header         magic "SIMCKP01", version, the options it was taken with, seed, stream,
+                 now, event_seq, events, stop, pool high-water, pool allocations, lane events
+                 and the time of the last pop
+  sender         per flow: sent, lost_local, next_pkt_id, syn_acked, acked window, SYN timer,
+                 then the size of its RTO ring and the slots the flow has used so far
+                 (min(next_pkt_id, n_slots)),
+                 then the window-mode arrays (snd_base, snd_next, srtt, rttvar, cur_rto, timer, done)
+  receiver       per flow: received_ok, unique_ok, invalid_packets, finished, seen window,
+                 then rcv_next, ack_pending and the delayed-ACK timer
+  network        per port: generator state and the unused part of its buffers, counters,
+                 trace cursor, link queue; then the shared link queue (--link-shared), the
+                 topology link queues and transit records
+  timers         the wheel's lists and nodes as they are (the handles in the sender stay valid)
+  latency        the three histograms, as (bucket, count) pairs of the non-empty buckets,
+                 then the receipts missing from time to delivery
+  events         count, then time, seq, src, dst, packet_id, handler of each pending event
+*/
+
+#define CHECKPOINT_MAGIC   "SIMCKP01"
+#define CHECKPOINT_VERSION 5
+
+typedef struct Checkpointer {
+    const char *path;
+    SimTime     next;        // when the next checkpoint is taken (ticks)
+    SimTime     every;       // ticks between two checkpoints, 0 = only one
+    pid_t       writer;      // child writing the last checkpoint, 0 = none
+    int         taken;       // checkpoints started
+    int         skipped;     // checkpoints not taken because the previous one was still being written
+    int         failed;      // writers that did not complete their file
+    double      stall_max;   // longest pause of the main loop for a fork (seconds)
+} Checkpointer;
+
+// writes a checkpoint of ctx in this process (what the forked child runs). Returns 0 on failure.
+int  checkpoint_write(const SimContext *ctx, const char *path);
+/* Loads a checkpoint into ctx, which must come from sim_alloc with the same options and no event
+   yet (sim_start not called). Returns 0 (and prints why) if the file does not fit. */
+int  checkpoint_restore(SimContext *ctx, const char *path);
+
+// first checkpoint at `first`, then one every `every` ticks (0 = none), skipping what is not after now
+void checkpoint_init(Checkpointer *c, const char *path, SimTime first, SimTime every, SimTime now);
+// sim_run with a checkpoint every time the clock crosses c->next, waits for the last writer
+void checkpoint_run(SimContext *ctx, Checkpointer *c);
+
+#endif
@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dary_heap.h"
+
+/* a is before b: earlier time, or same time and scheduled first.
+   The sequence numbers are compared as a signed 32-bit difference so the order stays FIFO when
+   the counter wraps, as long as events with the same time were scheduled less than 2^31 apart. */
+static inline int dary_key_before(const DaryKey *a, const DaryKey *b) {
+    if (a->time != b->time) return a->time < b->time;
+    return (int)(a->seq - b->seq) < 0;
+}
+
+// number of keys placed in front of keys[0] so that keys[1] (and every first child) is cache line aligned
+static int dary_pad(const DaryHeap *h) {
+    return (1 << h->shift) - 1;
+}
+
+// makes room for new_cap keys, the block is allocated on a cache line boundary
+static int dary_grow(DaryHeap *h, int new_cap) {
+    if (h->cap >= new_cap) return 1;
+    int new_capacity = h->cap * 2;
+    if (new_capacity < new_cap) new_capacity = new_cap;
+    if (new_capacity < 64) new_capacity = 64;
+
+    size_t bytes = (size_t)(new_capacity + dary_pad(h)) * sizeof(DaryKey);
+    bytes = (bytes + DARY_CACHE_LINE - 1) / DARY_CACHE_LINE * DARY_CACHE_LINE; // aligned_alloc wants a multiple of the alignment
+    void *block = aligned_alloc(DARY_CACHE_LINE, bytes);
+    if (!block) return 0;
+    DaryKey *keys = (DaryKey*)block + dary_pad(h);
+    if (h->size > 0) memcpy(keys, h->keys, h->size * sizeof(DaryKey));
+    free(h->block);
+    h->block = block;
+    h->keys  = keys;
+    h->cap   = new_capacity;
+    return 1;
+}
+
+// arity is rounded up to a power of two (2, 4, 8, ...), 4 is the cache-line friendly choice
+int dary_init(DaryHeap *h, int arity, int cap) {
+    h->shift = 1;
+    while ((1 << h->shift) < arity) h->shift++;
+    h->keys  = NULL;
+    h->block = NULL;
+    h->size  = 0;
+    h->cap   = 0;
+#ifdef SIM_PROFILE
+    h->sift_up   = (SiftStats){ 0, 0, 0 };
+    h->sift_down = (SiftStats){ 0, 0, 0 };
+#endif
+    return dary_grow(h, cap);
+}
+
+void dary_destroy(DaryHeap *h) {
+    free(h->block);
+    h->block = NULL;
+    h->keys  = NULL;
+    h->size  = 0;
+    h->cap   = 0;
+}
+
+// the new key starts at the bottom as a "hole" that moves up while its parent is later than it
+int dary_push(DaryHeap *h, SimTime time, unsigned int seq, int idx) {
+    if (h->size == h->cap && !dary_grow(h, h->size + 1)) return 0;
+    DaryKey k = { time, seq, idx };
+    int i = h->size++;
+    int depth = 0;
+    while (i > 0) {
+        int parent = (i - 1) >> h->shift;
+        if (!dary_key_before(&k, &h->keys[parent])) break;
+        h->keys[i] = h->keys[parent];
+        i = parent;
+        depth++;
+    }
+    h->keys[i] = k;
+    PROF_SIFT(h->sift_up, depth);
+    return 1;
+}
+
+// takes the root out, then the last key sinks down from the root: at every level
+// we scan the d children (one cache line for d = 4) and pull the smallest one up
+int dary_pop(DaryHeap *h) {
+    if (h->size == 0) return -1;
+    int top = h->keys[0].idx;
+    DaryKey last = h->keys[--h->size];
+    int n = h->size;
+    int d = 1 << h->shift;
+    int i = 0;
+    int depth = 0;
+    while (1) {
+        int first = (i << h->shift) + 1;
+        if (first >= n) break;
+        int end = first + d < n ? first + d : n;
+        int best = first;
+        for (int c = first + 1; c < end; c++)
+            if (dary_key_before(&h->keys[c], &h->keys[best])) best = c;
+        if (!dary_key_before(&h->keys[best], &last)) break;
+        h->keys[i] = h->keys[best];
+        i = best;
+        depth++;
+    }
+    if (n > 0) h->keys[i] = last;
+    PROF_SIFT(h->sift_down, depth);
+    return top;
+}
@@ -0,0 +1,50 @@
+#ifndef DARY_HEAP_H
+#define DARY_HEAP_H
+
+/*
+d-ary heap with the keys stored inline.
+The binary heap (heap_priority.c) keeps Event* and reads arr[i]->time at every comparison,
+so every level of a sift is a jump into a different event in memory.
+Here every slot holds a small key (time, seq, pool index of the event) so a sift only reads
+the keys array. With d = 4 the 4 children of a node are 4 * 16 bytes = one 64-byte cache line,
+and the array is shifted so that every group of children starts on a cache line boundary.
+
+parent(i)      = (i - 1) / d
+first_child(i) = d * i + 1
+d must be a power of two so both are shifts.
+*/
+
+#include "event.h"
+#include "profile.h"
+
+#define DARY_CACHE_LINE 64
+
+typedef struct {
+    SimTime      time;  // when the event fires (ticks)
+    unsigned int seq;   // low 32 bits of Event.seq, compared with wrap-around (see dary_key_before)
+    int          idx;   // pool index of the event (event_pool_at)
+} DaryKey;
+
+typedef struct {
+    DaryKey *keys;    // keys[0] is the root, keys[1..d] its children, ...
+    void    *block;   // what aligned_alloc returned (keys points inside it)
+    int      size;    // number of keys currently stored
+    int      cap;     // how many keys fit before we need to grow
+    int      shift;   // log2(d)
+#ifdef SIM_PROFILE
+    SiftStats sift_up;    // levels the hole moved up in dary_push
+    SiftStats sift_down;  // levels the hole moved down in dary_pop
+#endif
+} DaryHeap;
+
+int  dary_init(DaryHeap *h, int arity, int cap);
+void dary_destroy(DaryHeap *h);
+int  dary_push(DaryHeap *h, SimTime time, unsigned int seq, int idx);
+int  dary_pop(DaryHeap *h);   // returns the pool index of the earliest event, -1 if empty
+
+// pool index of the earliest event without removing it, -1 if empty
+static inline int dary_peek(const DaryHeap *h) {
+    return h->size > 0 ? h->keys[0].idx : -1;
+}
+
+#endif
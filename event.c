@@ -2,18 +2,78 @@
 #include <stdio.h>
 #include "event.h"
 #include "heap_priority.h"
-double g_now = 0.0;
-int    g_stop_simulation = 0;
+#include "event_pool.h"
+#include "sim.h"
+#include "pdes.h"
 
-void schedule_event(double time, int src, int dst, int packet_id, EventHandler handler)
+static void handle_nothing(SimContext *ctx, Event *e) {
+    (void)ctx;
+    (void)e;
+}
+
+const EventHandler event_handlers[N_HANDLERS] = {
+    [H_NONE]              = handle_nothing,
+    [H_SND_SEND_SYN]      = snd_send_syn,
+    [H_SND_RECV_SYNACK]   = snd_recv_synack,
+    [H_SND_SEND_DATA]     = snd_send_data,
+    [H_SND_RECV_DATA_ACK] = snd_recv_data_ack,
+    [H_SND_TIMEOUT]       = snd_timeout,
+    [H_RCV_RECV_SYN]      = rcv_recv_syn,
+    [H_RCV_RECV_ACK]      = rcv_recv_ack,
+    [H_RCV_RECV_DATA]     = rcv_recv_data,
+    [H_RCV_RECV_FINISH]   = rcv_recv_finish,
+    [H_NET_HOP]           = net_hop,
+    [H_SND_RTX_TIMEOUT]   = snd_rtx_timeout,
+    [H_RCV_ACK_TIMEOUT]   = rcv_ack_timeout,
+};
+
+const char *const event_handler_names[N_HANDLERS] = {
+    [H_NONE]              = "none",
+    [H_SND_SEND_SYN]      = "snd_send_syn",
+    [H_SND_RECV_SYNACK]   = "snd_recv_synack",
+    [H_SND_SEND_DATA]     = "snd_send_data",
+    [H_SND_RECV_DATA_ACK] = "snd_recv_data_ack",
+    [H_SND_TIMEOUT]       = "snd_timeout",
+    [H_RCV_RECV_SYN]      = "rcv_recv_syn",
+    [H_RCV_RECV_ACK]      = "rcv_recv_ack",
+    [H_RCV_RECV_DATA]     = "rcv_recv_data",
+    [H_RCV_RECV_FINISH]   = "rcv_recv_finish",
+    [H_NET_HOP]           = "net_hop",
+    [H_SND_RTX_TIMEOUT]   = "snd_rtx_timeout",
+    [H_RCV_ACK_TIMEOUT]   = "rcv_ack_timeout",
+};
+
+void schedule_event(SimContext *ctx, SimTime time, int src, int dst, int packet_id, HandlerId handler)
+{
+    schedule_event_with_seq(ctx, time, src, dst, packet_id, handler, ctx->event_seq++);
+}
+
+void schedule_event_with_seq(SimContext *ctx, SimTime time, int src, int dst, int packet_id,
+                             HandlerId handler, unsigned long long seq)
 {
-    // creating a block of memory for an event -> return the address of that memory -> treat it as an Event*, and store it in recent_event
-    Event *recent_event = (Event*)malloc(sizeof(Event));
+    if (ctx->pdes && pdes_owner(ctx->pdes, dst) != ctx->part) {
+        // dst is run by another partition of a parallel run: the event goes through its mailbox
+        pdes_post(ctx, time, src, dst, packet_id, handler);
+        return;
+    }
+    // taking a free event out of the pool (no malloc unless the pool has to grow by a chunk)
+    Event *recent_event = event_pool_alloc(&ctx->queue.pool);
+    if (!recent_event) {
+        fprintf(stderr, "schedule_event: event pool exhausted (%d events in use)\n", ctx->queue.pool.in_use);
+        exit(EXIT_FAILURE);
+    }
     recent_event->time      = time;
     recent_event->src       = src;
     recent_event->dst       = dst;
     recent_event->packet_id = packet_id;
     recent_event->handler   = handler;
+    recent_event->seq       = seq;
 
-    heap_insert(recent_event);
+    heap_insert(&ctx->queue, recent_event);
+}
+
+// gives a handled event back to the pool so the next schedule_event can reuse it
+void event_release(SimContext *ctx, Event *e)
+{
+    event_pool_release(&ctx->queue.pool, e);
 }
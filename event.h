@@ -1,25 +1,74 @@
 #ifndef EVENT_H
 #define EVENT_H
+#include <limits.h>
 
-struct Event;                     
+struct Event;
+struct SimContext;   // sim.h: everything a simulation owns (queue, timers, network, flows, time)
 
-typedef void (*EventHandler)(struct Event *e);
+/* Simulated time is an integer number of ticks (1 / SimContext.ticks_per_s seconds each, 1 ns by default).
+   Comparing two events is an integer compare, and adding delays never drifts the way adding
+   doubles did. The seconds only come back for the output (sim_seconds). */
+typedef long long SimTime;
+#define SIM_TIME_MAX LLONG_MAX   // "never": no event, no window limit
 
+// a handler gets the simulation it belongs to, so several simulations can run at the same time
+typedef void (*EventHandler)(struct SimContext *ctx, struct Event *e);
+
+/* An event names its handler with a small number instead of a function pointer,
+   event_handlers[] (event.c) gives the function. Add new handlers at the end. */
+typedef enum {
+    H_NONE,              // does nothing (benchmarks)
+    H_SND_SEND_SYN,
+    H_SND_RECV_SYNACK,
+    H_SND_SEND_DATA,
+    H_SND_RECV_DATA_ACK,
+    H_SND_TIMEOUT,
+    H_RCV_RECV_SYN,
+    H_RCV_RECV_ACK,
+    H_RCV_RECV_DATA,
+    H_RCV_RECV_FINISH,
+    H_NET_HOP,           // a packet crossing a multi-hop route reaches its next link (network.c)
+    H_SND_RTX_TIMEOUT,   // the retransmission timer of a flow in window mode (sender.c)
+    H_RCV_ACK_TIMEOUT,   // a delayed ACK is due (receiver.c)
+    N_HANDLERS
+} HandlerId;
+
+extern const EventHandler event_handlers[N_HANDLERS];
+extern const char *const  event_handler_names[N_HANDLERS];
+
+#define EVENT_NODE_BITS 24
+#define EVENT_MAX_NODES (1 << EVENT_NODE_BITS)   // node ids must fit in the src/dst bit fields
+
+/* 32 bytes, two events per cache line (it was 40 with the pointer and the full ints).
+   While the event sits in the pool's free list its time is not needed, so the link
+   to the next free event takes its place. */
 typedef struct Event {
-    double       time;       
-    int          src;     
-    int          dst;        
-    int          packet_id;  
-    EventHandler handler;    // pointer to a function 
+    union {
+        SimTime       time;       // ticks
+        struct Event *next_free;  // only used while the event sits in the pool's free list
+    };
+    unsigned long long seq;       // scheduling order, breaks ties between events with the same time (FIFO)
+    unsigned int src     : EVENT_NODE_BITS;
+    unsigned int handler : 8;     // HandlerId
+    unsigned int dst     : EVENT_NODE_BITS;
+    unsigned int         : 8;
+    int          packet_id;
+    int          pool_idx;   // position of this event inside the event pool (see event_pool.h)
 } Event;
 
-extern double g_now;
-extern int    g_stop_simulation;
+// a runs before b: the earliest time first, and for the same time the one scheduled first
+static inline int event_before(const Event *a, const Event *b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
 
-void   event_queue_init(void);
-int    event_queue_empty(void);
-Event* pop_next_event(void);
+static inline void event_dispatch(struct SimContext *ctx, Event *e) {
+    event_handlers[e->handler](ctx, e);
+}
 
-void schedule_event(double time, int src, int dst,int packet_id,EventHandler handler);
+void schedule_event(struct SimContext *ctx, SimTime time, int src, int dst, int packet_id, HandlerId handler);
+// same as schedule_event but with a seq reserved earlier (timers take their seq when they are armed)
+void schedule_event_with_seq(struct SimContext *ctx, SimTime time, int src, int dst, int packet_id,
+                             HandlerId handler, unsigned long long seq);
+void event_release(struct SimContext *ctx, Event *e);
 
 #endif
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "event_pool.h"
+
+// allocates one more chunk of EVENT_POOL_CHUNK events and gives every event its pool index
+// returns 0 if the memory could not be allocated
+static int add_chunk(EventPool *p) {
+    if (p->n_chunks == p->chunks_cap) {
+        int new_cap = p->chunks_cap ? p->chunks_cap * 2 : 16;
+        Event **new_chunks = realloc(p->chunks, new_cap * sizeof(Event*));
+        if (!new_chunks) return 0;
+        p->chunks     = new_chunks;
+        p->chunks_cap = new_cap;
+    }
+    Event *chunk = malloc(EVENT_POOL_CHUNK * sizeof(Event));
+    if (!chunk) return 0;
+    int base = p->n_chunks * EVENT_POOL_CHUNK;
+    for (int i = 0; i < EVENT_POOL_CHUNK; i++)
+        chunk[i].pool_idx = base + i;
+    p->chunks[p->n_chunks++] = chunk;
+    p->fresh = EVENT_POOL_CHUNK;
+    return 1;
+}
+
+/* max_events = 0 -> the pool starts with one chunk and grows on demand.
+   max_events > 0 -> enough chunks for max_events are allocated now and the pool never grows,
+                     so a run has a known memory footprint (alloc fails once the pool is full). */
+int event_pool_init(EventPool *p, int max_events) {
+    p->chunks      = NULL;
+    p->n_chunks    = 0;
+    p->chunks_cap  = 0;
+    p->max_events  = max_events;
+    p->free_list   = NULL;
+    p->fresh       = 0;
+    p->in_use      = 0;
+    p->high_water  = 0;
+    p->chunk_grows = 0;
+    p->allocs      = 0;
+
+    int wanted = max_events > 0 ? (max_events + EVENT_POOL_CHUNK - 1) / EVENT_POOL_CHUNK : 1;
+    for (int c = 0; c < wanted; c++) {
+        if (!add_chunk(p)) return 0;
+        // push the whole chunk on the free list except the last one, which stays "fresh"
+        if (c < wanted - 1) {
+            Event *chunk = p->chunks[c];
+            for (int i = EVENT_POOL_CHUNK - 1; i >= 0; i--) {
+                chunk[i].next_free = p->free_list;
+                p->free_list = &chunk[i];
+            }
+        }
+    }
+    return 1;
+}
+
+void event_pool_destroy(EventPool *p) {
+    for (int c = 0; c < p->n_chunks; c++)
+        free(p->chunks[c]);
+    free(p->chunks);
+    p->chunks    = NULL;
+    p->n_chunks  = 0;
+    p->free_list = NULL;
+    p->fresh     = 0;
+}
+
+// pop an event from the free list, or take the next never-used one of the last chunk
+// returns NULL when a fixed-capacity pool is full (or when malloc fails)
+Event* event_pool_alloc(EventPool *p) {
+    if (p->max_events > 0 && p->in_use >= p->max_events) return NULL;
+
+    Event *e = p->free_list;
+    if (e) {
+        p->free_list = e->next_free;
+    } else {
+        if (p->fresh == 0) {
+            if (p->max_events > 0 || !add_chunk(p)) return NULL;
+            p->chunk_grows++;
+        }
+        e = &p->chunks[p->n_chunks - 1][EVENT_POOL_CHUNK - p->fresh];
+        p->fresh--;
+    }
+    p->in_use++;
+    p->allocs++;
+    if (p->in_use > p->high_water) p->high_water = p->in_use;
+    return e;
+}
+
+// push the event back on the free list, the memory is reused by the next allocation
+void event_pool_release(EventPool *p, Event *e) {
+    e->next_free = p->free_list;
+    p->free_list = e;
+    p->in_use--;
+}
@@ -0,0 +1,42 @@
+#ifndef EVENT_POOL_H
+#define EVENT_POOL_H
+#include "event.h"
+
+/*
+The event pool replaces one malloc/free per event with a free list.
+Events are carved out of big chunks (EVENT_POOL_CHUNK events each) so they sit
+next to each other in memory. A released event is pushed on the free list and
+the next schedule_event pops it again, so in steady state there is no libc call at all.
+
+Every event also gets a stable index (pool_idx): chunk number * EVENT_POOL_CHUNK + offset.
+Chunks never move once allocated, only the small array of chunk pointers grows.
+*/
+
+#define EVENT_POOL_CHUNK_SHIFT 12
+#define EVENT_POOL_CHUNK       (1 << EVENT_POOL_CHUNK_SHIFT)   // 4096 events per chunk
+#define EVENT_POOL_CHUNK_MASK  (EVENT_POOL_CHUNK - 1)
+
+typedef struct EventPool {
+    Event **chunks;       // chunks[c] points to EVENT_POOL_CHUNK contiguous events
+    int     n_chunks;     // number of chunks allocated so far
+    int     chunks_cap;   // capacity of the chunks array
+    int     max_events;   // 0 = grow by chunks when needed, > 0 = fixed capacity (everything allocated up front)
+    Event  *free_list;    // released events, linked through Event.next_free
+    int     fresh;        // events of the last chunk that were never handed out yet
+    int     in_use;       // events currently scheduled (allocated and not released)
+    int     high_water;   // maximum value in_use ever reached
+    int     chunk_grows;  // number of chunks allocated after initialisation
+    long    allocs;       // total number of events handed out
+} EventPool;
+
+int    event_pool_init(EventPool *p, int max_events);
+void   event_pool_destroy(EventPool *p);
+Event* event_pool_alloc(EventPool *p);
+void   event_pool_release(EventPool *p, Event *e);
+
+// index -> event, used by queues that store indices instead of pointers
+static inline Event* event_pool_at(const EventPool *p, int idx) {
+    return &p->chunks[idx >> EVENT_POOL_CHUNK_SHIFT][idx & EVENT_POOL_CHUNK_MASK];
+}
+
+#endif
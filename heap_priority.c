@@ -9,8 +9,6 @@ left_child(i) = 2*i + 1
 right_child(i) = 2*i + 2
 */
 
-Heap g_heap;
-
 //to move one element up or down we need to swap the pointer to the event 
 // **a and **b are pointers to the pointers to the events and we are swapping pointers to the events 
 static void swap(Event **a, Event **b) {
@@ -44,15 +42,18 @@ static void ensure_capacity(Heap *h, int new_cap) {
 // i starts as the size of the heap because we are inserting the event at the end of the tree 
 
 static void bubble_up(Heap *h, int i) {
+    int depth = 0;
     while (i > 0) {
         int parent = (i - 1) / 2;
-        //h->arr[parent]->time we are reading the value of the time 
-        if (h->arr[parent]->time <= h->arr[i]->time)
-            break; // do nothing if the time of the parent is smaller than the time of the child
+        //event_before reads the time (and the seq for equal times) of both events
+        if (!event_before(h->arr[i], h->arr[parent]))
+            break; // do nothing if the parent runs before the child
         //&h->arr[parent] is the address of the array where there is the element of index parent 
         swap(&h->arr[parent], &h->arr[i]); // otherwise if the location is false we swap them using the pointers to the events (we swap based on the address of the array where we can access the address of the events that we are swapping)
         i = parent;
+        depth++;
     }
+    PROF_SIFT(h->sift_up, depth);
 }
 
 /*After removing the root element: 
@@ -63,45 +64,190 @@ Fix the heap by bubbling the new root DOWN*/
 // we always start with i = 0 because when we remove an event  g_heap.arr[0] = g_heap.arr[g_heap.size - 1] -> bubble_down(&g_heap, 0)
 
 static void bubble_down(Heap *h, int i) {
+    int depth = 0;
     while (1) { // we need to go through the whole tree to make sure that all the elements are reordered
         int left  = 2 * i + 1;
         int right = 2 * i + 2;
         int smallest = i;
-        if (left < h->size && h->arr[left]->time < h->arr[smallest]->time)
+        if (left < h->size && event_before(h->arr[left], h->arr[smallest]))
             smallest = left;
-        if (right < h->size && h->arr[right]->time < h->arr[smallest]->time)
+        if (right < h->size && event_before(h->arr[right], h->arr[smallest]))
             smallest = right;
         if (smallest == i) break;
         swap(&h->arr[i], &h->arr[smallest]);
         i = smallest;
+        depth++;
+    }
+    PROF_SIFT(h->sift_down, depth);
+}
+
+// appends to the lane ring, which doubles when it is full
+static void lane_push(EventQueue *q, Event *e) {
+    if (q->lane_n == q->lane_cap) {
+        int new_cap = q->lane_cap ? 2 * q->lane_cap : 64;
+        Event **ring = malloc(new_cap * sizeof(Event*));
+        if (!ring) {
+            fprintf(stderr, "heap_insert: cannot grow the zero-delay lane\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < q->lane_n; i++)
+            ring[i] = q->lane[(q->lane_head + i) & (q->lane_cap - 1)];
+        free(q->lane);
+        q->lane      = ring;
+        q->lane_cap  = new_cap;
+        q->lane_head = 0;
     }
+    q->lane[(q->lane_head + q->lane_n) & (q->lane_cap - 1)] = e;
+    q->lane_n++;
 }
 
-void heap_insert(Event *e) {
-    ensure_capacity(&g_heap, g_heap.size + 1);
-    g_heap.arr[g_heap.size] = e;
-    bubble_up(&g_heap, g_heap.size);
-    g_heap.size++;
+// the earliest event of the backend, left in place (NULL if the backend is empty)
+static Event* backend_peek(EventQueue *q) {
+    if (q->kind == QUEUE_DARY_HEAP) {
+        int idx = dary_peek(&q->dary);
+        return idx < 0 ? NULL : event_pool_at(&q->pool, idx);
+    }
+    if (q->kind == QUEUE_CALENDAR) return cq_peek(&q->calendar);
+    return q->heap.size > 0 ? q->heap.arr[0] : NULL;
 }
 
-void event_queue_init(void) {
-    g_heap.arr  = NULL;
-    g_heap.cap  = 0;
-    g_heap.size = 0;
+void heap_insert(EventQueue *q, Event *e) {
+    if (e->time == q->lane_time &&
+        (q->lane_n == 0 || e->seq > q->lane[(q->lane_head + q->lane_n - 1) & (q->lane_cap - 1)]->seq)) {
+        lane_push(q, e);
+        q->lane_events++;
+        return;
+    }
+    if (q->kind == QUEUE_DARY_HEAP) {
+        // only the key goes in the d-ary heap, the event itself stays in the pool
+        if (!dary_push(&q->dary, e->time, (unsigned int)e->seq, e->pool_idx)) {
+            fprintf(stderr, "heap_insert: cannot grow the d-ary heap\n");
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+    if (q->kind == QUEUE_CALENDAR) {
+        if (!cq_insert(&q->calendar, e)) {
+            fprintf(stderr, "heap_insert: cannot grow the calendar queue\n");
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+    Heap *h = &q->heap;
+    ensure_capacity(h, h->size + 1);
+    h->arr[h->size] = e;
+    bubble_up(h, h->size);
+    h->size++;
 }
 
-int event_queue_empty(void) {
-    return g_heap.size == 0;
+void event_queue_put_back(EventQueue *q, Event *e) {
+    long lane_events = q->lane_events;
+    heap_insert(q, e);
+    q->lane_events = lane_events;
 }
 
-Event* pop_next_event(void) {
-    if (g_heap.size == 0) return NULL;
-    Event *recent_event = g_heap.arr[0];
+// the queue owns the event pool: max_events = 0 lets the pool grow, > 0 fixes its capacity
+void event_queue_init(EventQueue *q, QueueKind kind, int arity, int max_events) {
+    q->kind      = kind;
+    q->lane        = NULL;
+    q->lane_head   = 0;
+    q->lane_n      = 0;
+    q->lane_cap    = 0;
+    q->lane_time   = 0;
+    q->lane_events = 0;
+    q->heap.arr  = NULL;
+    q->heap.cap  = 0;
+    q->heap.size = 0;
+#ifdef SIM_PROFILE
+    q->heap.sift_up   = (SiftStats){ 0, 0, 0 };
+    q->heap.sift_down = (SiftStats){ 0, 0, 0 };
+#endif
+    if (!event_pool_init(&q->pool, max_events)) {
+        fprintf(stderr, "event_queue_init: cannot allocate the event pool\n");
+        exit(EXIT_FAILURE);
+    }
+    if (kind == QUEUE_DARY_HEAP) {
+        if (!dary_init(&q->dary, arity, max_events)) {
+            fprintf(stderr, "event_queue_init: cannot allocate the d-ary heap\n");
+            exit(EXIT_FAILURE);
+        }
+    } else if (kind == QUEUE_CALENDAR) {
+        if (!cq_init(&q->calendar, &q->pool)) {
+            fprintf(stderr, "event_queue_init: cannot allocate the calendar queue\n");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        ensure_capacity(&q->heap, max_events);
+    }
+}
 
-    g_heap.arr[0] = g_heap.arr[g_heap.size - 1];
-    g_heap.size--;
-    if (g_heap.size > 0)
-        bubble_down(&g_heap, 0);
+void event_queue_destroy(EventQueue *q) {
+    if (q->kind == QUEUE_DARY_HEAP)     dary_destroy(&q->dary);
+    else if (q->kind == QUEUE_CALENDAR) cq_destroy(&q->calendar);
+    free(q->heap.arr);
+    q->heap.arr = NULL;
+    free(q->lane);
+    q->lane     = NULL;
+    q->lane_n   = 0;
+    q->lane_cap = 0;
+    event_pool_destroy(&q->pool);
+}
+
+int event_queue_empty(const EventQueue *q) {
+    if (q->lane_n > 0) return 0;
+    if (q->kind == QUEUE_DARY_HEAP) return q->dary.size == 0;
+    if (q->kind == QUEUE_CALENDAR)  return q->calendar.size == 0;
+    return q->heap.size == 0;
+}
+
+static Event* backend_pop(EventQueue *q) {
+    if (q->kind == QUEUE_DARY_HEAP) {
+        int idx = dary_pop(&q->dary);
+        return idx < 0 ? NULL : event_pool_at(&q->pool, idx);
+    }
+    if (q->kind == QUEUE_CALENDAR) return cq_pop(&q->calendar);
+    Heap *h = &q->heap;
+    if (h->size == 0) return NULL;
+    Event *recent_event = h->arr[0];
+
+    h->arr[0] = h->arr[h->size - 1];
+    h->size--;
+    if (h->size > 0)
+        bubble_down(h, 0);
 
     return recent_event;
 }
+
+// the lane's first event, unless the backend holds an event that runs before it
+Event* pop_next_event(EventQueue *q) {
+    if (q->lane_n > 0) {
+        Event *e = q->lane[q->lane_head];
+        Event *b = backend_peek(q);
+        if (!b || event_before(e, b)) {
+            q->lane_head = (q->lane_head + 1) & (q->lane_cap - 1);
+            q->lane_n--;
+            return e;
+        }
+    }
+    Event *e = backend_pop(q);
+    // every event in the lane is at lane_time: it only moves once the lane is empty
+    // (the backend can hand out an earlier event, e.g. a timer moved in after a reinsert)
+    if (e && q->lane_n == 0) q->lane_time = e->time;
+    return e;
+}
+
+void event_queue_foreach(const EventQueue *q, void (*fn)(void *arg, const Event *e), void *arg) {
+    for (int i = 0; i < q->lane_n; i++)
+        fn(arg, q->lane[(q->lane_head + i) & (q->lane_cap - 1)]);
+    if (q->kind == QUEUE_DARY_HEAP) {
+        for (int i = 0; i < q->dary.size; i++)
+            fn(arg, event_pool_at(&q->pool, q->dary.keys[i].idx));
+    } else if (q->kind == QUEUE_CALENDAR) {
+        for (int b = 0; b < q->calendar.nbuckets; b++)
+            for (int idx = q->calendar.head[b]; idx >= 0; idx = q->calendar.next[idx])
+                fn(arg, event_pool_at(&q->pool, idx));
+    } else {
+        for (int i = 0; i < q->heap.size; i++)
+            fn(arg, q->heap.arr[i]);
+    }
+}
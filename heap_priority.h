@@ -1,17 +1,58 @@
 #ifndef HEAP_PRIORITY_H //The guard makes sure the body of this header is only seen once per compilation unit.
 #define HEAP_PRIORITY_H
 #include "event.h"
+#include "event_pool.h"
+#include "dary_heap.h"
+#include "calendar_queue.h"
+#include "profile.h"
+
+// which data structure holds the pending events, chosen when the queue is created (--queue)
+typedef enum {
+    QUEUE_BINARY_HEAP,   // Event* binary heap (this file)
+    QUEUE_DARY_HEAP,     // d-ary heap with inline keys (dary_heap.c)
+    QUEUE_CALENDAR       // calendar queue with automatic bucket width (calendar_queue.c)
+} QueueKind;
 
 typedef struct {
     Event **arr;  // pointer to pointer to Event so dynamic array of pointers to Event so arr[i] is of type Event*.
     // we are using double pointers in this case because heap should reorder pointers, not the events themselves (so the heap hipifies the pointers to events)
     int     size;  // Number of elements currently stored in the heap
     int     cap;  //The capacity of the heap : how many elements arr can hold before we need to realloc
+#ifdef SIM_PROFILE
+    SiftStats sift_up;    // levels climbed by bubble_up
+    SiftStats sift_down;  // levels walked down by bubble_down
+#endif
 } Heap;
 
-void   event_queue_init(void);
-int    event_queue_empty(void);
-Event* pop_next_event(void);
-void   heap_insert(Event *e);
+/* the pending events of one simulation: the pool that owns the events plus the backend that orders them.
+
+   Events scheduled for the current time (FINISH, SYN retransmissions, network delays clamped to 0)
+   would run next anyway, so they skip the backend: they wait in a FIFO ring, the lane, which
+   pop_next_event drains first. An event only enters the lane if it is at the time of the last pop
+   and was scheduled after the lane's last event, so the lane is always sorted by (time, seq), and
+   a backend event at the same time with a smaller seq (a timer armed earlier) still goes first. */
+typedef struct EventQueue {
+    QueueKind     kind;
+    EventPool     pool;
+    Heap          heap;      // used when kind == QUEUE_BINARY_HEAP
+    DaryHeap      dary;      // used when kind == QUEUE_DARY_HEAP
+    CalendarQueue calendar;  // used when kind == QUEUE_CALENDAR
+    Event       **lane;      // ring of lane_cap events (power of two), lane_n of them from lane_head on
+    int           lane_head;
+    int           lane_n;
+    int           lane_cap;
+    SimTime       lane_time;   // time of the last popped event
+    long          lane_events; // events that went through the lane instead of the backend
+} EventQueue;
+
+void   event_queue_init(EventQueue *q, QueueKind kind, int arity, int max_events);
+void   event_queue_destroy(EventQueue *q);
+int    event_queue_empty(const EventQueue *q);
+Event* pop_next_event(EventQueue *q);
+void   heap_insert(EventQueue *q, Event *e);
+// an event popped but not run goes back: it was not scheduled, lane_events does not count it
+void   event_queue_put_back(EventQueue *q, Event *e);
+// calls fn on every pending event: the lane first, in order, then the backend in no particular order (checkpoint.c)
+void   event_queue_foreach(const EventQueue *q, void (*fn)(void *arg, const Event *e), void *arg);
 
 #endif
@@ -0,0 +1,87 @@
+#include <string.h>
+#include "hist.h"
+
+/*
+Where the samples come from:
+  one_way   network_schedule_delivery, the delay drawn for every packet (SYN, DATA, ACK, ...)
+  rtt       snd_recv_data_ack, now - transmission of the packet, first ACK of a packet that
+            was never retransmitted only (Karn's rule, the ACK of a retransmitted one is ambiguous)
+  delivery  rcv_recv_data, now - first snd_send_data of the packet, first unique receipt only
+            (local drops and timeouts included, that is what the application sees); a receipt
+            whose first send is not known to its context counts in delivery_missing instead
+*/
+
+void hist_init(Histogram *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void hist_merge(Histogram *dst, const Histogram *src) {
+    if (src->count == 0) return;
+    if (dst->count == 0 || src->min < dst->min) dst->min = src->min;
+    if (dst->count == 0 || src->max > dst->max) dst->max = src->max;
+    dst->count  += src->count;
+    dst->sum_ns += src->sum_ns;
+    for (int i = 0; i < HIST_BUCKETS; i++) dst->counts[i] += src->counts[i];
+}
+
+// middle of bucket idx in nanoseconds
+static double bucket_mid_ns(int idx) {
+    if (idx < 2 * HIST_HALF) return idx;            // one value per bucket
+    int shift = idx / HIST_HALF - 1;
+    unsigned long long lo = (unsigned long long)(idx - shift * HIST_HALF) << shift;
+    return lo + ((1ULL << shift) - 1) / 2.0;
+}
+
+double hist_percentile(const Histogram *h, double q) {
+    if (h->count == 0) return 0.0;
+    // the sample of rank ceil(q% of count), counted from 1
+    long rank = (long)(q / 100.0 * h->count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > h->count) rank = h->count;
+    long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            double v = bucket_mid_ns(i) * 1e-9;
+            // the exact extremes are known, the bucket of the first and last sample is narrowed to them
+            if (v < h->min) v = h->min;
+            if (v > h->max) v = h->max;
+            return v;
+        }
+    }
+    return h->max;
+}
+
+double hist_mean(const Histogram *h) {
+    return h->count > 0 ? (double)h->sum_ns / h->count * 1e-9 : 0.0;
+}
+
+void latency_init(LatencyStats *l) {
+    hist_init(&l->one_way);
+    hist_init(&l->rtt);
+    hist_init(&l->delivery);
+    l->delivery_missing = 0;
+}
+
+void latency_merge(LatencyStats *dst, const LatencyStats *src) {
+    hist_merge(&dst->one_way, &src->one_way);
+    hist_merge(&dst->rtt, &src->rtt);
+    hist_merge(&dst->delivery, &src->delivery);
+    dst->delivery_missing += src->delivery_missing;
+}
+
+void hist_print_row(FILE *out, const char *name, const Histogram *h) {
+    fprintf(out, "  %-18s %10ld %11.6f %11.6f %11.6f %11.6f %11.6f %11.6f\n", name, h->count, hist_mean(h),
+            hist_percentile(h, 50.0), hist_percentile(h, 90.0), hist_percentile(h, 99.0),
+            hist_percentile(h, 99.9), h->max);
+}
+
+void latency_print(FILE *out, const LatencyStats *l) {
+    fprintf(out, "Latency (s)          %10s %11s %11s %11s %11s %11s %11s\n",
+            "samples", "mean", "p50", "p90", "p99", "p99.9", "max");
+    hist_print_row(out, "one-way delay", &l->one_way);
+    hist_print_row(out, "RTT (DATA->ACK)", &l->rtt);
+    hist_print_row(out, "time to delivery", &l->delivery);
+    if (l->delivery_missing > 0)
+        fprintf(out, "  (%ld unique receipts without a first send time are not in time to delivery)\n", l->delivery_missing);
+}
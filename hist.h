@@ -0,0 +1,68 @@
+#ifndef HIST_H
+#define HIST_H
+#include <stdio.h>
+
+/*
+Streaming latency histogram with log-linear buckets (the layout of HdrHistogram).
+
+Values are recorded in nanoseconds. Below 2^HIST_SUB_BITS every value has its own bucket,
+above that every power of two [2^b, 2^(b+1)) is cut in HIST_HALF equal buckets, so a bucket
+is never wider than 1/HIST_HALF of its values (0.8%) whatever the magnitude. The memory is
+fixed (HIST_BUCKETS counters), recording is a count-leading-zeros and an increment, and two
+histograms merge by adding their counters: the same samples give the same histogram in any
+order, over any number of flows, partitions or replications.
+*/
+
+#define HIST_SUB_BITS 8
+#define HIST_HALF     (1 << (HIST_SUB_BITS - 1))              // buckets per power of two
+#define HIST_MAX_BITS 48                                       // 2^48 ns = 78 hours, longer values are clamped
+#define HIST_BUCKETS  ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_HALF + HIST_HALF)
+
+typedef struct {
+    long               count;
+    unsigned long long sum_ns;   // integer so that merging in any order gives the same mean
+    double             min;      // seconds
+    double             max;
+    long               counts[HIST_BUCKETS];
+} Histogram;
+
+// the latencies a run measures (see hist.c for where each one is recorded)
+typedef struct {
+    Histogram one_way;    // network delay of every packet handed to the network
+    Histogram rtt;        // DATA to its first ACK at the sender (packets sent once only)
+    Histogram delivery;   // first send attempt of a packet to its first unique receipt
+    long      delivery_missing;   // unique receipts whose first send time was not known, no sample
+} LatencyStats;
+
+static inline int hist_index(unsigned long long ns) {
+    if (ns < (1ULL << HIST_SUB_BITS)) return (int)ns;
+    if (ns >= (1ULL << HIST_MAX_BITS)) ns = (1ULL << HIST_MAX_BITS) - 1;
+    int b = 63 - __builtin_clzll(ns);                 // highest bit, >= HIST_SUB_BITS
+    int shift = b - HIST_SUB_BITS + 1;
+    return shift * HIST_HALF + (int)(ns >> shift);    // ns >> shift is in [HIST_HALF, 2 * HIST_HALF)
+}
+
+// one sample in seconds, O(1)
+static inline void hist_record(Histogram *h, double seconds) {
+    if (seconds < 0.0) seconds = 0.0;
+    unsigned long long ns = (unsigned long long)(seconds * 1e9 + 0.5);
+    h->counts[hist_index(ns)]++;
+    if (h->count == 0 || seconds < h->min) h->min = seconds;
+    if (h->count == 0 || seconds > h->max) h->max = seconds;
+    h->count++;
+    h->sum_ns += ns;
+}
+
+void   hist_init(Histogram *h);
+void   hist_merge(Histogram *dst, const Histogram *src);
+double hist_percentile(const Histogram *h, double q);   // q in [0, 100], seconds (0 if empty)
+double hist_mean(const Histogram *h);
+
+// one line of latency_print: count, mean, p50/p90/p99/p99.9 and max (seconds)
+void   hist_print_row(FILE *out, const char *name, const Histogram *h);
+
+void   latency_init(LatencyStats *l);
+void   latency_merge(LatencyStats *dst, const LatencyStats *src);
+void   latency_print(FILE *out, const LatencyStats *l);   // count, mean, p50/p90/p99/p99.9 and max of each one
+
+#endif
@@ -1,80 +1,436 @@
 #include <stdio.h>
 //Provides I/O functions like printf, fprintf.
 #include <stdlib.h>
-//Provides functions like malloc, free, atof, rand, srand, and exit
+//Provides functions like malloc, free, atof and exit
+#include <string.h>
+//Provides strcmp to recognise the --options
 #include <time.h>
-//Provides time() to get the current time for seeding the random generator.
-#include "event.h"
-#include "heap_priority.h"
-#include "network.h"
-#include "sender.h"
-#include "receiver.h"
-#include "globals.h"
+//Provides time() to get the current time for seeding the random generator, clock_gettime for the wall time.
+#include "sim.h"
+#include "replicate.h"
+#include "pdes.h"
+#include "checkpoint.h"
+#include "sweep.h"
+#include "pktlog.h"
+#include "realtime.h"
+#include "adaptive.h"
 
-//NOTE: ALL THE VARIABLES THAT HAVE A g AS A PREFIX ARE GLOBAL VARIABLES 
 // #include tells the preprocessor to copy the contents of a header file into this file before compilation
-//These are global variables used in all the program 
-Network  g_net;
-Sender   g_sender;
-Receiver g_receiver;
+//NOTE: there are no global variables anymore, everything a run needs lives in a SimContext (sim.h)
+
+// reads "0.01,0.02,0.05" into out[], returns how many values were read
+static int parse_list(const char *s, double *out, int max) {
+    int n = 0;
+    while (*s && n < max) {
+        char *end;
+        out[n++] = strtod(s, &end);
+        if (end == s) return n - 1;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// --pkt-log: the senders and receivers of ctx record their packets in log from now on
+static int open_pkt_log(SimContext *ctx, PacketLog *log) {
+    if (!pktlog_init(log, ctx->sender.n_flows)) {
+        fprintf(stderr, "cannot allocate the packet log of %d flows\n", ctx->sender.n_flows);
+        return 0;
+    }
+    ctx->pkt = log;
+    return 1;
+}
+
+// --pkt-log: the records of the run in ctx go to the file once it is over
+static void write_pkt_log(SimContext *ctx, const char *path) {
+    if (!ctx->pkt) return;
+    if (pktlog_write(ctx->pkt, path, ctx)) fprintf(stderr, "pkt-log: per-packet columns written to %s\n", path);
+    pktlog_free(ctx->pkt);
+    ctx->pkt = NULL;
+}
+
 // the main function takes as arguments the file name to be ran, the interval duration, the full duration 
 int main(int argc, char **argv) {
-    //these are default variables in case we do not specify them in the terminal 
-    double send_interval = 0.05;  // the interval between each packets 
-    double duration      = 1.0;   // The full duration of sending packets 
-    double base_delay    = 0.05;   // the based delay that is the average delay of a network (in this case I increased the delay to see the effect of timeout )
-    double jitter        = 0.2;   // maximum variation around the base delay.
+    //these are default variables in case we do not specify them in the terminal (see sim_config_default)
+    SimConfig cfg;
+    sim_config_default(&cfg);
+    int reps    = 0;   // --reps K: run K independent replications and print confidence intervals
+    int threads = 1;   // --threads T: number of worker threads for the replications
+    // --seed N: the same seed replays the same run (and the same replications) bit for bit,
+    // without it time(0) is used, which changes every second
+    unsigned long long seed = (unsigned long long)time(0);
+    int    pdes_threads = 0;     // --pdes P: one run split over P threads (0 = sequential engine)
+    int    pdes_speedup = 0;     // --pdes-speedup P: compare the sequential run with 1, 2, 4, ... P threads
+    double pdes_window  = 0.0;   // --pdes-window W: shorter synchronisation windows than the lookahead
+    const char *profile_path = NULL;   // --profile FILE: JSON report of a sequential run (build with SIM_PROFILE)
+    const char *net_trace_path = NULL; // --net-trace FILE: replay delays and losses (see nettrace_convert)
+    const char *topo_path = NULL;      // --topology FILE: multi-hop network (see topology.h)
+    const char *ckpt_path = NULL;      // --checkpoint FILE: save the state of the run (see checkpoint.h)
+    double ckpt_at    = 0.0;           // --checkpoint-at T: simulated time of the first checkpoint
+    double ckpt_every = 0.0;           // --checkpoint-every S: then one every S simulated seconds
+    const char *restore_path = NULL;   // --restore FILE: go on from a checkpoint instead of t = 0
+    double sweep_at = -1.0;            // --sweep-at T: branch point of a parameter sweep (see sweep.h)
+    double sweep_rto[MAX_LIST], sweep_loss[MAX_LIST], sweep_jitter[MAX_LIST];
+    int    n_sweep_rto = 0, n_sweep_loss = 0, n_sweep_jitter = 0;
+    const char *pkt_log_path = NULL;   // --pkt-log FILE: columnar per-packet records (see pktlog.h)
+    PacketLog   pkt_log;
+    double rt_speed = 0.0;             // --realtime SPEED: events fire at wall-clock times (see realtime.h)
+    const char *inject_path = NULL;    // --inject FILE: events from another process while running in real time
+    double precision = 0.0;            // --precision R: stop once the 95% intervals are within R of the means (see adaptive.h)
+    double batch_s   = 0.0;            // --batch S: batch length of --precision (0 = 50 send intervals)
+    AdaptiveStop adapt;
+
+    // the options starting with -- can be anywhere, everything else is a positional argument
+    char *pos[4];
+    int   npos = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--pool-cap") == 0 && i + 1 < argc) {
+            cfg.pool_cap = atoi(argv[++i]);   // fixed event pool of N events (0 = the pool grows by chunks)
+        } else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            // --queue heap (binary heap of Event*), dary (d-ary heap with inline keys) or calendar
+            const char *q = argv[++i];
+            if      (strcmp(q, "dary") == 0)     cfg.queue_kind = QUEUE_DARY_HEAP;
+            else if (strcmp(q, "calendar") == 0) cfg.queue_kind = QUEUE_CALENDAR;
+            else if (strcmp(q, "heap") == 0)     cfg.queue_kind = QUEUE_BINARY_HEAP;
+            else {
+                fprintf(stderr, "--queue %s: unknown queue, use heap, dary or calendar\n", q);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--arity") == 0 && i + 1 < argc) {
+            cfg.queue_arity = atoi(argv[++i]);   // d of the d-ary heap (default 4)
+        } else if (strcmp(argv[i], "--no-timer-wheel") == 0) {
+            cfg.use_wheel = 0;                   // timeouts are scheduled as plain events like before
+        } else if (strcmp(argv[i], "--timer-tick") == 0 && i + 1 < argc) {
+            cfg.timer_tick = atof(argv[++i]);    // length of one slot of the timing wheel (seconds)
+        } else if (strcmp(argv[i], "--time-res") == 0 && i + 1 < argc) {
+            cfg.time_resolution = atof(argv[++i]);   // seconds per tick of the simulation clock (default 1e-9)
+            if (!(cfg.time_resolution > 0.0 && cfg.time_resolution <= 1.0)) cfg.time_resolution = 1e-9;
+        } else if (strcmp(argv[i], "--flows") == 0 && i + 1 < argc) {
+            cfg.n_flows = atoi(argv[++i]);       // number of sender/receiver pairs simulated together
+            if (cfg.n_flows < 1) cfg.n_flows = 1;
+        } else if (strcmp(argv[i], "--intervals") == 0 && i + 1 < argc) {
+            cfg.n_intervals = parse_list(argv[++i], cfg.intervals, MAX_LIST);
+        } else if (strcmp(argv[i], "--durations") == 0 && i + 1 < argc) {
+            cfg.n_durations = parse_list(argv[++i], cfg.durations, MAX_LIST);
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--pdes") == 0 && i + 1 < argc) {
+            pdes_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pdes-speedup") == 0 && i + 1 < argc) {
+            pdes_speedup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pdes-split") == 0) {
+            cfg.split_flows = 1;   // senders and receivers in different partitions, every packet crosses (pdes.h)
+        } else if (strcmp(argv[i], "--pdes-window") == 0 && i + 1 < argc) {
+            pdes_window = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            cfg.trace_level = TRACE_OFF;         // no line per event, only the summary
+        } else if (strcmp(argv[i], "--trace-level") == 0 && i + 1 < argc) {
+            cfg.trace_level = atoi(argv[++i]);   // 0 = nothing, 1 = connection events, 2 = every packet
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            cfg.trace_path = argv[++i];          // binary records to this file instead of text (see trace_decode)
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_path = argv[++i];
+        } else if (strcmp(argv[i], "--net-trace") == 0 && i + 1 < argc) {
+            net_trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--topology") == 0 && i + 1 < argc) {
+            topo_path = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            ckpt_path = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-at") == 0 && i + 1 < argc) {
+            ckpt_at = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            ckpt_every = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restore_path = argv[++i];
+        } else if (strcmp(argv[i], "--rto") == 0 && i + 1 < argc) {
+            cfg.rto = atof(argv[++i]);           // retransmission timeout in seconds (default 0.05)
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            cfg.local_loss = atof(argv[++i]);    // probability of a local drop of a DATA packet (default 0.08)
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            cfg.window = atoi(argv[++i]);        // packets in flight per flow, cumulative ACKs (0 = per-packet protocol)
+            if (cfg.window < 0) cfg.window = 0;
+            if (cfg.window > SND_WINDOW_MAX) cfg.window = SND_WINDOW_MAX;
+        } else if (strcmp(argv[i], "--ack-every") == 0 && i + 1 < argc) {
+            cfg.ack_every = atoi(argv[++i]);     // window mode: ACK every N packets received in order (default 2)
+        } else if (strcmp(argv[i], "--ack-delay") == 0 && i + 1 < argc) {
+            cfg.ack_delay = atof(argv[++i]);     // window mode: a delayed ACK waits at most S seconds (default 0.005)
+        } else if (strcmp(argv[i], "--realtime") == 0 && i + 1 < argc) {
+            rt_speed = atof(argv[++i]);          // simulated seconds per wall second (1 = real time)
+            if (!(rt_speed > 0.0)) rt_speed = 1.0;
+        } else if (strcmp(argv[i], "--inject") == 0 && i + 1 < argc) {
+            inject_path = argv[++i];             // pipe, FIFO or - (stdin): "HANDLER FLOW [PACKET_ID]" per line
+        } else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc) {
+            precision = atof(argv[++i]);         // relative half-width, e.g. 0.02; the duration becomes the longest run
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_s = atof(argv[++i]);           // simulated seconds per batch of --precision
+        } else if (strcmp(argv[i], "--pkt-log") == 0 && i + 1 < argc) {
+            pkt_log_path = argv[++i];
+        } else if (strcmp(argv[i], "--sweep-at") == 0 && i + 1 < argc) {
+            sweep_at = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep-rto") == 0 && i + 1 < argc) {
+            n_sweep_rto = parse_list(argv[++i], sweep_rto, MAX_LIST);
+        } else if (strcmp(argv[i], "--sweep-loss") == 0 && i + 1 < argc) {
+            n_sweep_loss = parse_list(argv[++i], sweep_loss, MAX_LIST);
+        } else if (strcmp(argv[i], "--sweep-jitter") == 0 && i + 1 < argc) {
+            n_sweep_jitter = parse_list(argv[++i], sweep_jitter, MAX_LIST);
+        } else if (strcmp(argv[i], "--link-bw") == 0 && i + 1 < argc) {
+            cfg.link_bw = atof(argv[++i]);       // bits/s of each node's outgoing link (queueing, tail drop)
+        } else if (strcmp(argv[i], "--link-shared") == 0) {
+            cfg.link_shared = 1;                 // the senders share one --link-bw link: their flows contend for it
+        } else if (strcmp(argv[i], "--link-buffer") == 0 && i + 1 < argc) {
+            cfg.link_buffer = atof(argv[++i]);   // bytes of buffer per link, 0 = unlimited (default 96000)
+        } else if (strcmp(argv[i], "--pkt-size") == 0 && i + 1 < argc) {
+            cfg.pkt_size = atoi(argv[++i]);      // bytes of a DATA packet (default 1500)
+        } else if (strcmp(argv[i], "--ctl-size") == 0 && i + 1 < argc) {
+            cfg.ctl_size = atoi(argv[++i]);      // bytes of a SYN/SYNACK/ACK (default 40)
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            // a mistyped option would be taken as a positional argument (--flow 8: an interval of 0)
+            fprintf(stderr, "%s: unknown option, or its value is missing\n", argv[i]);
+            return EXIT_FAILURE;
+        } else if (npos < 4) {
+            pos[npos++] = argv[i];
+        }
+    }
 
     //atof is a function that takes a string (ascii) and converts it into a float 
     // Reference: https://www.w3schools.com/c/ref_stdlib_atof.php#:~:text=Definition%20and%20Usage,not%20part%20of%20the%20number.
-    if (argc == 3 || argc == 5) {
-        send_interval = atof(argv[1]);
-        duration      = atof(argv[2]);
-        if (argc == 5) {
-            base_delay = atof(argv[3]);
-            jitter     = atof(argv[4]);
+    if (npos == 2 || npos == 4) {
+        cfg.send_interval = atof(pos[0]);
+        cfg.duration      = atof(pos[1]);
+        if (npos == 4) {
+            cfg.base_delay = atof(pos[2]);
+            cfg.jitter     = atof(pos[3]);
         }
     } 
-    // srand is a function that changes the numerique sequence of generating random numbers using rand in the other 
-    //portions of the code. it takes tim(0) which is each second the current time that changes and thats why everytime 
-    //we run the code we will have a difference random number 
-    // Reference: https://www.w3schools.com/c/c_random_numbers.php
-    srand((unsigned)time(0));
-
-    event_queue_init();
-    network_init(&g_net, base_delay, jitter);
-    receiver_init(&g_receiver, RECEIVER_ID);
-    sender_init(&g_sender,  SENDER_ID, send_interval, duration);
-    // this is the main part of the code where as long as we have a scheduled event in the queue we keep popping the top event
-    // everytime we pop the event we rehypify the tree and reorder the elements using a simple swap method 
-    // this loop not only does it stop when the queue is empty but also we need the full duration to be over 
-
-    while (!g_stop_simulation && !event_queue_empty()) {
-        Event *recent_event = pop_next_event(); // we remove the event from the heap tree and returns the pointer to the most recent event (the root of the tree)
-        g_now = recent_event->time;     // we update the current time by assigning it the value of the time of the event we popped to discretize time   
-        recent_event->handler(recent_event);       //  handler is of type EventHandler, a function pointer so it points to the function that should handle the event 
-        free(recent_event);               //The event was allocated with malloc when scheduled -> once the event is popped we remove it from the heap and free the memory 
+    // an interval of 0 never lets the clock move past the first send
+    int bad_interval = !(cfg.send_interval > 0.0);
+    for (int k = 0; k < cfg.n_intervals; k++)
+        if (!(cfg.intervals[k] > 0.0)) bad_interval = 1;
+    if (bad_interval) {
+        fprintf(stderr, "the send interval must be greater than 0\n");
+        return EXIT_FAILURE;
+    }
+    int bad_duration = cfg.duration < 0.0;
+    for (int k = 0; k < cfg.n_durations; k++)
+        if (cfg.durations[k] < 0.0) bad_duration = 1;
+    if (bad_duration) {
+        fprintf(stderr, "the duration must not be negative\n");
+        return EXIT_FAILURE;
+    }
+    // the trace stays mapped until the program exits, every context (replications, partitions) reads the same pages
+    NetTrace net_trace;
+    if (net_trace_path) {
+        if (!nettrace_open(&net_trace, net_trace_path)) return EXIT_FAILURE;
+        cfg.net_trace = &net_trace;
+    }
+    // the routes of the flows are computed once and shared by every context, like the trace
+    Topology topo;
+    if (topo_path) {
+        if (net_trace_path) {
+            fprintf(stderr, "--topology and --net-trace both give the delays of the packets, use one of them\n");
+            return EXIT_FAILURE;
+        }
+        double t0 = wall_seconds();
+        if (!topology_load(&topo, topo_path) || !topology_route_flows(&topo, cfg.n_flows)) return EXIT_FAILURE;
+        cfg.topo = &topo;
+        fprintf(stderr, "topology: %d nodes, %d links, %d routes in %.3f s\n",
+                topo.n_nodes, topo.n_links, cfg.n_flows, wall_seconds() - t0);
+        if (topo.n_queued > 0 && (pdes_threads > 0 || pdes_speedup > 0)) {
+            // the queues of the links are shared by the flows of different partitions
+            fprintf(stderr, "--pdes: some routes cross links with a bandwidth, running the sequential engine instead\n");
+            pdes_threads = 0;
+            pdes_speedup = 0;
+        }
+    }
+    if (cfg.link_shared && !(cfg.link_bw > 0.0)) {
+        fprintf(stderr, "--link-shared needs --link-bw\n");
+        return EXIT_FAILURE;
+    }
+    if (cfg.link_shared && (pdes_threads > 0 || pdes_speedup > 0)) {
+        // the senders of every partition would go through the same link
+        fprintf(stderr, "--pdes: the senders share one link (--link-shared), running the sequential engine instead\n");
+        pdes_threads = 0;
+        pdes_speedup = 0;
+    }
+    if (cfg.split_flows && (net_trace_path || topo_path || !(cfg.base_delay - cfg.jitter > 0.0))) {
+        // the lookahead between a sender and its receiver, and the time the FINISH takes, is the shortest delay of the jitter model
+        fprintf(stderr, "--pdes-split needs a base delay larger than the jitter (no --net-trace, --topology)\n");
+        return EXIT_FAILURE;
+    }
+    if (cfg.split_flows && pdes_threads > 0 && pkt_log_path) {
+        // the row of a flow would be written by the partitions of both of its nodes
+        fprintf(stderr, "--pkt-log does not work with --pdes and --pdes-split together\n");
+        return EXIT_FAILURE;
+    }
+    if (ckpt_path || restore_path) {
+        // the partitions and the replications each have their own state, a checkpoint is one run's
+        if (reps > 0 || pdes_threads > 0 || pdes_speedup > 0) {
+            fprintf(stderr, "--checkpoint and --restore only work with the sequential engine (no --reps, --pdes)\n");
+            return EXIT_FAILURE;
+        }
+        if (ckpt_path && !(ckpt_at > 0.0) && !(ckpt_every > 0.0)) {
+            fprintf(stderr, "--checkpoint needs --checkpoint-at T or --checkpoint-every S (simulated seconds)\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (pkt_log_path && (reps > 0 || pdes_speedup > 0 || sweep_at >= 0.0 || restore_path)) {
+        // one file holds the packets of one run, from its start
+        fprintf(stderr, "--pkt-log records one run from t = 0 (no --reps, --pdes-speedup, --sweep-at, --restore)\n");
+        return EXIT_FAILURE;
+    }
+    if (inject_path && rt_speed == 0.0) rt_speed = 1.0;   // injected events only make sense in real time
+    if (rt_speed > 0.0 && (reps > 0 || pdes_threads > 0 || pdes_speedup > 0 || sweep_at >= 0.0 || ckpt_path)) {
+        // one run follows one clock
+        fprintf(stderr, "--realtime only works with the sequential engine (no --reps, --pdes, --sweep-at, --checkpoint)\n");
+        return EXIT_FAILURE;
+    }
+    if (precision > 0.0 && (reps > 0 || pdes_threads > 0 || pdes_speedup > 0 || sweep_at >= 0.0 || ckpt_path ||
+                            rt_speed > 0.0)) {
+        // the batches are cut in one sequential run
+        fprintf(stderr, "--precision only works with the sequential engine (no --reps, --pdes, --sweep-at, --checkpoint, --realtime)\n");
+        return EXIT_FAILURE;
+    }
+    if (sweep_at >= 0.0) {
+        // one sequential run is forked at the branch point, --threads bounds the children running at once
+        if (reps > 0 || pdes_threads > 0 || pdes_speedup > 0 || ckpt_path || restore_path) {
+            fprintf(stderr, "--sweep-at only works with the sequential engine (no --reps, --pdes, --checkpoint, --restore)\n");
+            return EXIT_FAILURE;
+        }
+        if (n_sweep_jitter > 0 && (net_trace_path || topo_path)) {
+            fprintf(stderr, "--sweep-jitter: the delays come from --net-trace or --topology, not from the jitter\n");
+            return EXIT_FAILURE;
+        }
+        if (n_sweep_rto > 0 && cfg.window > 0) {
+            // by T every flow has its RTO from its RTT samples, the configured one is only the first guess
+            fprintf(stderr, "--sweep-rto: with --window the timers use the RTO measured per flow, not --rto\n");
+            return EXIT_FAILURE;
+        }
+        cfg.trace_level = TRACE_OFF;   // the branches run at the same time
+        SweepPoint *points = NULL;
+        int n_points = sweep_points(&cfg, sweep_rto, n_sweep_rto, sweep_loss, n_sweep_loss,
+                                    sweep_jitter, n_sweep_jitter, &points);
+        SimResults *results = n_points > 0 ? malloc(n_points * sizeof(SimResults)) : NULL;
+        char       *ok      = n_points > 0 ? malloc(n_points) : NULL;
+        SimContext *ctx     = malloc(sizeof(SimContext));
+        if (!results || !ok || !ctx || !sim_init(ctx, &cfg, seed, 0)) {
+            fprintf(stderr, "cannot set up a sweep of %d points\n", n_points);
+            return EXIT_FAILURE;
+        }
+        SweepStats st;
+        sweep_run(ctx, sim_ticks(ctx, sweep_at), points, n_points, threads, results, ok, &st);
+        if (ctx->stop) fprintf(stderr, "sweep: the run was over before the branch point, every point is the same\n");
+        print_sweep_report(points, n_points, results, ok, &st);
+        sim_destroy(ctx);
+        free(ctx);
+        free(points);
+        free(results);
+        free(ok);
+        return st.failed > 0 ? EXIT_FAILURE : 0;
+    }
+    if (reps > 0) {
+        // replications run in parallel, printing every event of every thread would be unreadable
+        cfg.trace_level = TRACE_OFF;
+        SimResults *results = malloc(reps * sizeof(SimResults));
+        if (!results) {
+            fprintf(stderr, "cannot allocate the results of %d replications\n", reps);
+            return EXIT_FAILURE;
+        }
+        LatencyStats *lat = malloc(sizeof(LatencyStats));   // pooled histograms of every replication
+        double start = wall_seconds();
+        if (!lat || !run_replications(&cfg, reps, threads, seed, results, lat)) {
+            fprintf(stderr, "a replication could not be set up\n");
+            free(results);
+            free(lat);
+            return EXIT_FAILURE;
+        }
+        print_replication_report(results, reps, threads < reps ? threads : reps, wall_seconds() - start, seed, lat);
+        free(results);
+        free(lat);
+        return 0;
     }
 
-    // once we exit the while loop it means that the simulation is over 
-printf("\nSimulation finished\n");
-//g_sender.sent is a variable incremented whenever the sender actually pushes a packet into the network.
-//g_sender.lost_local is incremented when the sender randomly drops packet before sending.
-int logical_packets = g_sender.sent + g_sender.lost_local; //total number of data packets the sender intended to send = actually sent to network + locally dropped.
-int unique_ok       = g_receiver.unique_ok; //from Receiver, counts how many different packets were successfully received without duplicates invremented in the receiver
-int total_delivs    = g_receiver.received_ok; // total number of packets accepted at receiver including duplicates.
-int retransmissions = total_delivs - unique_ok; // number of duplicated deliveries due to retransmissions.
-
-printf("Sender logical packets   : %d\n", logical_packets);
-printf("  - scheduled to network : %d\n", g_sender.sent);
-printf("  - local drops          : %d\n", g_sender.lost_local);
-
-printf("Receiver unique packets  : %d\n", unique_ok);
-printf("Receiver total deliveries: %d\n", total_delivs);
-printf("Retransmissions received (due to timeouts) : %d\n", retransmissions);
-printf("Receiver invalid packets : %d\n", g_receiver.invalid_packets);
-
-double avg_delay = (g_net.sum_delay / g_net.count_delay); // calculating the average delay of the network the count delay is incremented everytime a packet is passed to the network 
+    if (pdes_speedup > 0) {
+        cfg.trace_level = TRACE_OFF;
+        if (!pdes_speedup_report(&cfg, seed, pdes_speedup, pdes_window)) {
+            fprintf(stderr, "the parallel runs could not be set up\n");
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
 
-printf("Average one-way network delay: %.6f s (from %d deliveries)\n", avg_delay, g_net.count_delay);
+    SimContext *ctx = malloc(sizeof(SimContext));
+    if (pdes_threads > 0) {
+        // the partitions run at the same time, their lines would be mixed up
+        cfg.trace_level = TRACE_OFF;
+        PdesStats st;
+        if (!ctx || !sim_alloc(ctx, &cfg, seed, 0) || (pkt_log_path && !open_pkt_log(ctx, &pkt_log)) ||
+            !pdes_run(ctx, &cfg, pdes_threads, pdes_window, &st)) {
+            fprintf(stderr, "cannot set up the parallel run of %d flows\n", cfg.n_flows);
+            return EXIT_FAILURE;
+        }
+        write_pkt_log(ctx, pkt_log_path);
+        sim_print_summary(ctx);
+        pdes_print_stats(&st);
+        sim_destroy(ctx);
+        free(ctx);
+        return 0;
+    }
+    if (restore_path) {
+        // same allocation as sim_init, then the state and the events come from the file
+        if (!ctx || !sim_alloc(ctx, &cfg, seed, 0) || !checkpoint_restore(ctx, restore_path)) {
+            fprintf(stderr, "cannot restore the run from %s\n", restore_path);
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "restored %s: t = %.6f s, %ld events handled, %d pending\n",
+                restore_path, sim_seconds(ctx, ctx->now), ctx->events, ctx->queue.pool.in_use);
+    } else if (!ctx || !sim_init(ctx, &cfg, seed, 0)) {
+        fprintf(stderr, "cannot allocate the state of %d flows\n", cfg.n_flows);
+        return EXIT_FAILURE;
+    }
+    if (pkt_log_path && !open_pkt_log(ctx, &pkt_log)) return EXIT_FAILURE;
+    if (ckpt_path) {
+        Checkpointer ckpt;
+        SimTime every = sim_ticks(ctx, ckpt_every);
+        checkpoint_init(&ckpt, ckpt_path, ckpt_at > 0.0 ? sim_ticks(ctx, ckpt_at) : every, every, ctx->now);
+        checkpoint_run(ctx, &ckpt);
+    } else if (rt_speed > 0.0) {
+        RealTime *rt = malloc(sizeof(RealTime));
+        if (!rt || !realtime_init(rt, rt_speed, inject_path, cfg.n_flows)) {
+            fprintf(stderr, "cannot set up the real-time run\n");
+            return EXIT_FAILURE;
+        }
+        realtime_run(ctx, rt);
+        realtime_print_report(rt, stderr);
+        realtime_destroy(rt);
+        free(rt);
+    } else if (precision > 0.0) {
+        adaptive_init(&adapt, ctx, &cfg, precision, batch_s);
+        adaptive_run(ctx, &adapt);
+    } else {
+        sim_run(ctx);
+    }
+    write_pkt_log(ctx, pkt_log_path);
+    sim_print_summary(ctx);
+    if (precision > 0.0) {
+        adaptive_print_report(&adapt, ctx);
+    }
+    if (profile_path) {
+#ifdef SIM_PROFILE
+        if (!profile_write_json(ctx, profile_path)) fprintf(stderr, "cannot write the profile %s\n", profile_path);
+#else
+        fprintf(stderr, "--profile: this sim was built without profiling, rebuild with make clean && make DEFS=-DSIM_PROFILE\n");
+#endif
+    }
+    sim_destroy(ctx);
+    free(ctx);
+    return 0;
 }
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nettrace.h"
+
+int nettrace_open(NetTrace *t, const char *path) {
+    memset(t, 0, sizeof(*t));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(NetTraceHeader)) {
+        fprintf(stderr, "%s: not a network trace (too short)\n", path);
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);   // the mapping keeps the file
+    if (map == MAP_FAILED) {
+        perror(path);
+        return 0;
+    }
+    const NetTraceHeader *h = map;
+    uint64_t room = ((size_t)st.st_size - sizeof(NetTraceHeader)) / sizeof(uint32_t);
+    if (memcmp(h->magic, NETTRACE_MAGIC, 8) != 0 || h->version != NETTRACE_VERSION ||
+        h->n_records == 0 || h->n_records > room || !(h->unit > 0.0) || h->slot < 0.0) {
+        fprintf(stderr, "%s: not a network trace, or an empty or truncated one\n", path);
+        munmap(map, (size_t)st.st_size);
+        return 0;
+    }
+    t->map     = map;
+    t->map_len = (size_t)st.st_size;
+    t->rec     = (const uint32_t *)((const char *)map + sizeof(NetTraceHeader));
+    t->n       = h->n_records;
+    t->slot    = h->slot;
+    t->unit    = h->unit;
+    // the cursors mostly walk forward: the kernel can read ahead more and drop what is behind
+    posix_madvise(map, t->map_len, POSIX_MADV_SEQUENTIAL);
+    return 1;
+}
+
+void nettrace_close(NetTrace *t) {
+    if (t->map) munmap(t->map, t->map_len);
+    t->map = NULL;
+    t->rec = NULL;
+}
+
+// asks for the block that starts at record pos (one call per NETTRACE_READAHEAD bytes read)
+void nettrace_prefetch(const NetTrace *t, uint64_t pos) {
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)&t->rec[pos] & ~(uintptr_t)(page - 1);
+    uintptr_t end   = (uintptr_t)t->map + t->map_len;
+    size_t len = end - start < NETTRACE_READAHEAD ? end - start : NETTRACE_READAHEAD;
+    posix_madvise((void *)start, len, POSIX_MADV_WILLNEED);
+}
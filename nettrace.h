@@ -0,0 +1,71 @@
+#ifndef NETTRACE_H
+#define NETTRACE_H
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Trace-driven network: delays, drops and corruptions replayed from a file captured on a
+real link instead of drawn from base_delay +- jitter (sim --net-trace FILE).
+
+File layout (little endian, written by nettrace_convert from a CSV):
+  header, 32 bytes:
+    char     magic[8]   "SIMNET01"
+    uint32_t version    1
+    uint32_t flags      unused, 0
+    uint64_t n_records
+    double   slot       0 = one record per packet, > 0 = one record per time slot of `slot` seconds
+    double   unit       seconds per delay unit (1e-6 by default)
+  then n_records records of 4 bytes:
+    bit 31       the packet is dropped
+    bit 30       the packet id is corrupted
+    bits 0..29   delay in units (up to 2^30 units, 1073 s at 1 us)
+
+The file is mmapped read-only, nothing is read at startup besides the header, so opening a
+trace of a billion samples costs the same as a small one, and the pages it touches live in the
+page cache (the kernel can drop them again, they are never copied or dirtied).
+
+Per packet, every sending node has its own cursor: it starts at a record drawn from the node's
+random stream (so each replication replays another part of the trace) and moves one record per
+packet, wrapping at the end. Per slot, a packet sent at time t uses record
+(t / slot) mod n whoever sends it. Either way a node's samples only depend on what that node
+did, like the random streams (network.h), so --pdes gives the same results.
+*/
+
+#define NETTRACE_MAGIC      "SIMNET01"
+#define NETTRACE_VERSION    1
+#define NETTRACE_DROP       0x80000000u
+#define NETTRACE_CORRUPT    0x40000000u
+#define NETTRACE_DELAY_MASK 0x3fffffffu
+#define NETTRACE_READAHEAD  (1 << 20)   // bytes asked in advance every time a cursor enters a new block
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t n_records;
+    double   slot;
+    double   unit;
+} NetTraceHeader;
+
+typedef struct NetTrace {
+    void           *map;       // the whole file
+    size_t          map_len;
+    const uint32_t *rec;       // first record (right after the header)
+    uint64_t        n;
+    double          slot;      // seconds, 0 = per packet
+    double          unit;
+} NetTrace;
+
+// returns 0 (and prints why) if the file cannot be mapped or is not a network trace
+int  nettrace_open(NetTrace *t, const char *path);
+void nettrace_close(NetTrace *t);
+
+void nettrace_prefetch(const NetTrace *t, uint64_t pos);
+
+// record number pos of the trace, with a read-ahead hint when pos enters a new block
+static inline uint32_t nettrace_at(const NetTrace *t, uint64_t pos) {
+    if ((pos & (NETTRACE_READAHEAD / sizeof(uint32_t) - 1)) == 0) nettrace_prefetch(t, pos);
+    return t->rec[pos];
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nettrace.h"
+
+/* Turns a CSV of measured delays into the binary trace read by sim --net-trace FILE (nettrace.h).
+   usage: nettrace_convert IN.csv OUT.bin [--slot S] [--unit U]
+   One line per packet (or per slot of S seconds with --slot): delay_s[,drop[,corrupt]]
+   where drop and corrupt are 0 or 1 (0 when missing). Lines that do not start with a number
+   (a header, comments) are skipped. The CSV is read one line at a time and the records are
+   written by blocks, so the input can be much bigger than the memory. */
+int main(int argc, char **argv) {
+    const char *in_path = NULL, *out_path = NULL;
+    double slot = 0.0;    // per packet
+    double unit = 1e-6;   // delays stored in microseconds
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--slot") == 0 && i + 1 < argc)      slot = atof(argv[++i]);
+        else if (strcmp(argv[i], "--unit") == 0 && i + 1 < argc) unit = atof(argv[++i]);
+        else if (!in_path)  in_path  = argv[i];
+        else if (!out_path) out_path = argv[i];
+    }
+    if (!in_path || !out_path || slot < 0.0 || !(unit > 0.0)) {
+        fprintf(stderr, "usage: %s IN.csv OUT.bin [--slot SECONDS] [--unit SECONDS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE *in = fopen(in_path, "r");
+    if (!in) {
+        perror(in_path);
+        return EXIT_FAILURE;
+    }
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        perror(out_path);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+
+    // the header is written first with n_records = 0 and patched once every line is read
+    NetTraceHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, NETTRACE_MAGIC, 8);
+    h.version = NETTRACE_VERSION;
+    h.slot    = slot;
+    h.unit    = unit;
+    fwrite(&h, sizeof(h), 1, out);
+
+    uint32_t buf[4096];
+    int      nbuf = 0;
+    long     skipped = 0, clamped = 0, drops = 0, corrupts = 0;
+    char     line[256];
+    while (fgets(line, sizeof(line), in)) {
+        char *end;
+        double delay = strtod(line, &end);
+        if (end == line) {
+            skipped++;
+            continue;
+        }
+        int drop = 0, corrupt = 0;
+        if (*end == ',') drop = (int)strtol(end + 1, &end, 10);
+        if (*end == ',') corrupt = (int)strtol(end + 1, &end, 10);
+
+        double units = delay / unit + 0.5;
+        uint32_t rec;
+        if (!(units >= 0.0)) {   // also catches nan
+            rec = 0;
+            clamped++;
+        } else if (units > NETTRACE_DELAY_MASK) {
+            rec = NETTRACE_DELAY_MASK;
+            clamped++;
+        } else {
+            rec = (uint32_t)units;
+        }
+        if (drop)    { rec |= NETTRACE_DROP;    drops++; }
+        if (corrupt) { rec |= NETTRACE_CORRUPT; corrupts++; }
+
+        buf[nbuf++] = rec;
+        h.n_records++;
+        if (nbuf == 4096) {
+            fwrite(buf, sizeof(uint32_t), nbuf, out);
+            nbuf = 0;
+        }
+    }
+    fwrite(buf, sizeof(uint32_t), nbuf, out);
+    fclose(in);
+
+    rewind(out);
+    fwrite(&h, sizeof(h), 1, out);
+    if (ferror(out) | fclose(out)) {
+        fprintf(stderr, "%s: write error\n", out_path);
+        return EXIT_FAILURE;
+    }
+    if (h.n_records == 0) {
+        fprintf(stderr, "%s: no record, sim would refuse this trace\n", in_path);
+        return EXIT_FAILURE;
+    }
+    printf("%llu records (%ld dropped, %ld corrupted), %ld lines skipped, %ld delays clamped\n",
+           (unsigned long long)h.n_records, drops, corrupts, skipped, clamped);
+    return 0;
+}
@@ -1,68 +1,391 @@
 #include <stdlib.h> 
-// Provides rand(), RAND_MAX for generating randomness.
 #include <stdio.h>
+#include <string.h>
 #include "network.h"  
 #include "event.h"
+#include "sim.h"
+#include "pktlog.h"
 #define PROB_INVALID 0.05  
 // 5% probability that a DATA packet's ID will be corrupted to an invalid value
 
-/*
-   frand01(): returns a random floating-point number in [0,1].
-   rand() returns an integer between 0 and RAND_MAX.
-   Dividing by RAND_MAX to make it return a number between 0 and 1.
-    */
- double frand01(void) {
-    return rand() / (double)RAND_MAX;
-}
-
 /* Initializes a Network structure with base delay and jitter.
    base_delay = average one-way latency (seconds)
-   jitter = the maximum amount the actual delay can vary above or below base_delay */
-void network_init(Network* n, double base_delay, double jitter) {
+   jitter = the maximum amount the actual delay can vary above or below base_delay
+   trace = delays and losses to replay instead (nettrace.h), NULL = use base_delay and jitter
+   n_nodes = number of nodes, each one gets a port with its own random stream
+   Returns 0 if the ports could not be allocated. */
+int network_init(Network* n, double base_delay, double jitter, const NetTrace *trace, int n_nodes,
+                 unsigned long long seed, unsigned long long stream) {
     n->base_delay  = base_delay;   // Mean delay for every packet
     n->jitter      = jitter;       // Max variation around the mean
-    n->sum_delay   = 0.0;          // Accumulates all delays seen (cumulative sum)
-    n->count_delay = 0;            // Counts how many packets passed through the network
+    n->trace       = trace;
+    n->link_bw     = 0.0;          // no link until network_set_link
+    n->link_shared = 0;
+    memset(&n->shared_link, 0, sizeof(n->shared_link));
+    n->data_bytes  = 1500;
+    n->ctl_bytes   = 40;
+    n->topo        = NULL;         // one hop until network_set_topology
+    n->topo_q      = NULL;
+    n->transit     = NULL;
+    n->transit_cap = 0;
+    n->transit_free = -1;
+    n->hop_events  = 0;
+    n->n_ports     = n_nodes;
+    n->port        = malloc((size_t)n_nodes * sizeof(NetPort));
+    if (!n->port) return 0;
+    for (int i = 0; i < n_nodes; i++) {
+        NetPort *p = &n->port[i];
+        rng_seed(&p->rng, seed, stream, (unsigned long long)i);
+        p->delay_pos   = RNG_BATCH;   // no delay computed yet
+        p->sum_delay   = 0.0;         // Accumulates all delays seen (cumulative sum)
+        p->count_delay = 0;           // Counts how many packets this node passed to the network
+        p->drops       = 0;
+        memset(&p->link, 0, sizeof(p->link));
+        // per-packet trace: every node starts reading at its own random record, so the
+        // replications (other streams) replay other parts of the trace
+        p->trace_pos   = 0;
+        if (trace && trace->slot == 0.0)
+            p->trace_pos = (unsigned long long)(frand01(&p->rng) * (double)trace->n) % trace->n;
+    }
+    return 1;
+}
+
+void network_free(Network* n) {
+    free(n->port);
+    free(n->topo_q);
+    free(n->transit);
+    n->port    = NULL;
+    n->topo_q  = NULL;
+    n->transit = NULL;
+}
+
+// adds the counters of every port, always in node order so the sum is the same in every engine
+void network_totals(const Network* n, double *sum_delay, long *count_delay) {
+    double sum = 0.0;
+    long count = 0;
+    for (int i = 0; i < n->n_ports; i++) {
+        sum   += n->port[i].sum_delay;
+        count += n->port[i].count_delay;
+    }
+    *sum_delay   = sum;
+    *count_delay = count;
+}
+
+// packets dropped by the trace, over every port
+long network_drops(const Network* n) {
+    long drops = 0;
+    for (int i = 0; i < n->n_ports; i++) drops += n->port[i].drops;
+    return drops;
+}
+
+/* Gives every node an outgoing link of bw_bps bits/s that holds buffer_bytes (0 = no limit),
+   carrying DATA packets of data_bytes and control packets (SYN, SYNACK, ACK) of ctl_bytes.
+   A packet then waits for the link to be free and to be sent before its delay starts.
+   ticks_per_s is the clock of the simulation the network belongs to.
+   shared = 1 puts all the senders behind one link instead (a dumbbell: the flows compete for
+   it), while each receiver keeps its own link for its ACKs. */
+void network_set_link(Network* n, double bw_bps, int data_bytes, int ctl_bytes, double buffer_bytes, double ticks_per_s,
+                      int shared) {
+    n->link_bw             = bw_bps;
+    n->link_shared         = shared;
+    n->link_ticks_per_byte = bw_bps > 0.0 ? 8.0 * ticks_per_s / bw_bps : 0.0;
+    n->link_buffer         = buffer_bytes;
+    n->data_bytes          = data_bytes;
+    n->ctl_bytes           = ctl_bytes;
+}
+
+// adds one link to st, now = end of the run (what a link still has to send after it is not counted as busy)
+static void link_queue_add(NetLinkStats *st, const LinkQueue *q, SimTime now) {
+    st->pkts        += q->pkts;
+    st->drops       += q->drops;
+    st->bytes       += q->bytes;
+    st->wait        += q->wait;
+    st->backlog_sum += q->backlog_sum;
+    if (q->wait_max > st->wait_max)       st->wait_max    = q->wait_max;
+    if (q->backlog_max > st->backlog_max) st->backlog_max = q->backlog_max;
+    SimTime busy = q->busy;
+    if (q->busy_until > now) busy -= q->busy_until - now;
+    if (busy > st->busy_max) st->busy_max = busy;
+}
+
+// in node order like network_totals, then the shared link
+void network_link_totals(const Network* n, SimTime now, NetLinkStats *st) {
+    memset(st, 0, sizeof(*st));
+    for (int i = 0; i < n->n_ports; i++) link_queue_add(st, &n->port[i].link, now);
+    if (n->link_shared) link_queue_add(st, &n->shared_link, now);
+}
+
+/* Routes the packets over the topology t (shared, read only). The links of t with a bandwidth
+   get a queue per direction in this network, the others need no state at all.
+   Returns 0 if the queues could not be allocated. */
+int network_set_topology(Network* n, const Topology *t, int data_bytes, int ctl_bytes) {
+    n->topo       = t;
+    n->data_bytes = data_bytes;
+    n->ctl_bytes  = ctl_bytes;
+    if (t->n_queued > 0) {
+        n->topo_q = calloc(2 * (size_t)t->n_links, sizeof(LinkQueue));
+        if (!n->topo_q) return 0;
+    }
+    return 1;
+}
+
+void network_topo_link_totals(const Network* n, SimTime now, NetLinkStats *st) {
+    memset(st, 0, sizeof(*st));
+    if (!n->topo_q) return;
+    for (int d = 0; d < 2 * n->topo->n_links; d++) link_queue_add(st, &n->topo_q[d], now);
+}
+
+/* Changes the delay model of a running network (the branches of sweep.c). The delays the ports
+   computed in advance used the old values, they are thrown away and drawn again. */
+void network_set_delay(Network* n, double base_delay, double jitter) {
+    if (base_delay == n->base_delay && jitter == n->jitter) return;
+    n->base_delay = base_delay;
+    n->jitter     = jitter;
+    for (int i = 0; i < n->n_ports; i++) n->port[i].delay_pos = RNG_BATCH;
+}
+
+/* Computes the next RNG_BATCH delays of a port at once. The loop has no branch (the clamp is a max)
+   so the compiler vectorizes it, and each packet then only reads one entry of the block. */
+static void network_refill_delays(Network* n, NetPort *p) {
+    rng_fill(&p->rng, p->delay_buf, RNG_BATCH);
+    double base = n->base_delay, jitter = n->jitter;
+    for (int i = 0; i < RNG_BATCH; i++) {
+        double d = base + (2.0 * p->delay_buf[i] - 1.0) * jitter;
+        p->delay_buf[i] = d > 0.0 ? d : 0.0;
+    }
+    p->delay_pos = 0;
 }
 
 /* 
    Computes one random network delay
       d = base_delay + (2*R - 1) * jitter
-   where R = random number in [0,1].
+   where R = random number in [0,1) drawn from the generator of the sending node's port (rng.h).
    (2R - 1) generates a random value in [-1, +1].
    Multiplying by jitter gives a random deviation around the base_delay.
-   If the random result is negative, put it  0. */
-double network_rand_delay(Network* n) {
-    double d = n->base_delay + (2.0 * frand01() - 1.0) * n->jitter;
+   If the random result is negative, put it  0.
+   The delays are computed by blocks (network_refill_delays), this only takes the next one. */
+double network_rand_delay(Network* n, NetPort *p) {
+    if (p->delay_pos == RNG_BATCH) network_refill_delays(n, p);
+    return p->delay_buf[p->delay_pos++];
+}
+
+/* A link with a bandwidth (the bottleneck of a node, network_set_link, or a topology link):
+   the packet waits behind the bytes the link has not sent yet, then takes bytes / bandwidth to
+   go out. The link only remembers when it becomes idle (busy_until), so the backlog seen by a new
+   packet is (busy_until - now) * bandwidth and a packet costs a few operations, without any event
+   for its queueing or serialization. buffer = bytes the link holds (0 = no limit).
+   Returns when the last bit of the packet leaves the link, or -1 if the buffer has no room for it
+   (tail drop). */
+static SimTime link_enqueue(LinkQueue *q, SimTime now, int bytes, double ticks_per_byte, double buffer) {
+    SimTime start = q->busy_until > now ? q->busy_until : now;
+    double backlog = (double)(start - now) / ticks_per_byte;   // bytes still queued or being sent
+    if (buffer > 0 && backlog + bytes > buffer) {
+        q->drops++;
+        return -1;
+    }
+    SimTime tx = (SimTime)(bytes * ticks_per_byte + 0.5);
+    q->busy_until = start + tx;
+    q->pkts++;
+    q->bytes       += bytes;
+    q->busy        += tx;
+    q->wait        += start - now;
+    if (start - now > q->wait_max) q->wait_max = start - now;
+    q->backlog_sum += backlog;
+    if (backlog > q->backlog_max) q->backlog_max = backlog;
+    return q->busy_until;
+}
+
+// delay of one topology link: its delay +- its jitter, never negative
+static double topo_link_delay(const TopoLink *l, NetPort *p) {
+    if (l->jitter == 0.0) return l->delay;
+    double d = l->delay + (2.0 * frand01(&p->rng) - 1.0) * l->jitter;
+    return d > 0.0 ? d : 0.0;
+}
 
-    if (d < 0.0) d = 0.0;  
+// number of links between the two nodes of the flow of node dst
+static int topo_route_hops(const Topology *t, int dst) {
+    return t->route_off[NODE_FLOW(dst) + 1] - t->route_off[NODE_FLOW(dst)];
+}
 
-    return d;
+// directed link number hop of the route to dst (the flow's way if dst is its receiver, else the way back)
+static int topo_route_link(const Topology *t, int dst, int hop) {
+    int f = NODE_FLOW(dst);
+    int off = t->route_off[f];
+    if (dst == FLOW_RECEIVER(f)) return t->route[off + hop];
+    return t->route[off + topo_route_hops(t, dst) - 1 - hop] ^ 1;   // the way back: last link first, crossed the other way
+}
+
+static int transit_alloc(Network* n) {
+    if (n->transit_free < 0) {
+        int new_cap = n->transit_cap ? 2 * n->transit_cap : 1024;
+        NetTransit *tr = new_cap <= EVENT_MAX_NODES ? realloc(n->transit, new_cap * sizeof(NetTransit)) : NULL;
+        if (!tr) {
+            fprintf(stderr, "network: cannot track more than %d packets going hop by hop\n", n->transit_cap);
+            exit(EXIT_FAILURE);
+        }
+        for (int i = new_cap - 1; i >= n->transit_cap; i--) {
+            tr[i].next_free = n->transit_free;
+            n->transit_free = i;
+        }
+        n->transit     = tr;
+        n->transit_cap = new_cap;
+    }
+    int idx = n->transit_free;
+    n->transit_free = n->transit[idx].next_free;
+    return idx;
+}
+
+void network_transit_release(Network* n, int idx) {
+    n->transit[idx].next_free = n->transit_free;
+    n->transit_free = idx;
+}
+
+// a DATA copy of flow f whose id the network corrupts, counted in its row of the packet log
+static void log_corrupt(SimContext *ctx, int f, int wire) {
+    // the copy is in flight, so its id is inside the sender's window
+    pktlog_corrupt(ctx->pkt, f, seqwin_unwrap(&ctx->sender.acked[f], wire));
 }
 
 /* Schedules when a packet (packet_id) is delivered from src to dst.
 
    Inputs:
-     now          = current simulation time
-     src, dst     =  sender (0)/receiver(1) IDs
+     ctx          = the simulation (its network and current time are used, the randomness comes from src's port)
+     src, dst     =  sender (2f)/receiver(2f+1) node IDs
      packet_id    = which packet is being delivered
-     recv_handler = function that should run when the packet arrives
+     recv_handler = handler that should run when the packet arrives
+     Go through the sending node's link if there is one (queueing + serialization, or tail drop).
      Compute a random network delay.
      Update total delay 
-     Schedule an event at time (now + delay) that calls recv_handler*/
-void network_schedule_delivery(Network* n, double now,int src, int dst,int packet_id, EventHandler recv_handler)
+     Schedule an event at time (leaves the link + delay, rounded to a tick) that calls recv_handler
+   With a trace the delay, the drop and the corruption come from the next record instead
+   (the one of the current slot for a per-slot trace), and a dropped packet is never delivered.
+   With a topology the delay is the sum of the delays of the links of the route, each link can
+   lose the packet, and a route through links with a bandwidth is crossed hop by hop (net_hop). */
+void network_schedule_delivery(SimContext *ctx, int src, int dst, int packet_id, HandlerId recv_handler)
 {
-    double d = network_rand_delay(n);  
-    n->sum_delay   += d;
-    n->count_delay += 1;
-    int final_pkt_id = packet_id;
-    if (packet_id >= 0) {
-        
-        if (frand01() < PROB_INVALID) {
-            final_pkt_id = -2;
-             printf("[%.3f] Network: CORRUPTED pkt id %d -> %d\n", now, packet_id, final_pkt_id);
+    Network *n = &ctx->net;
+    NetPort *p = &n->port[src];
+    SimTime now = ctx->now;
+    SimTime depart = now;   // when the packet has left the sending node
+    int bytes = recv_handler == H_RCV_RECV_DATA ? n->data_bytes : n->ctl_bytes;
+    if (n->link_bw > 0.0) {
+        LinkQueue *q = n->link_shared && src == FLOW_SENDER(NODE_FLOW(src)) ? &n->shared_link : &p->link;
+        depart = link_enqueue(q, now, bytes, n->link_ticks_per_byte, n->link_buffer);
+        if (depart < 0) {
+            TRACE(ctx, TRACE_DEBUG, TR_LINK_DROP, NODE_FLOW(src), packet_id, src);
+            return;
         }
     }
-    schedule_event(now + d, src, dst, final_pkt_id, recv_handler);
+    double d;
+    int corrupt;
+    if (n->topo) {
+        const Topology *t = n->topo;
+        if (t->route_queued[NODE_FLOW(dst)]) {
+            // the links keep state shared with other flows: one event per hop, in time order
+            int idx = transit_alloc(n);
+            n->transit[idx].sent    = now;
+            n->transit[idx].hop     = 0;
+            n->transit[idx].handler = recv_handler;
+            schedule_event(ctx, depart, idx, dst, packet_id, H_NET_HOP);
+            return;
+        }
+        // fast path: no link of the route has any state, the whole route is drawn at once
+        int n_hops = topo_route_hops(t, dst);   // 0 if both nodes sit on the same topology node
+        d = 0.0;
+        for (int h = 0; h < n_hops; h++) {
+            int li = topo_route_link(t, dst, h) >> 1;
+            const TopoLink *l = &t->link[li];
+            if (l->loss > 0.0 && frand01(&p->rng) < l->loss) {
+                p->drops++;
+                TRACE(ctx, TRACE_DEBUG, TR_LINK_LOSS, NODE_FLOW(src), packet_id, li);
+                return;
+            }
+            d += topo_link_delay(l, p);
+        }
+        corrupt = packet_id >= 0 && frand01(&p->rng) < PROB_INVALID;
+    } else if (n->trace) {
+        const NetTrace *t = n->trace;
+        uint64_t idx;
+        if (t->slot > 0.0) {
+            idx = (uint64_t)(sim_seconds(ctx, now) / t->slot) % t->n;
+        } else {
+            idx = p->trace_pos;
+            if (++p->trace_pos == t->n) p->trace_pos = 0;   // the trace loops
+        }
+        uint32_t rec = nettrace_at(t, idx);
+        if (rec & NETTRACE_DROP) {
+            p->drops++;
+            TRACE(ctx, TRACE_DEBUG, TR_NET_DROP, NODE_FLOW(src), packet_id, dst);
+            return;
+        }
+        d = (rec & NETTRACE_DELAY_MASK) * t->unit;
+        corrupt = packet_id >= 0 && (rec & NETTRACE_CORRUPT);
+    } else {
+        d = network_rand_delay(n, p);
+        corrupt = packet_id >= 0 && frand01(&p->rng) < PROB_INVALID;
+    }
+    double total = sim_seconds(ctx, depart - now) + d;   // queueing + serialization + propagation
+    p->sum_delay   += total;
+    p->count_delay += 1;
+    hist_record(&ctx->lat.one_way, total);
+    int final_pkt_id = packet_id;
+    if (corrupt) {
+        final_pkt_id = -2;
+        TRACE(ctx, TRACE_DEBUG, TR_NET_CORRUPT, NODE_FLOW(src), packet_id, final_pkt_id);
+        if (ctx->pkt && recv_handler == H_RCV_RECV_DATA) log_corrupt(ctx, NODE_FLOW(src), packet_id);
+    }
+    schedule_event(ctx, depart + sim_ticks(ctx, d), src, dst, final_pkt_id, recv_handler);
 }
 
+/* A packet going hop by hop reaches the start of its next link (e->src = its NetTransit record,
+   e->dst = where it goes). The link can lose it, queue it (or drop it if its buffer is full),
+   then the packet either reaches the next node of the route or its destination. The random
+   draws still come from the port of the node that sent the packet. */
+void net_hop(SimContext *ctx, Event *e) {
+    Network *n = &ctx->net;
+    const Topology *t = n->topo;
+    int idx = e->src, dst = e->dst, src = dst ^ 1;   // the two nodes of a flow are 2f and 2f+1
+    NetTransit *tr = &n->transit[idx];
+    NetPort *p = &n->port[src];
+    SimTime now = ctx->now;
+    n->hop_events++;
+
+    int dl = topo_route_link(t, dst, tr->hop);
+    const TopoLink *l = &t->link[dl >> 1];
+    if (l->loss > 0.0 && frand01(&p->rng) < l->loss) {
+        p->drops++;
+        TRACE(ctx, TRACE_DEBUG, TR_LINK_LOSS, NODE_FLOW(src), e->packet_id, dl >> 1);
+        network_transit_release(n, idx);
+        return;
+    }
+    SimTime depart = now;
+    if (l->bw > 0.0) {
+        int bytes = tr->handler == H_RCV_RECV_DATA ? n->data_bytes : n->ctl_bytes;
+        depart = link_enqueue(&n->topo_q[dl], now, bytes, 8.0 * ctx->ticks_per_s / l->bw, l->buffer);
+        if (depart < 0) {
+            TRACE(ctx, TRACE_DEBUG, TR_LINK_DROP, NODE_FLOW(src), e->packet_id, topo_link_from(t, dl));
+            network_transit_release(n, idx);
+            return;
+        }
+    }
+    SimTime arrive = depart + sim_ticks(ctx, topo_link_delay(l, p));
+    if (++tr->hop < topo_route_hops(t, dst)) {
+        schedule_event(ctx, arrive, idx, dst, e->packet_id, H_NET_HOP);
+        return;
+    }
+
+    // last link crossed: the packet is delivered like a one-hop packet would be
+    double total = sim_seconds(ctx, arrive - tr->sent);
+    p->sum_delay   += total;
+    p->count_delay += 1;
+    hist_record(&ctx->lat.one_way, total);
+    int final_pkt_id = e->packet_id;
+    if (final_pkt_id >= 0 && frand01(&p->rng) < PROB_INVALID) {
+        final_pkt_id = -2;
+        TRACE(ctx, TRACE_DEBUG, TR_NET_CORRUPT, NODE_FLOW(src), e->packet_id, final_pkt_id);
+        if (ctx->pkt && tr->handler == H_RCV_RECV_DATA) log_corrupt(ctx, NODE_FLOW(src), e->packet_id);
+    }
+    HandlerId handler = tr->handler;
+    network_transit_release(n, idx);
+    schedule_event(ctx, arrive, src, dst, final_pkt_id, handler);
+}
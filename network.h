@@ -2,17 +2,95 @@
 #define NETWORK_H
 
 #include "event.h"
+#include "rng.h"
+#include "nettrace.h"
+#include "topology.h"
+
+/* Queue of a link with a bandwidth: the link only remembers when it becomes idle, see link_enqueue. */
+typedef struct LinkQueue {
+    SimTime busy_until;           // when the link has sent everything it was given
+    long    pkts;                 // packets accepted by the link
+    long    drops;                // packets refused because the buffer was full
+    double  bytes;
+    SimTime busy;                 // time spent sending
+    SimTime wait;                 // total and longest time packets waited behind others
+    SimTime wait_max;
+    double  backlog_sum;          // bytes queued ahead of each accepted packet, and the most seen
+    double  backlog_max;
+} LinkQueue;
+/* Everything random a node does (its delays, local drops and corruptions) is drawn from
+   its own port, and the delay counters are kept per sending node too. A node's numbers then
+   only depend on what that node did, not on how its events were interleaved with the other
+   nodes', which is what lets the partitions of pdes.c run in parallel and still give the
+   same results as one sequential run. */
+typedef struct NetPort {
+    Rng    rng;
+    double delay_buf[RNG_BATCH];  // delays computed in advance, one block at a time
+    int    delay_pos;             // next unused delay (RNG_BATCH = block used up)
+    double sum_delay;             // delays of the packets this node sent
+    long   count_delay;
+    unsigned long long trace_pos; // next record of a per-packet trace (nettrace.h)
+    long   drops;                 // packets of this node lost in the network (trace drops, lossy topology links)
+    LinkQueue link;               // outgoing bottleneck link (network_set_link), unused by a sender on a shared link
+} NetPort;
+
+// the counters of several links added together (the max fields are the max over the links)
+typedef struct NetLinkStats {
+    long    pkts;
+    long    drops;
+    double  bytes;
+    SimTime wait;
+    SimTime wait_max;
+    double  backlog_sum;
+    double  backlog_max;
+    SimTime busy_max;   // time the busiest link spent sending before `now`
+} NetLinkStats;
+
+/* A packet crossing a multi-hop route whose links have a bandwidth goes hop by hop: its event
+   (handler H_NET_HOP, dst = the destination node) only carries the number of this record in src. */
+typedef struct NetTransit {
+    SimTime   sent;        // when the source handed the packet to the network
+    int       hop;         // next link of the route to cross
+    HandlerId handler;     // what runs at the destination
+    int       next_free;
+} NetTransit;
 
 typedef struct Network {
-    double base_delay;   
-    double jitter;      
-    double sum_delay;    
-    int    count_delay;  
+    double   base_delay;   
+    double   jitter;      
+    int      n_ports;      // one per node
+    NetPort *port;         // port[n] belongs to node n
+    const NetTrace *trace; // replayed delays and losses, NULL = base_delay +- jitter
+    double   link_bw;      // bits/s of each node's outgoing link, 0 = no link (infinite capacity)
+    int      link_shared;  // 1 = the senders all go out through shared_link, the receivers through their own
+    LinkQueue shared_link;
+    double   link_ticks_per_byte;
+    double   link_buffer;  // bytes a link can hold, including the packet being sent (0 = unlimited)
+    int      data_bytes;   // size of a DATA packet on the link
+    int      ctl_bytes;    // size of the SYN, SYNACK, ACK packets
+    const Topology *topo;  // multi-hop routes between the nodes, NULL = one hop (network_set_topology)
+    LinkQueue  *topo_q;    // one queue per direction of every topology link with a bandwidth
+    NetTransit *transit;   // packets going hop by hop
+    int         transit_cap;
+    int         transit_free;
+    long        hop_events;   // H_NET_HOP events handled
 } Network;
-double frand01(void);
-void   network_init(Network* n, double base_delay, double jitter);
-double network_rand_delay(Network* n);
 
-void network_schedule_delivery(Network* n, double now, int src, int dst, int packet_id, EventHandler recv_handler);
+int    network_init(Network* n, double base_delay, double jitter, const NetTrace *trace, int n_nodes,
+                    unsigned long long seed, unsigned long long stream);
+void   network_free(Network* n);
+void   network_set_delay(Network* n, double base_delay, double jitter);
+double network_rand_delay(Network* n, NetPort *p);
+void   network_totals(const Network* n, double *sum_delay, long *count_delay);
+long   network_drops(const Network* n);
+void   network_set_link(Network* n, double bw_bps, int data_bytes, int ctl_bytes, double buffer_bytes, double ticks_per_s,
+                        int shared);
+void   network_link_totals(const Network* n, SimTime now, NetLinkStats *st);
+int    network_set_topology(Network* n, const Topology *t, int data_bytes, int ctl_bytes);
+void   network_topo_link_totals(const Network* n, SimTime now, NetLinkStats *st);
+void   network_transit_release(Network* n, int idx);
+
+void network_schedule_delivery(struct SimContext *ctx, int src, int dst, int packet_id, HandlerId recv_handler);
+void net_hop(struct SimContext *ctx, Event *e);   // handler of H_NET_HOP
 
 #endif
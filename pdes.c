@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "pdes.h"
+
+typedef struct {
+    Pdes *pd;
+    int   p;
+} PdesWorker;
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void pdes_post(SimContext *ctx, SimTime time, int src, int dst, int packet_id, HandlerId handler) {
+    Pdes *pd = ctx->pdes;
+    Mailbox *m = &pd->box[ctx->part * pd->n_parts + pdes_owner(pd, dst)];
+    if (m->n == m->cap) {
+        int new_cap = m->cap ? 2 * m->cap : 256;
+        MailItem *items = realloc(m->items, new_cap * sizeof(MailItem));
+        if (!items) {
+            fprintf(stderr, "pdes_post: cannot grow the mailbox of partition %d\n", ctx->part);
+            exit(EXIT_FAILURE);
+        }
+        m->items = items;
+        m->cap   = new_cap;
+    }
+    MailItem *it = &m->items[m->n++];
+    it->time      = time;
+    it->src       = src;
+    it->dst       = dst;
+    it->packet_id = packet_id;
+    it->handler   = handler;
+    pd->cross_events[ctx->part]++;
+}
+
+void pdes_post_receipt(SimContext *ctx, int f, unsigned long long pkt_id) {
+    ReceiptList *l = &ctx->pdes->receipts[ctx->part];
+    if (l->n == l->cap) {
+        int new_cap = l->cap ? 2 * l->cap : 256;
+        PendingReceipt *items = realloc(l->items, new_cap * sizeof(PendingReceipt));
+        if (!items) {
+            fprintf(stderr, "pdes_post_receipt: cannot grow the receipts of partition %d\n", ctx->part);
+            exit(EXIT_FAILURE);
+        }
+        l->items = items;
+        l->cap   = new_cap;
+    }
+    PendingReceipt *it = &l->items[l->n++];
+    it->time   = ctx->now;
+    it->pkt_id = pkt_id;
+    it->flow   = f;
+}
+
+/* The time to delivery of the first receipts of the last window. Every partition is between
+   two windows, so the senders of the other partitions are not changing, and the packets are
+   not ACKed yet (their ACKs are still in a mailbox), so their first send is still known. */
+static void take_receipts(Pdes *pd, int p) {
+    SimContext *ctx = &pd->parts[p];
+    ReceiptList *l = &pd->receipts[p];
+    for (int i = 0; i < l->n; i++) {
+        const PendingReceipt *it = &l->items[i];
+        SimTime first_sent = sender_first_sent(&ctx->sender, it->flow, it->pkt_id);
+        if (first_sent >= 0) hist_record(&ctx->lat.delivery, sim_seconds(ctx, it->time - first_sent));
+        else                 ctx->lat.delivery_missing++;
+    }
+    l->n = 0;
+}
+
+/* Schedules what the other partitions sent to p during the last window (in partition order,
+   then in the order they were sent). Nothing may be earlier than the end of that window,
+   otherwise p may already have run later events: the lookahead was wrong. */
+static void take_mail(Pdes *pd, int p, SimTime window_end) {
+    SimContext *ctx = &pd->parts[p];
+    for (int q = 0; q < pd->n_parts; q++) {
+        Mailbox *m = &pd->box[q * pd->n_parts + p];
+        for (int i = 0; i < m->n; i++) {
+            MailItem *it = &m->items[i];
+            if (it->time < window_end) {
+                fprintf(stderr, "pdes: event at %.9f from partition %d arrived after the window ending at %.9f (lookahead too large)\n",
+                        sim_seconds(ctx, it->time), q, sim_seconds(ctx, window_end));
+                exit(EXIT_FAILURE);
+            }
+            schedule_event(ctx, it->time, it->src, it->dst, it->packet_id, it->handler);
+        }
+        m->n = 0;
+    }
+}
+
+static void *pdes_worker(void *arg) {
+    PdesWorker *w = arg;
+    Pdes *pd = w->pd;
+    int p = w->p;
+    SimContext *ctx = &pd->parts[p];
+    SimTime window_end = LLONG_MIN;
+    while (1) {
+        take_mail(pd, p, window_end);
+        take_receipts(pd, p);
+        pd->next_time[p] = ctx->stop ? SIM_TIME_MAX : sim_next_time(ctx);
+        pthread_barrier_wait(&pd->barrier);
+
+        // every thread computes the same window from the published times
+        SimTime start = SIM_TIME_MAX;
+        for (int q = 0; q < pd->n_parts; q++)
+            if (pd->next_time[q] < start) start = pd->next_time[q];
+        if (start == SIM_TIME_MAX) break;   // nothing left anywhere
+        window_end = pd->window > SIM_TIME_MAX - start ? SIM_TIME_MAX : start + pd->window;
+        if (p == 0) pd->windows++;
+        sim_run_until(ctx, window_end);
+
+        // the window is over once everybody is here: the mailboxes can be read
+        pthread_barrier_wait(&pd->barrier);
+    }
+    return NULL;
+}
+
+// flows are cut in n_parts contiguous blocks, block p runs in partition p (its receivers in p + 1 with split)
+static int flow_block(int p, int n_flows, int n_parts) {
+    return (int)((long long)p * n_flows / n_parts);
+}
+
+int pdes_run(SimContext *parent, const SimConfig *cfg, int n_parts, double window_s, PdesStats *st) {
+    int n_flows = parent->sender.n_flows;
+    if (n_parts > n_flows) n_parts = n_flows;
+    if (n_parts < 1) n_parts = 1;
+
+    Pdes pd;
+    pd.n_parts      = n_parts;
+    pd.windows      = 0;
+    pd.split        = cfg->split_flows;
+    pd.parts        = malloc(n_parts * sizeof(SimContext));
+    pd.node_part    = malloc(2 * (size_t)n_flows * sizeof(int));
+    pd.box          = calloc((size_t)n_parts * n_parts, sizeof(Mailbox));
+    pd.receipts     = calloc(n_parts, sizeof(ReceiptList));
+    pd.next_time    = malloc(n_parts * sizeof(SimTime));
+    pd.cross_events = calloc(n_parts, sizeof(long));
+    PdesWorker *workers = malloc(n_parts * sizeof(PdesWorker));
+    pthread_t  *threads = malloc(n_parts * sizeof(pthread_t));
+    int ok = pd.parts && pd.node_part && pd.box && pd.receipts && pd.next_time && pd.cross_events && workers && threads;
+
+    if (ok) {
+        for (int p = 0; p < n_parts; p++)
+            for (int f = flow_block(p, n_flows, n_parts); f < flow_block(p + 1, n_flows, n_parts); f++) {
+                pd.node_part[FLOW_SENDER(f)]   = p;
+                pd.node_part[FLOW_RECEIVER(f)] = pd.split ? (p + 1) % n_parts : p;
+            }
+        // the window only has to respect the lookahead if some flow talks across partitions
+        int cut = 0;
+        for (int f = 0; f < n_flows; f++)
+            if (pd.node_part[FLOW_SENDER(f)] != pd.node_part[FLOW_RECEIVER(f)]) cut = 1;
+        // sim_ticks rounds monotonically, so no delay can round below the rounded minimum
+        double min_delay = cfg->base_delay - cfg->jitter;
+        pd.lookahead = min_delay > 0.0 ? sim_ticks(parent, min_delay) : 0;
+        pd.window    = cut ? pd.lookahead : SIM_TIME_MAX;
+        SimTime window = sim_ticks(parent, window_s);
+        if (window > 0 && window < pd.window) pd.window = window;
+        if (pd.window <= 0) {
+            fprintf(stderr, "pdes: partitions exchange packets but the network has no lookahead (jitter >= base delay)\n");
+            ok = 0;
+        }
+    }
+    if (!ok) {
+        free(pd.parts);
+        free(pd.node_part);
+        free(pd.box);
+        free(pd.receipts);
+        free(pd.next_time);
+        free(pd.cross_events);
+        free(workers);
+        free(threads);
+        return 0;
+    }
+
+    double start = wall_seconds();
+    for (int p = 0; p < n_parts; p++) {
+        sim_init_partition(&pd.parts[p], parent, cfg,
+                           flow_block(p, n_flows, n_parts), flow_block(p + 1, n_flows, n_parts));
+        pd.parts[p].pdes = &pd;
+        pd.parts[p].part = p;
+    }
+    pthread_barrier_init(&pd.barrier, NULL, n_parts);
+    // partition 0 runs in this thread; without every thread the barriers could never open
+    for (int p = 0; p < n_parts; p++) {
+        workers[p].pd = &pd;
+        workers[p].p  = p;
+    }
+    for (int p = 1; p < n_parts; p++) {
+        if (pthread_create(&threads[p], NULL, pdes_worker, &workers[p]) != 0) {
+            fprintf(stderr, "pdes: cannot start the thread of partition %d\n", p);
+            exit(EXIT_FAILURE);
+        }
+    }
+    pdes_worker(&workers[0]);
+    for (int p = 1; p < n_parts; p++)
+        pthread_join(threads[p], NULL);
+    pthread_barrier_destroy(&pd.barrier);
+    double wall = wall_seconds() - start;
+
+    // the counters of the partitions go back to parent so sim_collect and sim_print_summary work as usual
+    parent->stop = 1;
+    parent->merged_parts = n_parts;
+    long cross = 0;
+    PdesQueueStats q = {0};
+    for (int p = 0; p < n_parts; p++) {
+        SimContext *c = &pd.parts[p];
+        parent->events += c->events;
+        if (c->now > parent->now) parent->now = c->now;
+        parent->receiver.n_finished += c->receiver.n_finished;
+        parent->timers.armed        += c->timers.armed;
+        parent->timers.cancelled    += c->timers.cancelled;
+        parent->timers.fired        += c->timers.fired;
+        parent->timers.late_cancels += c->timers.late_cancels;
+        // the queues depend on which flows share them: the largest pool, not their sum
+        const EventPool *pool = &c->queue.pool;
+        if (pool->high_water > q.high_water) q.high_water = pool->high_water;
+        if (pool->n_chunks > q.chunks) q.chunks = pool->n_chunks;
+        q.chunk_grows += pool->chunk_grows;
+        q.allocs      += pool->allocs;
+        q.lane_events += c->queue.lane_events;
+        latency_merge(&parent->lat, &c->lat);
+        cross += pd.cross_events[p];
+        sim_destroy(c);
+    }
+    if (st) {
+        st->partitions   = n_parts;
+        st->windows      = pd.windows;
+        st->cross_events = cross;
+        st->lookahead    = sim_seconds(parent, pd.lookahead);
+        st->window       = pd.window == SIM_TIME_MAX ? INFINITY : sim_seconds(parent, pd.window);
+        st->wall         = wall;
+        st->queues       = q;
+    }
+    for (int i = 0; i < n_parts * n_parts; i++)
+        free(pd.box[i].items);
+    free(pd.parts);
+    for (int p = 0; p < n_parts; p++)
+        free(pd.receipts[p].items);
+    free(pd.node_part);
+    free(pd.box);
+    free(pd.receipts);
+    free(pd.next_time);
+    free(pd.cross_events);
+    free(workers);
+    free(threads);
+    return 1;
+}
+
+void pdes_print_stats(const PdesStats *st) {
+    printf("PDES: %d partitions, %ld windows of %g s (lookahead %g s), %ld events between partitions, %.3f s wall\n",
+           st->partitions, st->windows, st->window, st->lookahead, st->cross_events, st->wall);
+    // what sim_print_summary reports for the one queue of a sequential run
+    const PdesQueueStats *q = &st->queues;
+    printf("PDES event pools (one per partition): high-water %d events and %d chunks of %d in the largest, "
+           "%d grown during the run and %ld allocations in all\n",
+           q->high_water, q->chunks, EVENT_POOL_CHUNK, q->chunk_grows, q->allocs);
+    printf("PDES zero-delay lanes: %ld events scheduled for the current time of their partition skipped the priority queue\n",
+           q->lane_events);
+}
+
+static int same_results(const SimResults *a, const SimResults *b) {
+    return a->logical == b->logical && a->sent == b->sent && a->lost_local == b->lost_local &&
+           a->unique == b->unique && a->deliveries == b->deliveries &&
+           a->retransmissions == b->retransmissions && a->invalid == b->invalid &&
+           a->avg_delay == b->avg_delay && a->delivery_ratio == b->delivery_ratio &&
+           a->p99_delay == b->p99_delay && a->p99_rtt == b->p99_rtt && a->p99_delivery == b->p99_delivery &&
+           a->events == b->events && a->end_time == b->end_time;
+}
+
+// 1, 2, 4, ... and max itself even if it is not a power of two
+static int next_thread_count(int t, int max) {
+    return (t < max && 2 * t > max) ? max : 2 * t;
+}
+
+int pdes_speedup_report(const SimConfig *cfg, unsigned long long seed, int max_threads, double window) {
+    SimContext *ctx = malloc(sizeof(SimContext));
+    if (!ctx) return 0;
+    SimResults base, r;
+
+    // reference: the sequential engine on the same seed
+    double start = wall_seconds();
+    if (!sim_init(ctx, cfg, seed, 0)) {
+        sim_destroy(ctx);
+        free(ctx);
+        return 0;
+    }
+    sim_run(ctx);
+    double seq_wall = wall_seconds() - start;
+    sim_collect(ctx, &base);
+    sim_destroy(ctx);
+
+    printf("PDES speedup (seed %llu, %d flows, %ld events)\n", seed, cfg->n_flows, base.events);
+    printf("%8s %8s %10s %10s %12s %8s %10s\n", "threads", "windows", "crossing", "wall_s", "events/s", "speedup", "identical");
+    printf("%8s %8s %10s %10.4f %12.0f %8.2f %10s\n", "seq", "-", "-", seq_wall,
+           seq_wall > 0.0 ? base.events / seq_wall : 0.0, 1.0, "-");
+    int ok = 1;
+    for (int t = 1; ok && t <= max_threads; t = next_thread_count(t, max_threads)) {
+        PdesStats st;
+        // sim_alloc also times the allocation of the flows, like sim_init does for the reference
+        start = wall_seconds();
+        if (!sim_alloc(ctx, cfg, seed, 0) || !pdes_run(ctx, cfg, t, window, &st)) {
+            ok = 0;
+        } else {
+            double wall = wall_seconds() - start;
+            sim_collect(ctx, &r);
+            printf("%8d %8ld %10ld %10.4f %12.0f %8.2f %10s\n", st.partitions, st.windows, st.cross_events, wall,
+                   wall > 0.0 ? r.events / wall : 0.0, wall > 0.0 ? seq_wall / wall : 0.0,
+                   same_results(&base, &r) ? "yes" : "NO");
+        }
+        sim_destroy(ctx);
+    }
+    free(ctx);
+    return ok;
+}
@@ -0,0 +1,127 @@
+#ifndef PDES_H
+#define PDES_H
+#include <pthread.h>
+#include "sim.h"
+
+/*
+Conservative parallel simulation of one run (not of several replications, see replicate.h).
+
+The nodes are split into partitions, one thread each. A partition is a SimContext with its
+own clock, event queue and timers; the flow and network arrays stay those of the main
+context (every partition writes only the entries of its own nodes).
+
+Time advances in windows (YAWNS): before each window every partition publishes the time of
+its next event, the window starts at the smallest one, T, and ends at T + window. Inside the
+window the partitions run without talking to each other. An event for a node of another
+partition is not scheduled directly but appended to a mailbox, and the receiving partition
+takes it after the barrier that ends the window. That is safe as long as such an event is
+never earlier than the end of the window, which the lookahead guarantees: a packet between
+two nodes takes at least base_delay - jitter (the network never delivers faster), so the
+window is at most that long.
+
+The partitioner cuts the flows in contiguous blocks and normally keeps the two nodes of a
+flow together, so in the single-hop network no event crosses partitions at all, the
+lookahead does not limit anything and the partitions run in a single window.
+
+With --pdes-split (SimConfig.split_flows) the receivers of block p run in partition p + 1
+(mod the partitions) instead: every DATA, ACK, SYN and FINISH goes through a mailbox and the
+run advances window by window. Two things of a flow are not carried by its events:
+  - the FINISH, which normally ends both nodes at the same instant. It takes base_delay - jitter
+    instead and each node ends on its own (node_over in sim.c); the sequential reference of
+    --pdes-speedup runs with the same rule, so its results are still comparable.
+  - the first send time of a packet, kept by the sender, which the receiver needs for the time
+    to delivery. The receiver queues the receipt (pdes_post_receipt) and the sample is taken
+    after the window, while no partition runs: the packet is not ACKed yet, so the sender
+    still has it.
+A timer due after the window stays in the wheel (sim_run_until, sim_next_time), where an
+ACK from the mailbox can still cancel it as it would have in the sequential run.
+
+Results are the same as sim_run's: every node draws from its own random stream (network.h)
+and the relative order of the events of one flow does not depend on the other flows.
+*/
+
+// one event on its way to another partition
+typedef struct {
+    SimTime      time;
+    int          src;
+    int          dst;
+    int          packet_id;
+    HandlerId    handler;
+} MailItem;
+
+// a first receipt whose time to delivery needs the sender of another partition
+typedef struct {
+    SimTime            time;
+    unsigned long long pkt_id;
+    int                flow;
+} PendingReceipt;
+
+typedef struct {
+    PendingReceipt *items;
+    int             n;
+    int             cap;
+} ReceiptList;
+
+// filled by one partition during a window, emptied by another one after the barrier:
+// the two never use it at the same time, so no lock is needed
+typedef struct {
+    MailItem *items;
+    int       n;
+    int       cap;
+} Mailbox;
+
+typedef struct Pdes {
+    int                n_parts;
+    SimContext        *parts;
+    int               *node_part;     // partition that runs each node
+    int                split;         // 1 = the nodes of a flow are in different partitions
+    Mailbox           *box;           // box[from * n_parts + to]
+    ReceiptList       *receipts;      // per partition, taken after each window
+    SimTime           *next_time;     // next event of every partition, published before a window
+    long              *cross_events;  // per partition: events posted to another partition
+    SimTime            lookahead;     // smallest delay of an event between two partitions (ticks)
+    SimTime            window;        // SIM_TIME_MAX when no node is cut from its peer
+    long               windows;
+    pthread_barrier_t  barrier;
+} Pdes;
+
+// the event queues of the partitions, which differ from the one queue of the sequential run
+typedef struct {
+    int  high_water;    // largest of one partition
+    int  chunks;        // most chunks of one partition
+    int  chunk_grows;   // summed over the partitions
+    long allocs;
+    long lane_events;
+} PdesQueueStats;
+
+// what pdes_run reports besides the simulation results
+typedef struct {
+    int    partitions;
+    long   windows;
+    long   cross_events;
+    double lookahead;   // seconds
+    double window;      // seconds, INFINITY when the run needs no synchronisation
+    double wall;
+    PdesQueueStats queues;
+} PdesStats;
+
+static inline int pdes_owner(const Pdes *pd, int node) {
+    return pd->node_part[node];
+}
+
+// schedule_event calls this when dst belongs to another partition
+void pdes_post(SimContext *ctx, SimTime time, int src, int dst, int packet_id, HandlerId handler);
+// rcv_recv_data calls this for a first receipt when the flow's sender belongs to another partition
+void pdes_post_receipt(SimContext *ctx, int f, unsigned long long pkt_id);
+
+/* Runs the flows of parent (built with sim_alloc, no event scheduled) on n_parts threads.
+   window > 0 forces shorter windows than the lookahead allows.
+   Afterwards parent holds the counters of the whole run, like after sim_run.
+   Returns 0 if the partitions could not be set up. */
+int  pdes_run(SimContext *parent, const SimConfig *cfg, int n_parts, double window, PdesStats *st);
+void pdes_print_stats(const PdesStats *st);
+
+// runs the same seed sequentially and with 1, 2, 4, ... max_threads partitions and prints the speedup
+int  pdes_speedup_report(const SimConfig *cfg, unsigned long long seed, int max_threads, double window);
+
+#endif
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pktlog.h"
+#include "sim.h"
+
+#define GENERATED ((size_t)-1)   // the column comes from the row number, not from the blocks
+
+// the columns in file order, and where their values are in a block
+static const struct {
+    const char *name;
+    uint32_t    type;
+    uint32_t    width;
+    size_t      field;
+} columns[] = {
+    { "flow",       PKTLOG_I32, sizeof(int32_t),  GENERATED },
+    { "pkt_id",     PKTLOG_U64, sizeof(uint64_t), GENERATED },
+    { "first_send", PKTLOG_I64, sizeof(int64_t),  offsetof(PktLogBlock, first_send) },
+    { "local_drop", PKTLOG_U8,  sizeof(uint8_t),  offsetof(PktLogBlock, local_drop) },
+    { "retx",       PKTLOG_U32, sizeof(uint32_t), offsetof(PktLogBlock, retx) },
+    { "corrupt",    PKTLOG_U32, sizeof(uint32_t), offsetof(PktLogBlock, corrupt) },
+    { "first_recv", PKTLOG_I64, sizeof(int64_t),  offsetof(PktLogBlock, first_recv) },
+    { "ack",        PKTLOG_I64, sizeof(int64_t),  offsetof(PktLogBlock, ack) },
+};
+#define N_COLUMNS ((int)(sizeof(columns) / sizeof(columns[0])))
+
+int pktlog_init(PacketLog *l, int n_flows) {
+    l->n_flows = n_flows;
+    l->failed  = 0;
+    l->flow    = calloc(n_flows, sizeof(PktLogFlow));
+    return l->flow != NULL;
+}
+
+void pktlog_free(PacketLog *l) {
+    if (!l->flow) return;
+    for (int f = 0; f < l->n_flows; f++) {
+        for (uint64_t b = 0; b < l->flow[f].n_blocks; b++) free(l->flow[f].block[b]);
+        free(l->flow[f].block);
+    }
+    free(l->flow);
+    l->flow = NULL;
+}
+
+// packets are sent in id order, so the block of pkt is the next one of the flow
+PktLogBlock *pktlog_grow(PacketLog *l, int f, unsigned long long pkt) {
+    PktLogFlow *fl = &l->flow[f];
+    if (l->failed || (pkt >> PKTLOG_SHIFT) != fl->n_blocks) return NULL;
+    if (fl->n_blocks == fl->cap) {
+        uint64_t cap = fl->cap ? 2 * fl->cap : 4;
+        PktLogBlock **block = realloc(fl->block, cap * sizeof(PktLogBlock *));
+        if (!block) {
+            l->failed = 1;
+            return NULL;
+        }
+        fl->block = block;
+        fl->cap   = cap;
+    }
+    PktLogBlock *b = calloc(1, sizeof(PktLogBlock));
+    if (!b) {
+        l->failed = 1;
+        return NULL;
+    }
+    memset(b->first_recv, 0xff, sizeof(b->first_recv));   // -1 = never
+    memset(b->ack,        0xff, sizeof(b->ack));
+    fl->block[fl->n_blocks++] = b;
+    return b;
+}
+
+// rows of flow f in the file: what it sent, as far as the blocks go
+static uint64_t flow_rows(const PacketLog *l, const SimContext *ctx, int f) {
+    uint64_t sent = ctx->sender.next_pkt_id[f];
+    uint64_t kept = l->flow[f].n_blocks << PKTLOG_SHIFT;
+    return sent < kept ? sent : kept;
+}
+
+static void write_column(FILE *out, const PacketLog *l, const SimContext *ctx, int c) {
+    union {
+        int32_t  flow[PKTLOG_BLOCK];
+        uint64_t pkt_id[PKTLOG_BLOCK];
+    } gen;
+    for (int f = 0; f < l->n_flows; f++) {
+        uint64_t rows = flow_rows(l, ctx, f);
+        for (uint64_t p = 0; p < rows; p += PKTLOG_BLOCK) {
+            size_t n = rows - p < PKTLOG_BLOCK ? (size_t)(rows - p) : PKTLOG_BLOCK;
+            const void *src;
+            if (columns[c].field != GENERATED) {
+                src = (const char *)l->flow[f].block[p >> PKTLOG_SHIFT] + columns[c].field;
+            } else if (c == 0) {
+                for (size_t i = 0; i < n; i++) gen.flow[i] = f;
+                src = gen.flow;
+            } else {
+                for (size_t i = 0; i < n; i++) gen.pkt_id[i] = p + i;
+                src = gen.pkt_id;
+            }
+            fwrite(src, columns[c].width, n, out);
+        }
+    }
+}
+
+static void pad_to(FILE *out, uint64_t off) {
+    static const char zeros[PKTLOG_ALIGN];
+    long at = ftell(out);
+    if (at >= 0 && (uint64_t)at < off) fwrite(zeros, 1, off - (uint64_t)at, out);
+}
+
+int pktlog_write(const PacketLog *l, const char *path, const SimContext *ctx) {
+    uint64_t n_rows = 0;
+    for (int f = 0; f < l->n_flows; f++) n_rows += flow_rows(l, ctx, f);
+
+    PktLogHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PKTLOG_MAGIC, 8);
+    h.version   = PKTLOG_VERSION;
+    h.n_columns = N_COLUMNS;
+    h.n_rows    = n_rows;
+    h.tick      = 1.0 / ctx->ticks_per_s;
+    h.n_flows   = (uint32_t)l->n_flows;
+    h.seed      = ctx->seed;
+
+    // every column starts on a PKTLOG_ALIGN boundary so that it can be mapped alone
+    PktLogColumn dir[N_COLUMNS];
+    memset(dir, 0, sizeof(dir));
+    uint64_t off = sizeof(h) + sizeof(dir);
+    for (int c = 0; c < N_COLUMNS; c++) {
+        off = (off + PKTLOG_ALIGN - 1) & ~(uint64_t)(PKTLOG_ALIGN - 1);
+        strncpy(dir[c].name, columns[c].name, sizeof(dir[c].name));
+        dir[c].type   = columns[c].type;
+        dir[c].width  = columns[c].width;
+        dir[c].offset = off;
+        off += n_rows * columns[c].width;
+    }
+
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        perror(path);
+        return 0;
+    }
+    fwrite(&h, sizeof(h), 1, out);
+    fwrite(dir, sizeof(dir), 1, out);
+    for (int c = 0; c < N_COLUMNS; c++) {
+        pad_to(out, dir[c].offset);
+        write_column(out, l, ctx, c);
+    }
+    int ok = !ferror(out);
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "%s: the packet log could not be written\n", path);
+    if (l->failed) fprintf(stderr, "%s: out of memory during the run, the last packets of some flows are missing\n", path);
+    return ok;
+}
@@ -0,0 +1,137 @@
+#ifndef PKTLOG_H
+#define PKTLOG_H
+#include <stddef.h>
+#include <stdint.h>
+#include "event.h"
+
+struct SimContext;
+
+/*
+Per-packet lifecycle records (sim --pkt-log FILE), one row per DATA packet of every flow,
+written column by column at the end of the run so an analysis tool maps only the columns it
+reads (see pktlog_dump).
+
+During the run the rows live in blocks of PKTLOG_BLOCK packets of one flow, each block holding
+its own short columns. Packet p of flow f is entry p % PKTLOG_BLOCK of block p / PKTLOG_BLOCK of
+the flow: a record is a table lookup and one or two stores, and a flow only allocates a new block
+every PKTLOG_BLOCK packets (the number of packets of a flow is not known in advance, every
+SYNACK the sender receives starts sending). The partitions of --pdes each touch their own flows.
+
+File layout (native byte order):
+  header, 64 bytes:
+    char     magic[8]    "SIMPKT01"
+    uint32_t version     1
+    uint32_t n_columns
+    uint64_t n_rows      packets sent by all the flows, flow 0 first, each flow by packet id
+    double   tick        seconds per tick of the time columns
+    uint32_t n_flows
+    uint32_t unused      0
+    uint64_t seed
+    (16 bytes of padding)
+  then n_columns directory entries of 32 bytes:
+    char     name[16]    NUL-padded
+    uint32_t type        PKTLOG_I32 ... PKTLOG_U8
+    uint32_t width       bytes per value
+    uint64_t offset      of the column in the file, a multiple of PKTLOG_ALIGN (mmap-able alone)
+  then the columns, n_rows values each:
+    flow        int32    flow of the packet
+    pkt_id      uint64   its id inside the flow
+    first_send  int64    tick of the first attempt
+    local_drop  uint8    1 if the sender dropped the first copy before the network
+    retx        uint32   copies resent by a timeout
+    corrupt     uint32   copies whose id the network corrupted
+    first_recv  int64    tick the receiver first got it, -1 = never
+    ack         int64    tick the sender got its first ACK, -1 = never
+*/
+
+#define PKTLOG_MAGIC   "SIMPKT01"
+#define PKTLOG_VERSION 1
+#define PKTLOG_ALIGN   4096
+#define PKTLOG_SHIFT   12
+#define PKTLOG_BLOCK   (1 << PKTLOG_SHIFT)   // packets per block
+
+enum { PKTLOG_I32 = 1, PKTLOG_U32, PKTLOG_I64, PKTLOG_U64, PKTLOG_U8 };
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t n_columns;
+    uint64_t n_rows;
+    double   tick;
+    uint32_t n_flows;
+    uint32_t unused;
+    uint64_t seed;
+    uint8_t  pad[16];
+} PktLogHeader;   // 64 bytes
+
+typedef struct {
+    char     name[16];
+    uint32_t type;
+    uint32_t width;
+    uint64_t offset;
+} PktLogColumn;   // 32 bytes
+
+typedef struct {
+    int64_t  first_send[PKTLOG_BLOCK];
+    int64_t  first_recv[PKTLOG_BLOCK];
+    int64_t  ack[PKTLOG_BLOCK];
+    uint32_t retx[PKTLOG_BLOCK];
+    uint32_t corrupt[PKTLOG_BLOCK];
+    uint8_t  local_drop[PKTLOG_BLOCK];
+} PktLogBlock;
+
+typedef struct {
+    PktLogBlock **block;
+    uint64_t      n_blocks;
+    uint64_t      cap;
+} PktLogFlow;
+
+typedef struct PacketLog {
+    int         n_flows;
+    PktLogFlow *flow;
+    int         failed;    // a block could not be allocated, the packets after it are missing
+} PacketLog;
+
+int  pktlog_init(PacketLog *l, int n_flows);
+void pktlog_free(PacketLog *l);
+// the rows of the packets the flows of ctx have sent, as columns. Returns 0 (and prints why) on failure.
+int  pktlog_write(const PacketLog *l, const char *path, const struct SimContext *ctx);
+PktLogBlock *pktlog_grow(PacketLog *l, int f, unsigned long long pkt);   // new block of packet pkt
+
+// the block of packet pkt of flow f, NULL if the flow has not sent it
+static inline PktLogBlock *pktlog_block(const PacketLog *l, int f, unsigned long long pkt) {
+    const PktLogFlow *fl = &l->flow[f];
+    uint64_t b = pkt >> PKTLOG_SHIFT;
+    return b < fl->n_blocks ? fl->block[b] : NULL;
+}
+
+static inline void pktlog_sent(PacketLog *l, int f, unsigned long long pkt, SimTime now, int dropped) {
+    PktLogBlock *b = pktlog_block(l, f, pkt);
+    if (!b && !(b = pktlog_grow(l, f, pkt))) return;
+    unsigned i = pkt & (PKTLOG_BLOCK - 1);
+    b->first_send[i] = now;
+    b->local_drop[i] = (uint8_t)dropped;
+}
+
+static inline void pktlog_retx(PacketLog *l, int f, unsigned long long pkt) {
+    PktLogBlock *b = pktlog_block(l, f, pkt);
+    if (b) b->retx[pkt & (PKTLOG_BLOCK - 1)]++;
+}
+
+static inline void pktlog_corrupt(PacketLog *l, int f, unsigned long long pkt) {
+    PktLogBlock *b = pktlog_block(l, f, pkt);
+    if (b) b->corrupt[pkt & (PKTLOG_BLOCK - 1)]++;
+}
+
+// only the first time counts: the callers know it from their windows
+static inline void pktlog_received(PacketLog *l, int f, unsigned long long pkt, SimTime now) {
+    PktLogBlock *b = pktlog_block(l, f, pkt);
+    if (b) b->first_recv[pkt & (PKTLOG_BLOCK - 1)] = now;
+}
+
+static inline void pktlog_acked(PacketLog *l, int f, unsigned long long pkt, SimTime now) {
+    PktLogBlock *b = pktlog_block(l, f, pkt);
+    if (b) b->ack[pkt & (PKTLOG_BLOCK - 1)] = now;
+}
+
+#endif
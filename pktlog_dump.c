@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "pktlog.h"
+
+/* Prints columns of a packet log written with sim --pkt-log FILE as CSV, one line per packet.
+   usage: pktlog_dump FILE [COLUMN,COLUMN,...]   (every column by default, times in ticks)
+   Only the columns asked for are mapped, the others are never read from the disk. */
+
+static void print_value(const void *col, uint32_t type, uint64_t r) {
+    switch (type) {
+    case PKTLOG_I32: printf("%" PRId32, ((const int32_t *)col)[r]);  break;
+    case PKTLOG_U32: printf("%" PRIu32, ((const uint32_t *)col)[r]); break;
+    case PKTLOG_I64: printf("%" PRId64, ((const int64_t *)col)[r]);  break;
+    case PKTLOG_U64: printf("%" PRIu64, ((const uint64_t *)col)[r]); break;
+    case PKTLOG_U8:  printf("%u", ((const uint8_t *)col)[r]);        break;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s PKT_LOG [COLUMN,COLUMN,...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int fd = open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    PktLogHeader h;
+    PktLogColumn dir[32];
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, PKTLOG_MAGIC, 8) != 0 ||
+        h.version != PKTLOG_VERSION || h.n_columns > 32 ||
+        pread(fd, dir, h.n_columns * sizeof(PktLogColumn), sizeof(h)) != (ssize_t)(h.n_columns * sizeof(PktLogColumn))) {
+        fprintf(stderr, "%s: not a packet log\n", argv[1]);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    // the columns to print, in the order asked for
+    int pick[32], n_pick = 0;
+    char *list = argc > 2 ? argv[2] : NULL;
+    for (char *name = list ? strtok(list, ",") : NULL; name; name = strtok(NULL, ",")) {
+        int c = 0;
+        while (c < (int)h.n_columns && strncmp(dir[c].name, name, sizeof(dir[c].name)) != 0) c++;
+        if (c == (int)h.n_columns || n_pick == 32) {
+            fprintf(stderr, "%s: no column %s\n", argv[1], name);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        pick[n_pick++] = c;
+    }
+    if (!list)
+        for (int c = 0; c < (int)h.n_columns; c++) pick[n_pick++] = c;
+
+    const void *col[32] = { 0 };
+    for (int c = 0; c < (int)h.n_columns && h.n_rows > 0; c++) {
+        int used = 0;
+        for (int i = 0; i < n_pick; i++) used |= pick[i] == c;
+        if (!used) continue;
+        void *m = mmap(NULL, h.n_rows * dir[c].width, PROT_READ, MAP_SHARED, fd, (off_t)dir[c].offset);
+        if (m == MAP_FAILED) {
+            perror(argv[1]);
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        posix_madvise(m, h.n_rows * dir[c].width, POSIX_MADV_SEQUENTIAL);
+        col[c] = m;
+    }
+    close(fd);   // the mappings keep the file
+
+    printf("# %" PRIu64 " rows, %u flows, seed %" PRIu64 ", tick %g s\n", h.n_rows, h.n_flows, h.seed, h.tick);
+    for (int i = 0; i < n_pick; i++) printf("%s%.16s", i ? "," : "", dir[pick[i]].name);
+    printf("\n");
+    for (uint64_t r = 0; r < h.n_rows; r++) {
+        for (int i = 0; i < n_pick; i++) {
+            if (i) putchar(',');
+            print_value(col[pick[i]], dir[pick[i]].type, r);
+        }
+        putchar('\n');
+    }
+    return 0;
+}
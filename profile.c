@@ -0,0 +1,117 @@
+#include "profile.h"
+
+#ifdef SIM_PROFILE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sim.h"
+
+void profile_init(Profile *p) {
+    for (int i = 0; i < N_HANDLERS; i++)
+        p->handlers[i] = (HandlerProfile){ 0, 0, 0 };
+    p->events      = 0;
+    p->samples     = NULL;
+    p->n_samples   = 0;
+    p->samples_cap = 0;
+    p->max_pending = 0;
+}
+
+void profile_free(Profile *p) {
+    free(p->samples);
+    p->samples = NULL;
+}
+
+long long profile_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// called after every handler (the event is not released yet, so it is not counted as pending)
+void profile_event(SimContext *ctx, HandlerId id, long long ns) {
+    Profile *p = &ctx->prof;
+    HandlerProfile *h = &p->handlers[id];
+    h->calls++;
+    h->ns += ns;
+    if (ns > h->max_ns) h->max_ns = ns;
+
+    int pending = ctx->queue.pool.in_use - 1;
+    if (pending > p->max_pending) p->max_pending = pending;
+    if (p->events++ % PROF_SAMPLE_EVERY != 0) return;
+    if (p->n_samples == p->samples_cap) {
+        int new_cap = p->samples_cap ? 2 * p->samples_cap : 256;
+        PendingSample *s = realloc(p->samples, new_cap * sizeof(PendingSample));
+        if (!s) return;   // the profile loses samples, the run goes on
+        p->samples     = s;
+        p->samples_cap = new_cap;
+    }
+    PendingSample *s = &p->samples[p->n_samples++];
+    s->time   = sim_seconds(ctx, ctx->now);
+    s->events = pending;
+    s->timers = ctx->timers.count;
+}
+
+static void write_sift(FILE *f, const char *name, const SiftStats *s, int last) {
+    fprintf(f, "    \"%s\": {\"ops\": %ld, \"levels\": %ld, \"mean\": %.4f, \"max\": %d}%s\n", name, s->ops, s->levels,
+            s->ops > 0 ? (double)s->levels / s->ops : 0.0, s->max, last ? "" : ",");
+}
+
+int profile_write_json(const SimContext *ctx, const char *path) {
+    const Profile *p = &ctx->prof;
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    long long total_ns = 0;
+    for (int i = 0; i < N_HANDLERS; i++) total_ns += p->handlers[i].ns;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"events\": %ld,\n", p->events);
+    fprintf(f, "  \"end_time\": %.9f,\n", sim_seconds(ctx, ctx->now));
+    fprintf(f, "  \"handler_ns\": %lld,\n", total_ns);
+
+    // handlers that never ran are left out
+    fprintf(f, "  \"handlers\": [\n");
+    int first = 1;
+    for (int i = 0; i < N_HANDLERS; i++) {
+        const HandlerProfile *h = &p->handlers[i];
+        if (h->calls == 0) continue;
+        fprintf(f, "%s    {\"name\": \"%s\", \"calls\": %ld, \"total_ns\": %lld, \"mean_ns\": %.1f, \"max_ns\": %lld, \"share\": %.4f}",
+                first ? "" : ",\n", event_handler_names[i], h->calls, h->ns, (double)h->ns / h->calls, h->max_ns,
+                total_ns > 0 ? (double)h->ns / total_ns : 0.0);
+        first = 0;
+    }
+    fprintf(f, "\n");
+    fprintf(f, "  ],\n");
+
+    const EventQueue *q = &ctx->queue;
+    fprintf(f, "  \"queue\": {\n");
+    if (q->kind == QUEUE_DARY_HEAP) {
+        fprintf(f, "    \"kind\": \"dary\",\n    \"arity\": %d,\n", 1 << q->dary.shift);
+        write_sift(f, "sift_up", &q->dary.sift_up, 0);
+        write_sift(f, "sift_down", &q->dary.sift_down, 1);
+    } else if (q->kind == QUEUE_CALENDAR) {
+        fprintf(f, "    \"kind\": \"calendar\",\n    \"buckets\": %d,\n    \"resizes\": %ld,\n",
+                q->calendar.nbuckets, q->calendar.resizes);
+        write_sift(f, "link_walk", &q->calendar.link_walk, 0);
+        write_sift(f, "day_scan", &q->calendar.day_scan, 1);
+    } else {
+        fprintf(f, "    \"kind\": \"heap\",\n");
+        write_sift(f, "sift_up", &q->heap.sift_up, 0);
+        write_sift(f, "sift_down", &q->heap.sift_down, 1);
+    }
+    fprintf(f, "  },\n");
+
+    const EventPool *pool = &q->pool;
+    fprintf(f, "  \"lane_events\": %ld,\n", q->lane_events);
+    fprintf(f, "  \"allocations\": {\"event_allocs\": %ld, \"pool_high_water\": %d, \"pool_chunks\": %d, "
+               "\"pool_chunk_grows\": %d, \"timers_armed\": %ld, \"timer_nodes\": %d},\n",
+            pool->allocs, pool->high_water, pool->n_chunks, pool->chunk_grows, ctx->timers.armed, ctx->timers.nodes_cap);
+
+    // [time, pending events, armed timers] every sample_every events
+    fprintf(f, "  \"pending\": {\"sample_every\": %d, \"max_events\": %d, \"samples\": [", PROF_SAMPLE_EVERY, p->max_pending);
+    for (int i = 0; i < p->n_samples; i++)
+        fprintf(f, "%s[%.6f, %d, %d]", i ? ", " : "", p->samples[i].time, p->samples[i].events, p->samples[i].timers);
+    fprintf(f, "]}\n}\n");
+    return fclose(f) == 0;
+}
+
+#endif
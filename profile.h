@@ -0,0 +1,76 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+#include "event.h"
+
+/*
+Hot-path profile of a run, only compiled with -DSIM_PROFILE (make DEFS=-DSIM_PROFILE after a
+make clean). Without it every PROF_ macro below is empty and no field is added anywhere,
+so a normal build runs exactly the same code as before.
+
+With it:
+  - every handler call is counted and timed (CLOCK_MONOTONIC, ns),
+  - the number of pending events and armed timers is sampled every PROF_SAMPLE_EVERY events,
+  - the queue backends count how deep their sifts go (levels for the heaps, buckets and list
+    links walked for the calendar queue),
+and sim --profile FILE writes everything as JSON at the end of the run, together with the
+allocation counters of the event pool and the timing wheel.
+*/
+
+// depth statistics of one kind of queue operation
+typedef struct {
+    long ops;      // sifts (or searches) done
+    long levels;   // levels (or steps) summed over all of them
+    int  max;      // deepest one
+} SiftStats;
+
+#ifdef SIM_PROFILE
+
+#define PROF_SAMPLE_EVERY 1024
+
+typedef struct {
+    long         calls;
+    long long    ns;       // total time spent in the handler
+    long long    max_ns;
+} HandlerProfile;
+
+typedef struct {
+    double time;
+    int    events;         // pending events in the queue
+    int    timers;         // armed timers in the wheel
+} PendingSample;
+
+typedef struct Profile {
+    HandlerProfile handlers[N_HANDLERS];   // indexed by HandlerId
+    long           events;
+    PendingSample *samples;
+    int            n_samples;
+    int            samples_cap;
+    int            max_pending;
+} Profile;
+
+struct SimContext;
+
+void      profile_init(Profile *p);
+void      profile_free(Profile *p);
+long long profile_now_ns(void);
+void      profile_event(struct SimContext *ctx, HandlerId h, long long ns);
+int       profile_write_json(const struct SimContext *ctx, const char *path);
+
+#define PROF_HANDLER_START(var)          long long var = profile_now_ns()
+#define PROF_HANDLER_END(ctx, fn, var)   profile_event((ctx), (fn), profile_now_ns() - (var))
+#define PROF_SIFT(stats, depth)                                   \
+    do {                                                          \
+        (stats).ops++;                                            \
+        (stats).levels += (depth);                                \
+        if ((depth) > (stats).max) (stats).max = (depth);         \
+    } while (0)
+
+#else
+
+#define PROF_HANDLER_START(var)          do { } while (0)
+#define PROF_HANDLER_END(ctx, fn, var)   do { } while (0)
+#define PROF_SIFT(stats, depth)          ((void)(depth))
+
+#endif
+
+#endif
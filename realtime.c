@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "realtime.h"
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sleep_until(double wall) {
+    struct timespec ts;
+    ts.tv_sec  = (time_t)wall;
+    ts.tv_nsec = (long)((wall - (double)ts.tv_sec) * 1e9);
+    if (ts.tv_nsec >= 1000000000L) ts.tv_nsec = 999999999L;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+/* --- the injection queue --------------------------------------------------------------
+   head is the last node pushed, tail the next one to take, and the list goes from tail to head
+   through next. The stub keeps the list from ever being empty, so a push never looks at tail. */
+
+void rt_queue_init(RtQueue *q) {
+    atomic_store_explicit(&q->stub.next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&q->head, &q->stub, memory_order_relaxed);
+    q->tail = &q->stub;
+}
+
+void rt_queue_push(RtQueue *q, RtInjected *n) {
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    RtInjected *prev = atomic_exchange_explicit(&q->head, n, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, n, memory_order_release);   // until here the list is cut after prev
+}
+
+RtInjected *rt_queue_pop(RtQueue *q) {
+    RtInjected *tail = q->tail;
+    RtInjected *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (tail == &q->stub) {
+        if (!next) return NULL;
+        q->tail = tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    // tail has no next: it is the last node, or a push is between its exchange and its store
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire)) return NULL;   // the next look gets it
+    rt_queue_push(q, &q->stub);   // the stub goes behind tail so that tail can be taken
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+/* --- the producer of --inject ---------------------------------------------------------- */
+
+// "HANDLER FLOW [PACKET_ID]", blank lines and # comments are skipped
+static void inject_line(RealTime *rt, const char *line) {
+    char name[32];
+    int  flow, pkt = -1;
+    int  n = sscanf(line, "%31s %d %d", name, &flow, &pkt);
+    if (n <= 0 || name[0] == '#') return;
+    int h = 0;
+    while (h < N_HANDLERS && strcmp(event_handler_names[h], name) != 0) h++;
+    if (n < 2 || h == N_HANDLERS || h == H_NET_HOP || flow < 0 || flow >= rt->n_flows ||
+        !realtime_inject(rt, (HandlerId)h, flow, pkt)) {
+        fprintf(stderr, "inject: ignored \"%s\"\n", line);
+        rt->rejected++;
+    }
+}
+
+static void *reader_main(void *arg) {
+    RealTime *rt = arg;
+    char   buf[1024];
+    size_t len = 0;
+    struct pollfd p = { .fd = rt->fd, .events = POLLIN };
+    while (!atomic_load(&rt->quit)) {
+        // a bounded wait so that the end of the run is noticed even if the writer stays silent
+        int r = poll(&p, 1, 100);
+        if (r == 0 || (r < 0 && errno == EINTR)) continue;
+        if (r < 0) break;
+        ssize_t got = read(rt->fd, buf + len, sizeof(buf) - 1 - len);
+        if (got < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (got <= 0) break;   // the writer closed its end
+        len += (size_t)got;
+        buf[len] = '\0';
+        char *start = buf, *nl;
+        while ((nl = strchr(start, '\n')) != NULL) {
+            *nl = '\0';
+            inject_line(rt, start);
+            start = nl + 1;
+        }
+        len -= (size_t)(start - buf);
+        memmove(buf, start, len);
+        if (len == sizeof(buf) - 1) {
+            fprintf(stderr, "inject: line longer than %zu bytes ignored\n", sizeof(buf) - 1);
+            rt->rejected++;
+            len = 0;
+        }
+    }
+    if (len > 0 && !atomic_load(&rt->quit)) {   // a last line without its newline
+        buf[len] = '\0';
+        inject_line(rt, buf);
+    }
+    atomic_fetch_sub(&rt->producers, 1);   // after the last push: the loop may stop once it sees 0
+    return NULL;
+}
+
+int realtime_init(RealTime *rt, double speed, const char *inject_path, int n_flows) {
+    memset(rt, 0, sizeof(*rt));
+    rt->speed   = speed > 0.0 ? speed : 1.0;
+    rt->fd      = -1;
+    rt->n_flows = n_flows;
+    rt_queue_init(&rt->queue);
+    atomic_init(&rt->producers, 0);
+    atomic_init(&rt->quit, 0);
+    hist_init(&rt->lateness);
+    hist_init(&rt->inject_wait);
+    if (!inject_path) return 1;
+    // opening a FIFO waits for its writer: the run starts once the other process is there
+    rt->fd = strcmp(inject_path, "-") == 0 ? STDIN_FILENO : open(inject_path, O_RDONLY);
+    if (rt->fd < 0) {
+        perror(inject_path);
+        return 0;
+    }
+    atomic_store(&rt->producers, 1);
+    if (pthread_create(&rt->reader, NULL, reader_main, rt) != 0) {
+        fprintf(stderr, "%s: cannot start the reader thread\n", inject_path);
+        atomic_store(&rt->producers, 0);
+        return 0;
+    }
+    rt->has_reader = 1;
+    return 1;
+}
+
+int realtime_inject(RealTime *rt, HandlerId handler, int flow, int packet_id) {
+    RtInjected *n = malloc(sizeof(RtInjected));
+    if (!n) return 0;
+    n->handler   = handler;
+    n->flow      = flow;
+    n->packet_id = packet_id;
+    n->posted    = wall_seconds();
+    rt_queue_push(&rt->queue, n);
+    return 1;
+}
+
+/* --- the paced loop -------------------------------------------------------------------- */
+
+static double wall_of(const SimContext *ctx, const RealTime *rt, SimTime t) {
+    return rt->wall0 + sim_seconds(ctx, t - rt->sim_time0) / rt->speed;
+}
+
+// schedules every event taken from the queue at the simulated time of now, returns how many
+static int drain(SimContext *ctx, RealTime *rt) {
+    int n = 0;
+    RtInjected *in;
+    while ((in = rt_queue_pop(&rt->queue)) != NULL) {
+        double  w = wall_seconds();
+        SimTime t = rt->sim_time0 + sim_ticks(ctx, (w - rt->wall0) * rt->speed);
+        if (t < ctx->now) t = ctx->now;   // the loop may run behind the clock, never back in time
+        // the rcv_ handlers run on the receiver of the flow, the others on its sender
+        int node = strncmp(event_handler_names[in->handler], "rcv_", 4) == 0 ? FLOW_RECEIVER(in->flow)
+                                                                              : FLOW_SENDER(in->flow);
+        schedule_event(ctx, t, FLOW_SENDER(in->flow), node, in->packet_id, in->handler);
+        hist_record(&rt->inject_wait, w - in->posted);
+        free(in);
+        rt->injected++;
+        n++;
+    }
+    return n;
+}
+
+void realtime_run(SimContext *ctx, RealTime *rt) {
+    rt->sim_time0 = ctx->now;
+    rt->wall0     = wall_seconds();
+    while (!ctx->stop) {
+        drain(ctx, rt);
+        SimTime t = sim_next_time(ctx);
+        if (t == SIM_TIME_MAX) {
+            // nothing pending: only a producer can still give the run something to do
+            if (atomic_load(&rt->producers) == 0 && drain(ctx, rt) == 0) break;
+            sleep_until(wall_seconds() + RT_POLL_S);
+            continue;
+        }
+        double due = wall_of(ctx, rt, t);
+        double w   = wall_seconds();
+        if (due - w > RT_SPIN_S) {
+            // sleep in slices: an injected event may come before t
+            double wake = due - RT_SPIN_S;
+            sleep_until(wake < w + RT_POLL_S ? wake : w + RT_POLL_S);
+            continue;
+        }
+        while (w < due) w = wall_seconds();   // the last RT_SPIN_S
+        hist_record(&rt->lateness, w - due);
+        rt->paced++;
+        if (w - due > RT_SPIN_S) rt->late++;
+        sim_run_until(ctx, t + 1);   // every event of tick t, the ones they schedule at t included
+        if (ctx->trace.level > TRACE_OFF) fflush(NULL);   // the lines come out when their events fire
+    }
+    atomic_store(&rt->quit, 1);
+    if (rt->has_reader) {
+        pthread_join(rt->reader, NULL);
+        rt->has_reader = 0;
+    }
+}
+
+void realtime_print_report(const RealTime *rt, FILE *out) {
+    fprintf(out, "Real time: speed %g, %ld simulated times paced, %ld late by more than %.1f ms\n",
+            rt->speed, rt->paced, rt->late, 1e3 * RT_SPIN_S);
+    if (rt->fd >= 0 || rt->injected > 0)
+        fprintf(out, "Injected events: %ld scheduled, %ld lines ignored\n", rt->injected, rt->rejected);
+    fprintf(out, "Wall clock (s)       %10s %11s %11s %11s %11s %11s %11s\n",
+            "samples", "mean", "p50", "p90", "p99", "p99.9", "max");
+    hist_print_row(out, "fire lateness", &rt->lateness);
+    if (rt->injected > 0) hist_print_row(out, "inject wait", &rt->inject_wait);
+}
+
+void realtime_destroy(RealTime *rt) {
+    atomic_store(&rt->quit, 1);
+    if (rt->has_reader) {
+        pthread_join(rt->reader, NULL);
+        rt->has_reader = 0;
+    }
+    if (rt->fd > STDIN_FILENO) close(rt->fd);
+    rt->fd = -1;
+    RtInjected *in;
+    while ((in = rt_queue_pop(&rt->queue)) != NULL) free(in);
+}
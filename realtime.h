@@ -0,0 +1,83 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+#include <pthread.h>
+#include <stdatomic.h>
+#include "sim.h"
+
+/*
+Real-time paced execution (sim --realtime SPEED [--inject FILE]), for running the simulator
+next to other local processes as a link emulator.
+
+Simulated time follows the monotonic clock: an event at simulated time t fires at wall time
+start + (t - t0) / SPEED, SPEED = 1 being real time and 2 twice as fast. Before the next event
+the loop sleeps until shortly before its wall time (clock_nanosleep on an absolute time, so
+the sleeps do not drift) and spins the last RT_SPIN_S, because waking up from a sleep is late
+by tens of microseconds. An event whose wall time is already over runs at once: the run falls
+behind instead of skipping anything, and the report shows by how much.
+
+Other threads give events through a lock-free queue with many producers and one consumer
+(Vyukov's intrusive MPSC list): a push is one atomic exchange and one store, the loop drains
+the queue before each event and while it waits, and schedules every injected event at the
+simulated time of the moment it takes it. The loop never waits longer than RT_POLL_S between
+two looks at the queue.
+
+--inject FILE starts one such producer: a thread reading lines from a pipe, a FIFO (mkfifo)
+or - for stdin, one event per line:
+    HANDLER FLOW [PACKET_ID]      e.g.  rcv_recv_data 0 17
+HANDLER is a name of event_handler_names (event.c) except net_hop; the event goes to the node
+of the flow the handler runs on, so it does what the same event from the simulation would do.
+While the producer is open the run does not end when its queue runs dry, only when every flow
+has finished.
+*/
+
+#define RT_SPIN_S 0.0002   // spin instead of sleeping this close to a wall time
+#define RT_POLL_S 0.001    // longest sleep between two looks at the injection queue
+
+// one injected event, allocated by the producer and freed by the loop
+typedef struct RtInjected {
+    struct RtInjected *_Atomic next;
+    HandlerId handler;
+    int       flow;
+    int       packet_id;
+    double    posted;   // wall time of the push (monotonic seconds)
+} RtInjected;
+
+typedef struct {
+    RtInjected *_Atomic head;   // last pushed, producers swap themselves in here
+    RtInjected         *tail;   // next to take, only the consumer touches it
+    RtInjected          stub;
+} RtQueue;
+
+typedef struct RealTime {
+    double       speed;           // simulated seconds per wall second
+    double       wall0;           // wall time of sim_time0
+    SimTime      sim_time0;
+    RtQueue      queue;
+    atomic_int   producers;       // open producers: the run waits for their events
+    atomic_int   quit;            // the run is over, producers stop reading
+    pthread_t    reader;
+    int          has_reader;
+    int          fd;              // what the reader reads, -1 = none
+    int          n_flows;         // flows an injected event may name
+    long         paced;           // simulated times the loop waited for
+    long         late;            // of which the wall time was already over by more than RT_SPIN_S
+    long         injected;
+    long         rejected;        // lines of the producer that name no handler or flow
+    Histogram    lateness;        // actual - scheduled wall time of every paced time (seconds)
+    Histogram    inject_wait;     // push to schedule of every injected event
+} RealTime;
+
+void rt_queue_init(RtQueue *q);
+void rt_queue_push(RtQueue *q, RtInjected *n);     // any thread
+RtInjected *rt_queue_pop(RtQueue *q);              // the loop only, NULL if empty (or a push is half done)
+
+// speed <= 0 is taken as 1. inject_path NULL = no producer, "-" = stdin. Returns 0 if the file cannot be opened.
+int  realtime_init(RealTime *rt, double speed, const char *inject_path, int n_flows);
+// pushes one event for the loop, from any thread. Returns 0 if it could not be allocated.
+int  realtime_inject(RealTime *rt, HandlerId handler, int flow, int packet_id);
+// runs ctx (from sim_init or a restore) paced on the wall clock until every flow has finished
+void realtime_run(SimContext *ctx, RealTime *rt);
+void realtime_print_report(const RealTime *rt, FILE *out);
+void realtime_destroy(RealTime *rt);   // stops and joins the reader, frees what was never taken
+
+#endif
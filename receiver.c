@@ -1,66 +1,160 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include "receiver.h"
-#include "globals.h"
+#include "sim.h"
 #include "network.h"
 #include "sender.h"
+#include "pktlog.h"
+#include "pdes.h"
 
-// id: 0
+// n_flows: one receiver per flow, every array below has one entry per flow
 // received_ok: total packets delivered here
 // unique_ok: number of unique packets
-// invalid_packets: packets with out-of-range IDs
-// seen[]: array marking whether each packet ID was already received 
-void receiver_init(Receiver *r, int id) {
-    r->id              = id;
-    r->received_ok     = 0; 
-    r->unique_ok       = 0; 
-    r->invalid_packets = 0; 
+// invalid_packets: packets whose ID was corrupted by the network
+// seen: sliding window marking whether each packet ID was already received 
+// ack_every, ack_delay: the ACK policy of window mode (receiver.h), ack_every = 0 = one ACK per DATA
+int receiver_init(Receiver *r, int n_flows, int ack_every, SimTime ack_delay) {
+    r->n_flows         = n_flows;
+    r->ack_every       = ack_every;
+    r->ack_delay       = ack_delay;
+    r->received_ok     = calloc(n_flows, sizeof(int)); 
+    r->unique_ok       = calloc(n_flows, sizeof(int)); 
+    r->invalid_packets = calloc(n_flows, sizeof(int)); 
+    r->finished        = calloc(n_flows, 1);
+    r->n_finished      = 0;
+    r->seen            = calloc(n_flows, sizeof(SeqWindow));
+    r->rcv_next        = calloc(n_flows, sizeof(unsigned long long));
+    r->ack_pending     = calloc(n_flows, sizeof(int));
+    r->ack_timer       = calloc(n_flows, sizeof(TimerHandle));
+    if (!r->received_ok || !r->unique_ok || !r->invalid_packets || !r->finished || !r->seen ||
+        !r->rcv_next || !r->ack_pending || !r->ack_timer)
+        return 0;
+    for (int f = 0; f < n_flows; f++)
+        if (!seqwin_init(&r->seen[f])) return 0;
+    return 1;
+}
+
+void receiver_free(Receiver *r) {
+    free(r->received_ok);
+    free(r->unique_ok);
+    free(r->invalid_packets);
+    free(r->finished);
+    for (int f = 0; r->seen && f < r->n_flows; f++) seqwin_free(&r->seen[f]);
+    free(r->seen);
+    free(r->rcv_next);
+    free(r->ack_pending);
+    free(r->ack_timer);
 }
 
 /*
    Handler for receiving a SYN packet during connection startup.*/
-void rcv_recv_syn() {
-    printf("[%.3f] Receiver: RECV SYN -> SEND SYNACK\n", g_now);
+void rcv_recv_syn(SimContext *ctx, Event *e) {
+    int f = NODE_FLOW(e->dst);
+    TRACE(ctx, TRACE_INFO, TR_RCV_SYN, f, 0, 0);
     // Schedule SYNACK to be delivered to the sender.
-    network_schedule_delivery(&g_net,g_now, RECEIVER_ID, SENDER_ID,-1,snd_recv_synack);
+    network_schedule_delivery(ctx, FLOW_RECEIVER(f), FLOW_SENDER(f), -1, H_SND_RECV_SYNACK);
 }
 
 /*Handler for receiving ACK after SYNACK.
    This confirms the connection is established.
    Just prints a message */
-void rcv_recv_ack() {
+void rcv_recv_ack(SimContext *ctx, Event *e) {
    
-    printf("[%.3f] Receiver: RECV ACK (connection established)\n", g_now);
+    TRACE(ctx, TRACE_INFO, TR_RCV_ACK, NODE_FLOW(e->dst), 0, 0);
+}
+
+// window mode: a cumulative ACK with the selective bits of the packets after the gap
+static void rcv_send_ack(SimContext *ctx, int f) {
+    Receiver *r = &ctx->receiver;
+    if (r->ack_timer[f]) timer_cancel(ctx, r->ack_timer[f]);
+    r->ack_timer[f]   = 0;
+    r->ack_pending[f] = 0;
+    unsigned long long cum = r->rcv_next[f];
+    unsigned sack = 0;
+    for (int i = 0; i < SEQ_SACK_BITS; i++)
+        sack |= (unsigned)seqwin_test(&r->seen[f], cum + 1 + i) << i;
+    network_schedule_delivery(ctx, FLOW_RECEIVER(f), FLOW_SENDER(f), seq_ack_wire(cum, sack), H_SND_RECV_DATA_ACK);
+}
+
+// window mode: packet pkt_id arrived (first = not a duplicate), ACK now or later (receiver.h)
+static void rcv_window_ack(SimContext *ctx, int f, unsigned long long pkt_id, int first) {
+    Receiver *r = &ctx->receiver;
+    unsigned long long expected = r->rcv_next[f];
+    while (seqwin_test(&r->seen[f], r->rcv_next[f])) r->rcv_next[f]++;
+    int in_order = first && pkt_id == expected && r->rcv_next[f] == expected + 1;
+    if (!in_order || ++r->ack_pending[f] >= r->ack_every || r->ack_delay == 0) {
+        TRACE(ctx, TRACE_DEBUG, TR_RCV_DATA, f, seq_wire(pkt_id), 0);
+        rcv_send_ack(ctx, f);
+        return;
+    }
+    TRACE(ctx, TRACE_DEBUG, TR_RCV_DATA_HELD, f, seq_wire(pkt_id), 0);
+    if (!r->ack_timer[f])
+        r->ack_timer[f] = timer_arm(ctx, ctx->now + r->ack_delay, FLOW_RECEIVER(f), FLOW_RECEIVER(f), -1, H_RCV_ACK_TIMEOUT);
+}
+
+// the delayed ACK of the packets received in order since the last one
+void rcv_ack_timeout(SimContext *ctx, Event *e) {
+    int f = NODE_FLOW(e->dst);
+    ctx->receiver.ack_timer[f] = 0;
+    if (ctx->receiver.ack_pending[f] > 0) rcv_send_ack(ctx, f);
 }
 
 //   Extract packet_id from the event.
-//   Validate the ID (reject if out of bounds).
+//   Validate the ID (reject if corrupted), then get the full 64-bit id back from the wire id.
 //   Count packet as received (received_ok++).
 //   If never seen before, mark as unique (unique_ok++).
 //   Print debug info.
 //   Schedule an ACK back to the sender.
 
-void rcv_recv_data(Event *e) {
-    int pkt_id = e->packet_id;
-    if (pkt_id < 0 || pkt_id >= RCV_MAX_PKTS) {
-        g_receiver.invalid_packets++;
-        printf("[%.3f] Receiver: RECV DATA with invalid id %d\n", g_now, pkt_id);
+void rcv_recv_data(SimContext *ctx, Event *e) {
+    int f = NODE_FLOW(e->dst);
+    int wire = e->packet_id;
+    if (wire < 0) {
+        ctx->receiver.invalid_packets[f]++;
+        TRACE(ctx, TRACE_DEBUG, TR_RCV_DATA_INVALID, f, wire, 0);
         return;
     }
-    g_receiver.received_ok++;
-    if (!g_receiver.seen[pkt_id]) {
-        g_receiver.seen[pkt_id] = 1; 
-        g_receiver.unique_ok++;     
+    ctx->receiver.received_ok[f]++;
+    SeqWindow *seen = &ctx->receiver.seen[f];
+    unsigned long long pkt_id = seqwin_unwrap(seen, wire);
+    int first = seqwin_set(seen, pkt_id);
+    if (first) {
+        ctx->receiver.unique_ok[f]++;     
+        if (ctx->pkt) pktlog_received(ctx->pkt, f, pkt_id, ctx->now);
+        if (ctx->pdes && pdes_owner(ctx->pdes, FLOW_SENDER(f)) != ctx->part) {
+            pdes_post_receipt(ctx, f, pkt_id);   // the sender runs in another partition (--pdes-split)
+        } else {
+            SimTime first_sent = sender_first_sent(&ctx->sender, f, pkt_id);
+            if (first_sent >= 0) hist_record(&ctx->lat.delivery, sim_seconds(ctx, ctx->now - first_sent));
+            else                 ctx->lat.delivery_missing++;
+        }
     }
 
-    printf("[%.3f] Receiver: RECV DATA #%d -> SEND ACK\n", g_now, pkt_id);
-    network_schedule_delivery(&g_net, g_now, RECEIVER_ID,SENDER_ID,pkt_id, snd_recv_data_ack);
+    if (ctx->receiver.ack_every > 0) {
+        rcv_window_ack(ctx, f, pkt_id, first);
+        return;
+    }
+    TRACE(ctx, TRACE_DEBUG, TR_RCV_DATA, f, wire, 0);
+    network_schedule_delivery(ctx, FLOW_RECEIVER(f), FLOW_SENDER(f), wire, H_SND_RECV_DATA_ACK);
 }
 
 /*Handles FINISH event from sender indicating the end
-   of the simulation. This is the final control message.
-   Sets g_stop_simulation = 1, which causes the main event loop
+   of the flow. This is the final control message of that flow: the events of the flow
+   that are still pending are dropped by sim_run from now on.
+   When every flow of the context has finished, sets ctx->stop = 1, which causes the main event loop
    to exit and prints final statistics. */
-void rcv_recv_finish() {
-    printf("[%.3f] Receiver: RECV FINISH -> stop simulation\n", g_now);
-    g_stop_simulation = 1; 
+void rcv_recv_finish(SimContext *ctx, Event *e) {
+    int f = NODE_FLOW(e->dst);
+    if (ctx->receiver.finished[f]) return;
+    ctx->receiver.finished[f] = 1;
+    ctx->receiver.n_finished++;
+    timer_discard(ctx, ctx->receiver.ack_timer[f]);
+    ctx->receiver.ack_timer[f] = 0;
+    if (ctx->sender.fin_delay == 0) sender_flow_over(ctx, f);
+    TRACE(ctx, TRACE_INFO, TR_RCV_FINISH, f, 0, 0);
+    // a partition of --pdes-split holds receivers of other flows than its senders: it runs until its queue is empty
+    if (ctx->receiver.n_finished == ctx->flow_hi - ctx->flow_lo && !(ctx->pdes && ctx->pdes->split)) {
+        TRACE(ctx, TRACE_INFO, TR_RCV_ALL_FINISHED, -1, ctx->receiver.n_finished, 0);
+        ctx->stop = 1; 
+    }
 }
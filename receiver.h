@@ -2,21 +2,37 @@
 #define RECEIVER_H
 
 #include "event.h"
+#include "seqwin.h"
+#include "timer_wheel.h"
 
-#define RCV_MAX_PKTS 10000
+/* per-flow counters stored as arrays indexed by the flow number (see sender.h)
 
+   ack_every = 0: every DATA is answered with its own ACK (the per-packet protocol).
+   ack_every = N (window mode): an ACK is cumulative (seqwin.h) and goes out after N packets
+   that arrived in order, or ack_delay after the first of them, whichever comes first; a
+   duplicate, a packet out of order or one that fills a gap is answered right away so that
+   the sender learns about the gap. */
 typedef struct Receiver {
-    int id;
-    int received_ok;          
-    int unique_ok;           
-    int invalid_packets;
-    char seen[RCV_MAX_PKTS];  
+    int            n_flows;
+    int            ack_every;
+    SimTime        ack_delay;  // ticks, 0 = no delayed ACK
+    int           *received_ok;
+    int           *unique_ok;
+    int           *invalid_packets;
+    char          *finished;   // 1 once the FINISH of the flow has been received
+    int            n_finished; // the simulation stops when every flow has finished
+    SeqWindow     *seen;       // packets received so far, one sliding window per flow (seqwin.h)
+    unsigned long long *rcv_next;  // window mode: first packet not received yet
+    int           *ack_pending;    // packets received in order since the last ACK
+    TimerHandle   *ack_timer;      // pending delayed ACK
 } Receiver;
 
-void receiver_init(Receiver *r, int id);
-void rcv_recv_syn();
-void rcv_recv_ack();
-void rcv_recv_data(struct Event *e);
-void rcv_recv_finish();
+int  receiver_init(Receiver *r, int n_flows, int ack_every, SimTime ack_delay);
+void receiver_free(Receiver *r);
+void rcv_recv_syn(struct SimContext *ctx, struct Event *e);
+void rcv_recv_ack(struct SimContext *ctx, struct Event *e);
+void rcv_recv_data(struct SimContext *ctx, struct Event *e);
+void rcv_recv_finish(struct SimContext *ctx, struct Event *e);
+void rcv_ack_timeout(struct SimContext *ctx, struct Event *e);
 
 #endif
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "replicate.h"
+
+typedef struct {
+    const SimConfig   *cfg;
+    int                reps;
+    unsigned long long seed;
+    SimResults        *results;
+    LatencyStats      *lat;
+    pthread_mutex_t    lat_lock;
+    atomic_int         next_rep;   // the next replication nobody has taken yet
+    atomic_int         failed;
+} ReplicationJob;
+
+// a worker keeps taking the next replication until there is none left,
+// so fast and slow replications balance themselves over the threads
+static void *replication_worker(void *arg) {
+    ReplicationJob *job = arg;
+    SimContext *ctx = malloc(sizeof(SimContext));
+    if (!ctx) {
+        atomic_store(&job->failed, 1);
+        return NULL;
+    }
+    while (1) {
+        int rep = atomic_fetch_add(&job->next_rep, 1);
+        if (rep >= job->reps) break;
+        if (!sim_init(ctx, job->cfg, job->seed, (unsigned long long)rep)) {
+            atomic_store(&job->failed, 1);
+            sim_destroy(ctx);
+            break;
+        }
+        sim_run(ctx);
+        sim_collect(ctx, &job->results[rep]);
+        if (job->lat) {
+            // adding counters commutes, the pooled histograms do not depend on the order the replications end in
+            pthread_mutex_lock(&job->lat_lock);
+            latency_merge(job->lat, &ctx->lat);
+            pthread_mutex_unlock(&job->lat_lock);
+        }
+        sim_destroy(ctx);
+    }
+    free(ctx);
+    return NULL;
+}
+
+int run_replications(const SimConfig *cfg, int reps, int n_threads, unsigned long long seed, SimResults *results,
+                     LatencyStats *lat) {
+    ReplicationJob job;
+    job.cfg     = cfg;
+    job.reps    = reps;
+    job.seed    = seed;
+    job.results = results;
+    job.lat     = lat;
+    if (lat) latency_init(lat);
+    pthread_mutex_init(&job.lat_lock, NULL);
+    atomic_init(&job.next_rep, 0);
+    atomic_init(&job.failed, 0);
+
+    if (n_threads < 1) n_threads = 1;
+    if (n_threads > reps) n_threads = reps;
+    pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
+    if (!threads) return 0;
+    int started = 0;
+    for (int t = 0; t < n_threads; t++) {
+        if (pthread_create(&threads[t], NULL, replication_worker, &job) != 0) break;
+        started++;
+    }
+    if (started == 0) replication_worker(&job);   // no thread could be created: run everything here
+    for (int t = 0; t < started; t++)
+        pthread_join(threads[t], NULL);
+    free(threads);
+    pthread_mutex_destroy(&job.lat_lock);
+    return !atomic_load(&job.failed);
+}
+
+// two-sided 95% quantile of Student's t distribution, df = 1..30 (above that the normal 1.96 is close enough)
+static double t_quantile_975(int df) {
+    static const double t[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    if (df < 1) return 0.0;
+    if (df <= 30) return t[df - 1];
+    return 1.96;
+}
+
+void estimate(const double *x, int n, Estimate *e) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += x[i];
+    e->mean = n > 0 ? sum / n : 0.0;
+    double ss = 0.0;
+    for (int i = 0; i < n; i++) ss += (x[i] - e->mean) * (x[i] - e->mean);
+    e->stddev = n > 1 ? sqrt(ss / (n - 1)) : 0.0;
+    e->ci95   = n > 1 ? t_quantile_975(n - 1) * e->stddev / sqrt((double)n) : 0.0;
+}
+
+static void print_estimate(const char *name, const double *x, int n) {
+    Estimate e;
+    estimate(x, n, &e);
+    printf("%-24s %14.6f %14.6f %14.6f   [%.6f, %.6f]\n",
+           name, e.mean, e.stddev, e.ci95, e.mean - e.ci95, e.mean + e.ci95);
+}
+
+void print_replication_report(const SimResults *results, int reps, int n_threads, double wall_s, unsigned long long seed,
+                              const LatencyStats *lat) {
+    if (reps <= 0) return;
+    double *x = malloc(reps * sizeof(double));
+    if (!x) return;
+    long events = 0;
+    for (int k = 0; k < reps; k++) events += results[k].events;
+
+    printf("\nReplications: %d on %d threads, %.3f s wall, %.1f replications/s, %.3g events/s\n",
+           reps, n_threads, wall_s, reps / wall_s, events / wall_s);
+    printf("Seed: %llu (replication k uses stream k)\n", seed);
+    printf("%-24s %14s %14s %14s   %s\n", "metric", "mean", "stddev", "ci95 (+/-)", "95% interval");
+
+    for (int k = 0; k < reps; k++) x[k] = results[k].delivery_ratio;
+    print_estimate("delivery ratio", x, reps);
+    for (int k = 0; k < reps; k++) x[k] = (double)results[k].retransmissions;
+    print_estimate("retransmissions", x, reps);
+    for (int k = 0; k < reps; k++) x[k] = results[k].avg_delay;
+    print_estimate("average delay (s)", x, reps);
+    for (int k = 0; k < reps; k++) x[k] = results[k].p99_delay;
+    print_estimate("p99 delay (s)", x, reps);
+    for (int k = 0; k < reps; k++) x[k] = results[k].p99_rtt;
+    print_estimate("p99 RTT (s)", x, reps);
+    for (int k = 0; k < reps; k++) x[k] = results[k].p99_delivery;
+    print_estimate("p99 time to delivery (s)", x, reps);
+    for (int k = 0; k < reps; k++) x[k] = (double)results[k].logical;
+    print_estimate("logical packets", x, reps);
+    free(x);
+    if (lat) {
+        printf("\nAll replications pooled\n");
+        latency_print(stdout, lat);
+    }
+}
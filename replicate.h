@@ -0,0 +1,27 @@
+#ifndef REPLICATE_H
+#define REPLICATE_H
+#include "sim.h"
+
+/*
+Monte Carlo replications: the same configuration is run K times with K independent
+random streams (stream k = replication k), spread over a pool of worker threads.
+Each worker builds its own SimContext, so the replications share nothing but the
+read-only configuration, the results array (one slot per replication) and the pooled
+latency histograms, which every replication adds its own to under a lock.
+*/
+
+typedef struct {
+    double mean;
+    double stddev;   // sample standard deviation over the replications
+    double ci95;     // half-width of the 95% confidence interval of the mean (Student t)
+} Estimate;
+
+// runs reps replications on n_threads threads, results[k] receives replication k and lat (if not NULL)
+// the histograms of all of them merged; returns 0 if a replication could not be set up
+int  run_replications(const SimConfig *cfg, int reps, int n_threads, unsigned long long seed, SimResults *results,
+                      LatencyStats *lat);
+void estimate(const double *x, int n, Estimate *e);
+void print_replication_report(const SimResults *results, int reps, int n_threads, double wall_s, unsigned long long seed,
+                              const LatencyStats *lat);
+
+#endif
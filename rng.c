@@ -0,0 +1,50 @@
+#include <string.h>
+#include "rng.h"
+
+static inline unsigned long long rotl(unsigned long long x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// stream = replication number, node = node id: they go through splitmix64 one after the other
+// so nearby values give unrelated states (and (stream 1, node 0) is not (stream 0, node 1))
+void rng_seed(Rng *r, unsigned long long seed, unsigned long long stream, unsigned long long node) {
+    unsigned long long x = seed ^ splitmix64(&stream);
+    x = splitmix64(&x) ^ node;
+    for (int l = 0; l < RNG_LANES; l++)
+        for (int k = 0; k < 4; k++)
+            r->s[k][l] = splitmix64(&x);
+    r->pos = RNG_BATCH;   // the buffer is filled on the first draw
+}
+
+/* One xoshiro256++ step per lane per iteration. The state is copied to local arrays so the
+   compiler can keep it in vector registers for the whole loop.
+   The double is built from the 52 high bits: exponent of 1.0 + mantissa gives [1,2), minus 1
+   gives [0,1), which vectorizes better than a 64-bit integer to double conversion. */
+void rng_fill(Rng *r, double *out, int n) {
+    unsigned long long s0[RNG_LANES], s1[RNG_LANES], s2[RNG_LANES], s3[RNG_LANES];
+    memcpy(s0, r->s[0], sizeof(s0));
+    memcpy(s1, r->s[1], sizeof(s1));
+    memcpy(s2, r->s[2], sizeof(s2));
+    memcpy(s3, r->s[3], sizeof(s3));
+    for (int i = 0; i < n; i += RNG_LANES) {
+        for (int l = 0; l < RNG_LANES; l++) {
+            unsigned long long result = rotl(s0[l] + s3[l], 23) + s0[l];
+            unsigned long long t = s1[l] << 17;
+            s2[l] ^= s0[l];
+            s3[l] ^= s1[l];
+            s1[l] ^= s2[l];
+            s0[l] ^= s3[l];
+            s2[l] ^= t;
+            s3[l] = rotl(s3[l], 45);
+
+            unsigned long long bits = (result >> 12) | 0x3FF0000000000000ULL;
+            double d;
+            memcpy(&d, &bits, sizeof(d));
+            out[i + l] = d - 1.0;
+        }
+    }
+    memcpy(r->s[0], s0, sizeof(s0));
+    memcpy(r->s[1], s1, sizeof(s1));
+    memcpy(r->s[2], s2, sizeof(s2));
+    memcpy(r->s[3], s3, sizeof(s3));
+}
@@ -0,0 +1,48 @@
+#ifndef RNG_H
+#define RNG_H
+
+/*
+Random numbers of one node of a simulation.
+rand() has a single hidden state for the whole process, so two simulations running in
+two threads would share (and race on) it. Every node owns an Rng instead (see network.h),
+seeded from (seed, stream, node): replication k of a run always gets the same independent
+sequences, and what a node draws does not depend on the order in which the other nodes
+run, so the parallel engine (pdes.h) draws exactly the same numbers as the sequential one.
+
+Generator: xoshiro256++ (Blackman, Vigna 2019), run as RNG_LANES independent generators
+side by side. rng_fill() advances all the lanes with the same instructions, so the
+compiler turns the lane loop into vector code, and the uniforms are produced RNG_BATCH
+at a time into a buffer: frand01() is then just a buffer read.
+The same (seed, stream) always gives the same numbers in the same order.
+*/
+
+#define RNG_LANES 4
+#define RNG_BATCH 32    // multiple of RNG_LANES, small because every node has its own buffer
+
+typedef struct {
+    unsigned long long s[4][RNG_LANES];  // state word k of lane l is s[k][l] (lanes contiguous for the vector loop)
+    double             buf[RNG_BATCH];   // uniforms not used yet
+    int                pos;              // next unused entry of buf (RNG_BATCH = empty)
+} Rng;
+
+// splitmix64 (Steele, Lea, Flood 2014): only used to spread a seed over the xoshiro state
+static inline unsigned long long splitmix64(unsigned long long *x) {
+    unsigned long long z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng *r, unsigned long long seed, unsigned long long stream, unsigned long long node);
+void rng_fill(Rng *r, double *out, int n);   // n uniforms in [0,1), n must be a multiple of RNG_LANES
+
+// uniform double in [0,1)
+static inline double frand01(Rng *r) {
+    if (r->pos == RNG_BATCH) {
+        rng_fill(r, r->buf, RNG_BATCH);
+        r->pos = 0;
+    }
+    return r->buf[r->pos++];
+}
+
+#endif
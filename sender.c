@@ -1,107 +1,437 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include "sender.h"
-#include "globals.h"
+#include "sim.h"
 #include "network.h"
 #include "receiver.h"
-#define RTO 0.05
-// RTO = Retransmission TimeOut (seconds).
+#include "pktlog.h"
+// RTO = Retransmission TimeOut (--rto, 0.05 s by default), kept in ticks in Sender.rto_ticks.
 // If no ACK is received within RTO after sending a packet (or SYN),
 // the sender will retransmit.
 
+// bounds of the adaptive RTO of window mode (seconds)
+#define WIN_RTO_MIN 0.001
+#define WIN_RTO_MAX 60.0
+
 /*
-     id             = SENDER_ID (0)
-     send_interval_s= time between sending consecutive data packets
-     duration_s     = total sending duration of the flow
+   Events are always addressed to the node whose state their handler uses (dst), so the
+   sender's own events (send SYN, send DATA, timeouts) go from the sender node to itself.
+   pdes.c relies on this to know which partition runs an event.
+
+     ctx             = the simulation the flows belong to (ctx->sender is initialised)
+     n_flows         = number of sender/receiver pairs
+     send_interval_s = time between sending consecutive data packets (one value per flow)
+     duration_s      = total sending duration (one value per flow)
+     rto_s           = retransmission timeout (seconds)
+     loss            = probability that a DATA packet is dropped before it reaches the network
+     window          = packets in flight per flow (window mode), 0 = the per-packet protocol
+   Returns 0 if the per-flow arrays could not be allocated.
  */
-void sender_init(Sender *s, int id, double send_interval_s, double duration_s) {
-    s->id            = id;                // logical ID used in events
-    s->sent          = 0;                 // number of packets actually sent into the network
-    s->lost_local    = 0;                 // number of packets dropped locally before network
-    s->next_pkt_id   = 0;                 // next data packet ID to use (starts from 0)
-    s->send_interval = send_interval_s;   // time between consecutive data sends
-    s->duration      = duration_s;        // overall sending duration
-    s->syn_acked     = 0;                 // 0 until SYNACK is received
+int sender_init(SimContext *ctx, int n_flows, const double *send_interval_s, const double *duration_s,
+                double rto_s, double loss, int window) {
+    Sender *s = &ctx->sender;
+    s->n_flows       = n_flows;
+    s->rto_ticks     = sim_ticks(ctx, rto_s);
+    s->loss          = loss;
+    s->window        = window;
+    s->fin_delay     = 0;
+    s->sent          = calloc(n_flows, sizeof(int));          // number of packets actually sent into the network
+    s->lost_local    = calloc(n_flows, sizeof(int));          // number of packets dropped locally before network
+    s->next_pkt_id   = calloc(n_flows, sizeof(unsigned long long)); // next data packet ID to use (starts from 0)
+    s->send_interval = malloc(n_flows * sizeof(SimTime));     // time between consecutive data sends (ticks)
+    s->duration      = malloc(n_flows * sizeof(SimTime));     // overall sending duration (ticks)
+    s->syn_acked     = calloc(n_flows, 1);                    // 0 until SYNACK is received
+    s->acked         = calloc(n_flows, sizeof(SeqWindow));
+    s->syn_timer     = calloc(n_flows, sizeof(TimerHandle));
+    s->n_slots       = malloc(n_flows * sizeof(int));
+    s->rto           = calloc(n_flows, sizeof(RtoSlot *));
+    s->snd_base      = calloc(n_flows, sizeof(unsigned long long));
+    s->snd_next      = calloc(n_flows, sizeof(unsigned long long));
+    s->srtt          = malloc(n_flows * sizeof(double));
+    s->rttvar        = calloc(n_flows, sizeof(double));
+    s->cur_rto       = malloc(n_flows * sizeof(SimTime));
+    s->rtx_timer     = calloc(n_flows, sizeof(TimerHandle));
+    s->done          = calloc(n_flows, 1);
+    if (!s->sent || !s->lost_local || !s->next_pkt_id || !s->send_interval || !s->duration ||
+        !s->syn_acked || !s->acked || !s->syn_timer || !s->n_slots || !s->rto || !s->snd_base || !s->snd_next ||
+        !s->srtt || !s->rttvar || !s->cur_rto || !s->rtx_timer || !s->done)
+        return 0;
+
+    for (int f = 0; f < n_flows; f++) {
+        s->send_interval[f] = sim_ticks(ctx, send_interval_s[f]);
+        s->duration[f]      = sim_ticks(ctx, duration_s[f]);
+        if (!seqwin_init(&s->acked[f])) return 0;
+        s->n_slots[f] = RTO_SLOTS;
+        while (s->n_slots[f] < window) s->n_slots[f] *= 2;   // a full window needs no growing
+        s->rto[f] = calloc(s->n_slots[f], sizeof(RtoSlot));
+        if (!s->rto[f]) return 0;
+        s->srtt[f]    = -1.0;
+        s->cur_rto[f] = s->rto_ticks;   // until the first RTT sample
+    }
+    return 1;
+}
 
+// starts flow f in ctx: its first events go to ctx's queue and timers
+void sender_start(SimContext *ctx, int f) {
     // Schedule sending of SYN at time 0.0.
     // This starts the connection handshake.
-    schedule_event(0.0,  s->id, RECEIVER_ID, -1, snd_send_syn);
-    // Schedule a timeout event for the SYN.
-    // If no SYNACK is received by g_now + RTO, snd_timeout will be called.
-    schedule_event(RTO,  s->id, s->id, -1, snd_timeout);
+    schedule_event(ctx, 0, FLOW_SENDER(f), FLOW_SENDER(f), -1, H_SND_SEND_SYN);
+    // Arm a timer for the SYN.
+    // If no SYNACK is received by ctx->now + RTO, snd_timeout will be called (the SYNACK cancels it).
+    ctx->sender.syn_timer[f] = timer_arm(ctx, ctx->sender.rto_ticks, FLOW_SENDER(f), FLOW_SENDER(f), -1, H_SND_TIMEOUT);
+}
+
+void sender_free(Sender *s) {
+    free(s->sent);
+    free(s->lost_local);
+    free(s->next_pkt_id);
+    free(s->send_interval);
+    free(s->duration);
+    free(s->syn_acked);
+    for (int f = 0; s->acked && f < s->n_flows; f++) seqwin_free(&s->acked[f]);
+    free(s->acked);
+    free(s->syn_timer);
+    for (int f = 0; s->rto && f < s->n_flows; f++) free(s->rto[f]);
+    free(s->rto);
+    free(s->n_slots);
+    free(s->snd_base);
+    free(s->snd_next);
+    free(s->srtt);
+    free(s->rttvar);
+    free(s->cur_rto);
+    free(s->rtx_timer);
+    free(s->done);
+}
+
+/* The slot of a new packet pkt_id. Every packet not ACKed yet is in [acked.base, pkt_id], so
+   while that span fits in the ring no two of them share a slot and no armed timer is ever
+   overwritten. When it does not fit the ring doubles: the ids from base on move to their slot
+   in the larger ring. */
+static RtoSlot *sender_new_slot(Sender *s, int f, unsigned long long pkt_id) {
+    unsigned long long base = s->acked[f].base;
+    if (pkt_id - base >= (unsigned long long)s->n_slots[f]) {
+        int n = s->n_slots[f];
+        while ((unsigned long long)n <= pkt_id - base && n < (1 << 30)) n *= 2;
+        RtoSlot *rto = (unsigned long long)n > pkt_id - base ? calloc(n, sizeof(RtoSlot)) : NULL;
+        if (!rto) {
+            fprintf(stderr, "sender: cannot keep the timeouts of %llu packets in flight\n", pkt_id - base + 1);
+            exit(EXIT_FAILURE);
+        }
+        for (unsigned long long id = base; id < base + (unsigned long long)s->n_slots[f]; id++)
+            rto[id & (unsigned long long)(n - 1)] = *sender_slot(s, f, id);
+        free(s->rto[f]);
+        s->rto[f]     = rto;
+        s->n_slots[f] = n;
+    }
+    return sender_slot(s, f, pkt_id);
+}
+
+SimTime sender_first_sent(const Sender *s, int f, unsigned long long pkt_id) {
+    const RtoSlot *slot = sender_slot(s, f, pkt_id);
+    return slot->pkt_id == pkt_id ? slot->first_sent : -1;
+}
+
+/* Once the flow is over its timers would only be moved to the queue to be dropped there, and how many
+   of them got that far would depend on when the rest of the run stops (with --pdes, when the last flow
+   of the partition ends), so they are cancelled. */
+void sender_flow_over(SimContext *ctx, int f) {
+    Sender *s = &ctx->sender;
+    timer_discard(ctx, s->syn_timer[f]);
+    s->syn_timer[f] = 0;
+    timer_discard(ctx, s->rtx_timer[f]);
+    s->rtx_timer[f] = 0;
+    for (int i = 0; i < s->n_slots[f]; i++) {
+        timer_discard(ctx, s->rto[f][i].timer);
+        s->rto[f][i].timer = 0;
+    }
+}
+
+// the last message of flow f: the receiver ends the flow when it gets it (see node_over in sim.c)
+static void snd_finish(SimContext *ctx, int f) {
+    ctx->sender.done[f] = 2;
+    if (ctx->sender.fin_delay > 0) sender_flow_over(ctx, f);   // the sender is over now, not with the FINISH
+    schedule_event(ctx, ctx->now + ctx->sender.fin_delay, FLOW_SENDER(f), FLOW_RECEIVER(f), -1, H_RCV_RECV_FINISH);
 }
 
 //  Ask the network to deliver a SYN to the receive by scheduling an event with handler rcv_recv_syn.
-void snd_send_syn() {
-    printf("[%.3f] Sender: SEND SYN\n", g_now);
-    network_schedule_delivery(&g_net, g_now, SENDER_ID, RECEIVER_ID, -1, rcv_recv_syn);
+void snd_send_syn(SimContext *ctx, Event *e) {
+    int f = NODE_FLOW(e->src);
+    TRACE(ctx, TRACE_INFO, TR_SND_SYN, f, 0, 0);
+    network_schedule_delivery(ctx, FLOW_SENDER(f), FLOW_RECEIVER(f), -1, H_RCV_RECV_SYN);
 }
 
     //  1) Mark syn_acked = 1 (handshake success).
     //  2) Log that SYNACK was received.
     //  3) Send an ACK back to the receiver to complete handshake.
     //  4) either schedule the first data send or, if duration already passed, schedule finish.
-void snd_recv_synack() {
-    g_sender.syn_acked = 1;  
-
-    printf("[%.3f] Sender: RECV SYNACK -> SEND ACK, start data\n", g_now);
-    network_schedule_delivery(&g_net, g_now, SENDER_ID, RECEIVER_ID, -1, rcv_recv_ack);
-    double first_time = g_now + g_sender.send_interval;
-    if (first_time <= g_sender.duration) {
-        schedule_event(first_time, SENDER_ID, RECEIVER_ID, -1, snd_send_data);
+void snd_recv_synack(SimContext *ctx, Event *e) {
+    int f = NODE_FLOW(e->dst);
+    // in window mode a duplicate SYNACK only gets its ACK, a second chain of sends would double the flow's rate
+    int again = ctx->sender.window > 0 && ctx->sender.syn_acked[f];
+    ctx->sender.syn_acked[f] = 1;  
+    timer_cancel(ctx, ctx->sender.syn_timer[f]);   // the SYN timeout is not needed anymore
+    ctx->sender.syn_timer[f] = 0;
+
+    TRACE(ctx, TRACE_INFO, TR_SND_SYNACK, f, 0, 0);
+    network_schedule_delivery(ctx, FLOW_SENDER(f), FLOW_RECEIVER(f), -1, H_RCV_RECV_ACK);
+    if (again) return;
+    SimTime first_time = ctx->now + ctx->sender.send_interval[f];
+    if (first_time <= ctx->sender.duration[f]) {
+        schedule_event(ctx, first_time, FLOW_SENDER(f), FLOW_SENDER(f), -1, H_SND_SEND_DATA);
+    } else {
+        snd_finish(ctx, f);
+    }
+}
+
+/* ---------------------------------------------------------------- window mode
+
+   The application still produces one packet every send_interval (snd_send_data), but a packet
+   only goes out when the flow has fewer than `window` packets in flight; the others wait in
+   [snd_next, next_pkt_id). An ACK says which packets arrived (seqwin.h), moves snd_base past
+   them and lets the waiting packets out. Per packet that is one DATA and, with delayed ACKs,
+   about 1 / ack_every ACK events, and no timer event at all while ACKs keep coming. */
+
+// (re)starts the flow's timer if packets are in flight, stops it otherwise
+static void win_arm(SimContext *ctx, int f) {
+    Sender *s = &ctx->sender;
+    if (s->rtx_timer[f]) timer_cancel(ctx, s->rtx_timer[f]);
+    s->rtx_timer[f] = 0;
+    if (s->snd_base[f] < s->snd_next[f])
+        s->rtx_timer[f] = timer_arm(ctx, ctx->now + s->cur_rto[f], FLOW_SENDER(f), FLOW_SENDER(f), -1, H_SND_RTX_TIMEOUT);
+}
+
+// first transmission of packet pkt_id, which may be dropped locally like in the per-packet protocol
+static void win_send_new(SimContext *ctx, int f, unsigned long long pkt_id) {
+    Sender *s = &ctx->sender;
+    int snd = FLOW_SENDER(f);
+    int wire = seq_wire(pkt_id);
+    int dropped = frand01(&ctx->net.port[snd].rng) < s->loss;
+    if (ctx->pkt) pktlog_sent(ctx->pkt, f, pkt_id, ctx->now, dropped);
+    if (dropped) {
+        s->lost_local[f]++;
+        TRACE(ctx, TRACE_DEBUG, TR_SND_LOCAL_DROP, f, wire, 0);
+    } else {
+        TRACE(ctx, TRACE_DEBUG, TR_SND_DATA, f, wire, 0);
+        network_schedule_delivery(ctx, snd, FLOW_RECEIVER(f), wire, H_RCV_RECV_DATA);
+        s->sent[f]++;
+    }
+    RtoSlot *slot = sender_new_slot(s, f, pkt_id);
+    slot->timer      = 0;
+    slot->pkt_id     = pkt_id;
+    slot->first_sent = ctx->now;
+    slot->last_sent  = ctx->now;
+}
+
+// sends the waiting packets the window has room for
+static void win_fill(SimContext *ctx, int f) {
+    Sender *s = &ctx->sender;
+    int idle = s->snd_base[f] == s->snd_next[f];
+    while (s->snd_next[f] < s->next_pkt_id[f] && s->snd_next[f] - s->snd_base[f] < (unsigned long long)s->window)
+        win_send_new(ctx, f, s->snd_next[f]++);
+    if (idle) win_arm(ctx, f);
+}
+
+// FINISH goes once the duration is over and every packet produced has been ACKed
+static void win_check_done(SimContext *ctx, int f) {
+    Sender *s = &ctx->sender;
+    if (s->done[f] != 1 || s->snd_base[f] < s->next_pkt_id[f]) return;
+    snd_finish(ctx, f);
+}
+
+static void win_send_data(SimContext *ctx, int f) {
+    Sender *s = &ctx->sender;
+    int snd = FLOW_SENDER(f);
+    if (ctx->now > s->duration[f]) {
+        s->done[f] = 1;
+        win_check_done(ctx, f);
+        return;
+    }
+    s->next_pkt_id[f]++;   // one more packet from the application
+    win_fill(ctx, f);
+    SimTime next_time = ctx->now + s->send_interval[f];
+    if (next_time <= s->duration[f]) {
+        schedule_event(ctx, next_time, snd, snd, -1, H_SND_SEND_DATA);
+    } else {
+        s->done[f] = 1;
+        win_check_done(ctx, f);
+    }
+}
+
+// RFC 6298: smoothed RTT and variation, RTO = srtt + 4 rttvar (at least one timer tick more than srtt)
+static void win_rtt_sample(SimContext *ctx, int f, SimTime r) {
+    Sender *s = &ctx->sender;
+    hist_record(&ctx->lat.rtt, sim_seconds(ctx, r));
+    if (s->srtt[f] < 0.0) {
+        s->srtt[f]   = (double)r;
+        s->rttvar[f] = r / 2.0;
     } else {
-        schedule_event(g_now, SENDER_ID, RECEIVER_ID, -1, rcv_recv_finish);
+        s->rttvar[f] = 0.75 * s->rttvar[f] + 0.25 * fabs(s->srtt[f] - (double)r);
+        s->srtt[f]   = 0.875 * s->srtt[f] + 0.125 * (double)r;
     }
+    double rto = s->srtt[f] + fmax((double)ctx->timers.tick, 4.0 * s->rttvar[f]);
+    rto = fmin(fmax(rto, WIN_RTO_MIN * ctx->ticks_per_s), WIN_RTO_MAX * ctx->ticks_per_s);
+    s->cur_rto[f] = (SimTime)rto;
 }
 
+/* Packet pkt_id is reported by an ACK. The sample of the ACK comes from the copy sent last, the
+   one that most likely made the receiver answer: the packets a filled gap releases waited at the
+   receiver and would inflate the RTT. Karn: if that copy was a resend, the ACK gives no sample. */
+static void win_mark(SimContext *ctx, int f, unsigned long long pkt_id, SimTime *last, int *clean) {
+    Sender *s = &ctx->sender;
+    if (!seqwin_set(&s->acked[f], pkt_id)) return;
+    if (ctx->pkt) pktlog_acked(ctx->pkt, f, pkt_id, ctx->now);
+    const RtoSlot *slot = sender_slot(s, f, pkt_id);
+    if (slot->pkt_id == pkt_id && slot->last_sent > *last) {
+        *last  = slot->last_sent;
+        *clean = slot->last_sent == slot->first_sent;
+    }
+}
 
+static void win_resend(SimContext *ctx, int f, unsigned long long pkt_id) {
+    int wire = seq_wire(pkt_id);
+    TRACE(ctx, TRACE_DEBUG, TR_SND_TIMEOUT, f, wire, 0);
+    if (ctx->pkt) pktlog_retx(ctx->pkt, f, pkt_id);
+    network_schedule_delivery(ctx, FLOW_SENDER(f), FLOW_RECEIVER(f), wire, H_RCV_RECV_DATA);
+    sender_slot(&ctx->sender, f, pkt_id)->last_sent = ctx->now;
+}
+
+/* A packet the selective bits skip while WIN_DUP_THRESH later ones arrived is taken as lost and
+   sent again right away, once: after that only the timer resends it. */
+#define WIN_DUP_THRESH 3
+static void win_fast_retransmit(SimContext *ctx, int f, unsigned long long cum, unsigned sack) {
+    Sender *s = &ctx->sender;
+    int above = 0;   // packets reported after the one looked at
+    for (int i = SEQ_SACK_BITS - 1; i >= -1; i--) {
+        if (i >= 0 && (sack >> i) & 1) {
+            above++;
+            continue;
+        }
+        unsigned long long id = cum + 1 + i;   // i = -1: cum itself, never reported
+        if (above < WIN_DUP_THRESH || id >= s->snd_next[f] || seqwin_test(&s->acked[f], id)) continue;
+        const RtoSlot *slot = sender_slot(s, f, id);
+        if (slot->pkt_id == id && slot->last_sent == slot->first_sent) win_resend(ctx, f, id);
+    }
+}
+
+static void win_recv_ack(SimContext *ctx, Event *e) {
+    Sender *s = &ctx->sender;
+    int f = NODE_FLOW(e->dst);
+    if (e->packet_id < 0) {
+        TRACE(ctx, TRACE_DEBUG, TR_SND_ACK_INVALID, f, e->packet_id, 0);
+        return;
+    }
+    unsigned sack = (unsigned)e->packet_id & ((1u << SEQ_SACK_BITS) - 1);
+    unsigned long long cum = seq_unwrap(s->snd_base[f], (unsigned)e->packet_id >> SEQ_SACK_BITS, SEQ_ACK_BITS);
+    if (cum > s->snd_next[f]) cum = s->snd_next[f];   // cannot report packets not sent yet
+    TRACE(ctx, TRACE_DEBUG, TR_SND_CUM_ACK, f, seq_wire(cum), (int)sack);
+
+    SimTime last = -1;
+    int clean = 0;
+    for (unsigned long long id = s->snd_base[f]; id < cum; id++) win_mark(ctx, f, id, &last, &clean);
+    for (int i = 0; i < SEQ_SACK_BITS; i++)
+        if ((sack >> i) & 1 && cum + 1 + i < s->snd_next[f]) win_mark(ctx, f, cum + 1 + i, &last, &clean);
+    if (clean) win_rtt_sample(ctx, f, ctx->now - last);
+
+    unsigned long long base = s->snd_base[f];
+    while (s->snd_base[f] < s->snd_next[f] && seqwin_test(&s->acked[f], s->snd_base[f])) s->snd_base[f]++;
+    if (s->snd_base[f] > base) win_arm(ctx, f);   // new data ACKed: the timer starts over
+    win_fast_retransmit(ctx, f, cum, sack);
+    win_fill(ctx, f);
+    win_check_done(ctx, f);
+}
+
+/* The flow's timer: the oldest packet not ACKed goes again and the RTO doubles. The packets after
+   it are not resent: the receiver may well have them, the next cumulative ACK will tell. */
+void snd_rtx_timeout(SimContext *ctx, Event *e) {
+    Sender *s = &ctx->sender;
+    int f = NODE_FLOW(e->src);
+    s->rtx_timer[f] = 0;
+    if (s->snd_base[f] < s->snd_next[f]) win_resend(ctx, f, s->snd_base[f]);
+    // back off until a packet sent only once gives a new sample
+    SimTime max = sim_ticks(ctx, WIN_RTO_MAX);
+    s->cur_rto[f] = s->cur_rto[f] < max / 2 ? 2 * s->cur_rto[f] : max;
+    win_arm(ctx, f);
+}
+
+/* ---------------------------------------------------------------- per-packet protocol */
 
     //  1) Check if we've exceeded the duration If yes: schedule FINISH and stop sending new data.
     //  2) Allocate a new packet ID.
     //  3) Randomly decide if the packet is dropped.
     //  4) If not dropped: ask network to deliver DATA to receive +  increment s->sent
-    //  5) Schedule a timeout for this packet (snd_timeout).
+    //  5) Arm a timeout timer for this packet (snd_timeout), the ACK cancels it.
     //  6) Schedule the NEXT snd_send_data if still within duration else schedule FINISH.
-void snd_send_data() {
+void snd_send_data(SimContext *ctx, Event *e) {
+    int f   = NODE_FLOW(e->src);
+    if (ctx->sender.window > 0) {
+        win_send_data(ctx, f);
+        return;
+    }
+    int snd = FLOW_SENDER(f);
+    int rcv = FLOW_RECEIVER(f);
 
-    if (g_now > g_sender.duration) {
-        schedule_event(g_now, SENDER_ID, RECEIVER_ID, -1, rcv_recv_finish);
+    if (ctx->now > ctx->sender.duration[f]) {
+        snd_finish(ctx, f);
         return;
     }
-    int pkt_id = g_sender.next_pkt_id++;  // the packet ids are incremnental 
+    unsigned long long pkt_id = ctx->sender.next_pkt_id[f]++;  // the packet ids are incremnental 
+    int wire = seq_wire(pkt_id);                                // what the events carry
 
-    if (frand01() < 0.08) { 
-        g_sender.lost_local++;
-        printf("[%.3f] Sender: LOCAL DROP of pkt #%d\n", g_now, pkt_id);
+    int dropped = frand01(&ctx->net.port[snd].rng) < ctx->sender.loss;
+    if (ctx->pkt) pktlog_sent(ctx->pkt, f, pkt_id, ctx->now, dropped);
+    if (dropped) { 
+        ctx->sender.lost_local[f]++;
+        TRACE(ctx, TRACE_DEBUG, TR_SND_LOCAL_DROP, f, wire, 0);
     } else {
-        printf("[%.3f] Sender: SEND DATA #%d\n", g_now, pkt_id);
-        network_schedule_delivery( &g_net, g_now,SENDER_ID, RECEIVER_ID, pkt_id,rcv_recv_data );
-        g_sender.sent++;
+        TRACE(ctx, TRACE_DEBUG, TR_SND_DATA, f, wire, 0);
+        network_schedule_delivery(ctx, snd, rcv, wire, H_RCV_RECV_DATA);
+        ctx->sender.sent[f]++;
     }
-    schedule_event(g_now + RTO, SENDER_ID, SENDER_ID, pkt_id, snd_timeout);
-    double next_time = g_now + g_sender.send_interval;
+    // the timer handle is remembered in the packet's slot so the ACK can cancel it
+    RtoSlot *slot = sender_new_slot(&ctx->sender, f, pkt_id);
+    slot->timer      = timer_arm(ctx, ctx->now + ctx->sender.rto_ticks, snd, snd, wire, H_SND_TIMEOUT);
+    slot->pkt_id     = pkt_id;
+    slot->first_sent = ctx->now;
+    slot->last_sent  = ctx->now;
+    SimTime next_time = ctx->now + ctx->sender.send_interval[f];
 
-    if (next_time <= g_sender.duration) {
+    if (next_time <= ctx->sender.duration[f]) {
         // Schedule the sender to send another data packet later.
-        schedule_event(next_time, SENDER_ID, RECEIVER_ID, -1, snd_send_data);
+        schedule_event(ctx, next_time, snd, snd, -1, H_SND_SEND_DATA);
     } else {
-        schedule_event(g_now, SENDER_ID, RECEIVER_ID, -1, rcv_recv_finish);
+        snd_finish(ctx, f);
     }
 }
 
 
 
-    //  1) Read the packet_id from the event.
-    //  2) If valid, mark it as acknowledged.
+    //  1) Read the packet_id from the event (the low bits of the id, see seqwin.h).
+    //  2) If valid, mark it as acknowledged and cancel its timeout.
     //  3) Print a log message.
 
-void snd_recv_data_ack(Event *e) {
-    int pkt_id = e->packet_id;
-    if (pkt_id >= 0 && pkt_id < MAX_PKTS) {
-        g_sender.acked[pkt_id] = 1; 
-        printf("[%.3f] Sender: RECV ACK for pkt #%d\n", g_now, pkt_id);
+void snd_recv_data_ack(SimContext *ctx, Event *e) {
+    if (ctx->sender.window > 0) {
+        win_recv_ack(ctx, e);
+        return;
+    }
+    int f = NODE_FLOW(e->dst);
+    int wire = e->packet_id;
+    if (wire >= 0) {
+        unsigned long long pkt_id = seqwin_unwrap(&ctx->sender.acked[f], wire);
+        int first_ack = seqwin_set(&ctx->sender.acked[f], pkt_id);
+        if (first_ack && ctx->pkt) pktlog_acked(ctx->pkt, f, pkt_id, ctx->now);
+        RtoSlot *slot = sender_slot(&ctx->sender, f, pkt_id);
+        // Karn: once a packet was retransmitted nobody knows which copy the ACK answers, no sample
+        if (first_ack && slot->pkt_id == pkt_id && slot->last_sent == slot->first_sent)
+            hist_record(&ctx->lat.rtt, sim_seconds(ctx, ctx->now - slot->last_sent));
+        if (slot->timer && slot->pkt_id == pkt_id) {   // a duplicate ACK may find the slot taken by a newer packet
+            timer_cancel(ctx, slot->timer);
+            slot->timer = 0;
+        }
+        TRACE(ctx, TRACE_DEBUG, TR_SND_ACK, f, wire, 0);
     } else {
-        printf("[%.3f] Sender: RECV ACK with invalid pkt id %d\n", g_now, pkt_id);
+        TRACE(ctx, TRACE_DEBUG, TR_SND_ACK_INVALID, f, wire, 0);
     }
 }
 
@@ -111,23 +441,30 @@ void snd_recv_data_ack(Event *e) {
 //   If pkt_id == -1: Handle SYN timeout ( retransmit SYN).
 //   Else:If packet not yet ACKed, retransmit it and reschedule timeout.
 
-void snd_timeout(Event *e) {
-    int pkt_id = e->packet_id;
+void snd_timeout(SimContext *ctx, Event *e) {
+    int f   = NODE_FLOW(e->src);
+    int snd = FLOW_SENDER(f);
+    int rcv = FLOW_RECEIVER(f);
+    int wire = e->packet_id;
 
     //  SYN timeout (packet_id == -1)
-    if (pkt_id == -1) {
+    if (wire == -1) {
         // Only retransmit if handshake hasn't completed yet.
-        if (!g_sender.syn_acked) {
-            printf("[%.3f] Sender: SYN TIMEOUT -> retransmit SYN\n", g_now);
-            schedule_event(g_now,SENDER_ID, RECEIVER_ID, -1, snd_send_syn);
-            schedule_event(g_now + RTO, SENDER_ID, SENDER_ID,   -1, snd_timeout);
+        if (!ctx->sender.syn_acked[f]) {
+            TRACE(ctx, TRACE_INFO, TR_SND_SYN_TIMEOUT, f, 0, 0);
+            schedule_event(ctx, ctx->now, snd, snd, -1, H_SND_SEND_SYN);
+            ctx->sender.syn_timer[f] = timer_arm(ctx, ctx->now + ctx->sender.rto_ticks, snd, snd, -1, H_SND_TIMEOUT);
         }
     } else {
         //  DATA packet timeout
-        if (pkt_id >= 0 && pkt_id < MAX_PKTS && !g_sender.acked[pkt_id]) {
-            printf("[%.3f] Sender: TIMEOUT pkt #%d -> retransmit\n", g_now, pkt_id);
-            network_schedule_delivery(&g_net,g_now,SENDER_ID,RECEIVER_ID,pkt_id,rcv_recv_data);
-            schedule_event(g_now + RTO, SENDER_ID, SENDER_ID, pkt_id, snd_timeout);
+        unsigned long long pkt_id = seqwin_unwrap(&ctx->sender.acked[f], wire);
+        if (!seqwin_test(&ctx->sender.acked[f], pkt_id)) {
+            TRACE(ctx, TRACE_DEBUG, TR_SND_TIMEOUT, f, wire, 0);
+            if (ctx->pkt) pktlog_retx(ctx->pkt, f, pkt_id);
+            network_schedule_delivery(ctx, snd, rcv, wire, H_RCV_RECV_DATA);
+            RtoSlot *slot = sender_slot(&ctx->sender, f, pkt_id);   // still its own, the packet is not ACKed
+            slot->timer     = timer_arm(ctx, ctx->now + ctx->sender.rto_ticks, snd, snd, wire, H_SND_TIMEOUT);
+            slot->last_sent = ctx->now;
         }
     }
 }
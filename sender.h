@@ -1,26 +1,77 @@
 #ifndef SENDER_H
 #define SENDER_H
 #include "event.h"
-#define MAX_PKTS 10000
+#include "timer_wheel.h"
+#include "seqwin.h"
 #define SENDER_ID   0
 #define RECEIVER_ID 1
+#define RTO_SLOTS   64   // fewest RtoSlots per flow (packet p uses slot p % Sender.n_slots[f])
+#define SND_WINDOW_MAX (SEQWIN_BITS / 2)   // packets in flight per flow in window mode
 
+// flow f is sender node 2f talking to receiver node 2f+1, so flow 0 is SENDER_ID -> RECEIVER_ID.
+// Events carry the node ids in src/dst, the handlers get the flow back with NODE_FLOW.
+#define FLOW_SENDER(f)   (2 * (f))
+#define FLOW_RECEIVER(f) (2 * (f) + 1)
+#define NODE_FLOW(n)     ((n) >> 1)
+
+typedef struct {
+    TimerHandle        timer;   // pending retransmission timeout
+    unsigned long long pkt_id;  // packet of the slot (p, p + n_slots, ... share it, but only one of them is unACKed)
+    SimTime            first_sent;   // first snd_send_data of the packet (time to delivery)
+    SimTime            last_sent;    // latest transmission, retransmissions included (RTT)
+} RtoSlot;
+
+/* Every field is an array indexed by the flow number (struct of arrays),
+   so a handler touching one field of many flows reads contiguous memory.
+
+   With window = 0 every packet has its own timeout and its own ACK (the original protocol).
+   With window = W (--window) a flow keeps up to W packets in flight, the receiver answers with
+   cumulative ACKs that also report the next few packets (seqwin.h), the flow has a single
+   retransmission timer whose timeout follows the measured RTT. Only lost packets are sent again
+   (selective repeat): the ones the ACKs show a gap at, and the oldest one when the timer fires. */
 typedef struct Sender {
-    int    id;
-    int    sent;
-    int    lost_local;
-    int    next_pkt_id;
-    double send_interval;
-    double duration;
-    int    syn_acked;
-    char   acked[MAX_PKTS];
+    int            n_flows;
+    SimTime        rto_ticks;   // retransmission timeout of every flow (the first one in window mode)
+    double         loss;        // probability of a local drop of a DATA packet
+    int            window;      // packets in flight per flow, 0 = one timer and one ACK per packet
+    int           *n_slots;     // RtoSlots of each flow, a power of two >= RTO_SLOTS and >= window, grows
+    int           *sent;
+    int           *lost_local;
+    unsigned long long *next_pkt_id;   // 64-bit, a flow can send billions of packets
+    SimTime       *send_interval;   // ticks
+    SimTime       *duration;
+    char          *syn_acked;
+    SeqWindow     *acked;       // packets ACKed so far, one sliding window per flow (seqwin.h)
+    TimerHandle   *syn_timer;   // pending SYN timeout of each flow
+    RtoSlot      **rto;         // per flow, the n_slots[f] packets from acked[f].base on (not ACKed yet or just ACKed)
+    // window mode only
+    unsigned long long *snd_base;   // oldest packet not ACKed yet
+    unsigned long long *snd_next;   // next packet sent for the first time, the ones up to next_pkt_id wait for room
+    double        *srtt;        // smoothed RTT (ticks), < 0 = no sample yet
+    double        *rttvar;
+    SimTime       *cur_rto;     // timeout of the flow's timer: srtt + 4 rttvar, doubled by every timeout
+    TimerHandle   *rtx_timer;   // the flow's retransmission timer, armed while packets are in flight
+    char          *done;        // window mode: 1 = duration over; 2 = FINISH sent (both modes)
+    SimTime        fin_delay;   // ticks the FINISH takes to reach the receiver, 0 = none (> 0 with --pdes-split)
 } Sender;
 
-void sender_init(Sender *s, int id, double send_interval_s, double duration_s);
-void snd_send_syn();
-void snd_recv_synack();
-void snd_send_data();
-void snd_recv_data_ack(struct Event *e);
-void snd_timeout(struct Event *e);
+int  sender_init(struct SimContext *ctx, int n_flows, const double *send_interval_s, const double *duration_s,
+                 double rto_s, double loss, int window);
+void sender_start(struct SimContext *ctx, int f);
+void sender_free(Sender *s);
+// cancels the timers flow f still has armed, called when the sender of f is over (see node_over in sim.c)
+void sender_flow_over(struct SimContext *ctx, int f);
+// time packet pkt_id of flow f was first sent, known until it is ACKed; -1 once its slot holds a newer packet
+SimTime sender_first_sent(const Sender *s, int f, unsigned long long pkt_id);
+void snd_send_syn(struct SimContext *ctx, struct Event *e);
+void snd_recv_synack(struct SimContext *ctx, struct Event *e);
+void snd_send_data(struct SimContext *ctx, struct Event *e);
+void snd_recv_data_ack(struct SimContext *ctx, struct Event *e);
+void snd_timeout(struct SimContext *ctx, struct Event *e);
+void snd_rtx_timeout(struct SimContext *ctx, struct Event *e);
+
+static inline RtoSlot *sender_slot(const Sender *s, int f, unsigned long long pkt_id) {
+    return &s->rto[f][pkt_id & (unsigned long long)(s->n_slots[f] - 1)];
+}
 
 #endif
@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "seqwin.h"
+
+// the wire ids are told apart within 2^30 (seq_unwrap), a window never needs to hold more
+#define SEQWIN_WORDS_MAX (1 << 24)
+
+int seqwin_init(SeqWindow *w) {
+    w->base  = 0;
+    w->head  = 0;
+    w->words = SEQWIN_WORDS;
+    w->bits  = calloc(SEQWIN_WORDS, sizeof(unsigned long long));
+    return w->bits != NULL;
+}
+
+void seqwin_free(SeqWindow *w) {
+    free(w->bits);
+    w->bits = NULL;
+}
+
+// the ring is unrolled from head into a larger one, so head is 0 again
+void seqwin_grow(SeqWindow *w, unsigned long long id) {
+    unsigned long long need = (id - w->base) / 64 + 1;
+    int words = w->words;
+    while ((unsigned long long)words < need && words < SEQWIN_WORDS_MAX) words *= 2;
+    unsigned long long *bits = (unsigned long long)words >= need ? calloc(words, sizeof(unsigned long long)) : NULL;
+    if (!bits) {
+        fprintf(stderr, "seqwin: cannot hold %llu ids in flight\n", id - w->base + 1);
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < w->words; k++) bits[k] = w->bits[(w->head + k) & (w->words - 1)];
+    free(w->bits);
+    w->bits  = bits;
+    w->head  = 0;
+    w->words = words;
+}
@@ -0,0 +1,97 @@
+#ifndef SEQWIN_H
+#define SEQWIN_H
+
+/*
+Sliding window of packet ids, replaces the fixed acked/seen bitmaps.
+
+Packet ids are 64-bit and never wrap. Every id below `base` is marked (cumulative
+low-water mark), the ids from base on have one bit each in a ring of `words` words, and
+everything above is not marked yet. When the word at base is full the window slides by 64 ids
+and the word is reused, so a flow that keeps its ids in flight within SEQWIN_BITS uses the same
+SEQWIN_WORDS words whether it sends a thousand packets or billions.
+
+An id that lands past the ring makes it grow (seqwin_grow doubles it until the id fits): base
+only moves over words whose ids are all marked, never over an id still in flight, so a packet
+that is lost over and over keeps the ids after it in the window however far the flow gets.
+
+On the wire (Event.packet_id) only the low 31 bits of an id are carried, negative values
+keep meaning "no data" (-1) or "corrupted" (-2). The receiving side gets the full id back
+with seqwin_unwrap, which picks the id closest to its own window: that works as long as
+the ids in flight span less than 2^30, like TCP sequence numbers.
+
+A cumulative ACK (window mode, sender.c) carries two things in the same 31 bits: the next id
+the receiver expects (low 23 bits, so the ids in flight must span less than 2^22) and a bitmap
+of which of the SEQ_SACK_BITS ids after it have arrived already (selective ACK).
+*/
+
+#define SEQWIN_WORDS 32                    // 2048 ids in the window at first
+#define SEQWIN_BITS  (SEQWIN_WORDS * 64)
+#define SEQ_WIRE_BITS 31
+#define SEQ_WIRE_MASK ((1ULL << SEQ_WIRE_BITS) - 1)
+#define SEQ_SACK_BITS 8
+#define SEQ_ACK_BITS  (SEQ_WIRE_BITS - SEQ_SACK_BITS)
+
+typedef struct {
+    unsigned long long  base;    // first id of the word at head, every id below is marked
+    unsigned long long *bits;    // bit b of word (head + k) % words = id base + 64k + b
+    int                 head;
+    int                 words;   // a power of two, SEQWIN_WORDS at first
+} SeqWindow;
+
+int  seqwin_init(SeqWindow *w);   // returns 0 if the ring cannot be allocated
+void seqwin_free(SeqWindow *w);
+void seqwin_grow(SeqWindow *w, unsigned long long id);   // until id fits, exits if it cannot
+
+// what goes into Event.packet_id
+static inline int seq_wire(unsigned long long id) {
+    return (int)(id & SEQ_WIRE_MASK);
+}
+
+// full id of the low `bits` bits of an id, the one nearest to `near`
+static inline unsigned long long seq_unwrap(unsigned long long near, unsigned long long low, int bits) {
+    unsigned long long mask = (1ULL << bits) - 1;
+    long long diff = (long long)((low - near) & mask);
+    if (diff >= (1LL << (bits - 1))) diff -= 1LL << bits;                   // behind near
+    if (diff < 0 && (unsigned long long)(-diff) > near) diff += 1LL << bits;   // no id below 0
+    return near + diff;
+}
+
+// full id of a wire id (>= 0), the one nearest to the window
+static inline unsigned long long seqwin_unwrap(const SeqWindow *w, int wire) {
+    return seq_unwrap(w->base, (unsigned long long)wire, SEQ_WIRE_BITS);
+}
+
+// a cumulative ACK: every id below cum arrived, bit i of sack = id cum + 1 + i arrived too
+static inline int seq_ack_wire(unsigned long long cum, unsigned sack) {
+    return (int)(((cum & ((1ULL << SEQ_ACK_BITS) - 1)) << SEQ_SACK_BITS) | (sack & ((1u << SEQ_SACK_BITS) - 1)));
+}
+
+static inline int seqwin_test(const SeqWindow *w, unsigned long long id) {
+    if (id < w->base) return 1;
+    unsigned long long off = id - w->base;
+    if (off >= (unsigned long long)w->words * 64) return 0;
+    int word = (w->head + (int)(off >> 6)) & (w->words - 1);
+    return (int)((w->bits[word] >> (off & 63)) & 1);
+}
+
+// drops the word at base, which is full (its ids count as marked from now on)
+static inline void seqwin_slide(SeqWindow *w) {
+    w->bits[w->head] = 0;
+    w->head = (w->head + 1) & (w->words - 1);
+    w->base += 64;
+}
+
+// marks id, returns 1 if it was not marked before
+static inline int seqwin_set(SeqWindow *w, unsigned long long id) {
+    if (id < w->base) return 0;
+    if (id - w->base >= (unsigned long long)w->words * 64) seqwin_grow(w, id);
+    unsigned long long off = id - w->base;
+    int word = (w->head + (int)(off >> 6)) & (w->words - 1);
+    unsigned long long bit = 1ULL << (off & 63);
+    if (w->bits[word] & bit) return 0;
+    w->bits[word] |= bit;
+    while (w->bits[w->head] == ~0ULL) seqwin_slide(w);   // compact: full words go below base
+    return 1;
+}
+
+#endif
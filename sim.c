@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sim.h"
+
+void sim_config_default(SimConfig *cfg) {
+    cfg->send_interval = 0.05;   // the interval between each packets
+    cfg->duration      = 1.0;    // The full duration of sending packets
+    cfg->base_delay    = 0.05;   // the based delay that is the average delay of a network (in this case I increased the delay to see the effect of timeout )
+    cfg->jitter        = 0.2;    // maximum variation around the base delay.
+    cfg->rto           = 0.05;   // retransmission timeout
+    cfg->local_loss    = 0.08;   // probability that the sender drops a DATA packet before the network
+    cfg->window        = 0;      // the per-packet protocol
+    cfg->ack_every     = 2;
+    cfg->ack_delay     = 0.005;
+    cfg->n_flows       = 1;
+    cfg->n_intervals   = 0;
+    cfg->n_durations   = 0;
+    cfg->pool_cap      = 0;
+    cfg->queue_kind    = QUEUE_BINARY_HEAP;
+    cfg->queue_arity   = 4;
+    cfg->use_wheel     = 1;
+    cfg->timer_tick    = 0.001;
+    cfg->time_resolution = 1e-9;
+    cfg->trace_level   = TRACE_DEBUG;
+    cfg->trace_path    = NULL;
+    cfg->net_trace     = NULL;
+    cfg->link_bw       = 0.0;
+    cfg->link_buffer   = 64 * 1500.0;   // 64 full-size packets
+    cfg->link_shared   = 0;
+    cfg->pkt_size      = 1500;
+    cfg->ctl_size      = 40;
+    cfg->topo          = NULL;
+    cfg->split_flows   = 0;
+}
+
+/* Builds a fresh simulation from cfg, without any event yet (sim_start adds them).
+   seed/stream select the random sequence: same seed and stream -> same run.
+   Returns 0 if the per-flow state could not be allocated. */
+int sim_alloc(SimContext *ctx, const SimConfig *cfg, unsigned long long seed, unsigned long long stream) {
+    memset(ctx, 0, sizeof(*ctx));   // every pointer starts NULL so sim_destroy is safe after a failed init
+    ctx->now       = 0;
+    ctx->ticks_per_s = round(1.0 / cfg->time_resolution);   // 1e9 exactly for 1e-9 (1 / 1e-9 alone is not)
+    ctx->stop      = 0;
+    ctx->event_seq = 0;
+    ctx->events    = 0;
+    ctx->seed      = seed;
+    ctx->stream    = stream;
+    ctx->flow_lo   = 0;
+    ctx->flow_hi   = cfg->n_flows;
+
+    if (2LL * cfg->n_flows > EVENT_MAX_NODES) {
+        fprintf(stderr, "%d flows need more than the %d node ids an event can carry\n", cfg->n_flows, EVENT_MAX_NODES);
+        return 0;
+    }
+    event_queue_init(&ctx->queue, cfg->queue_kind, cfg->queue_arity, cfg->pool_cap);
+    timers_init(&ctx->timers, cfg->use_wheel, sim_ticks(ctx, cfg->timer_tick));
+    latency_init(&ctx->lat);
+#ifdef SIM_PROFILE
+    profile_init(&ctx->prof);
+#endif
+    if (!trace_open(&ctx->trace, cfg->trace_level, cfg->trace_path)) {
+        fprintf(stderr, "cannot open the trace file %s\n", cfg->trace_path);
+        return 0;
+    }
+
+    // per-flow parameters: the lists are repeated over the flows, without a list every flow uses the default values
+    int n_flows = cfg->n_flows;
+    double *flow_interval = malloc(n_flows * sizeof(double));
+    double *flow_duration = malloc(n_flows * sizeof(double));
+    int ok = flow_interval && flow_duration;
+    if (ok) {
+        for (int f = 0; f < n_flows; f++) {
+            flow_interval[f] = cfg->n_intervals > 0 ? cfg->intervals[f % cfg->n_intervals] : cfg->send_interval;
+            flow_duration[f] = cfg->n_durations > 0 ? cfg->durations[f % cfg->n_durations] : cfg->duration;
+        }
+        ok = network_init(&ctx->net, cfg->base_delay, cfg->jitter, cfg->net_trace, 2 * n_flows, seed, stream) &&
+             receiver_init(&ctx->receiver, n_flows, cfg->window > 0 ? (cfg->ack_every > 0 ? cfg->ack_every : 1) : 0,
+                           sim_ticks(ctx, cfg->ack_delay)) &&
+             sender_init(ctx, n_flows, flow_interval, flow_duration, cfg->rto, cfg->local_loss, cfg->window);
+    }
+    free(flow_interval);
+    free(flow_duration);
+    if (ok && cfg->link_bw > 0.0)
+        network_set_link(&ctx->net, cfg->link_bw, cfg->pkt_size, cfg->ctl_size, cfg->link_buffer, ctx->ticks_per_s,
+                         cfg->link_shared);
+    if (ok && cfg->topo)
+        ok = network_set_topology(&ctx->net, cfg->topo, cfg->pkt_size, cfg->ctl_size);
+    if (ok && cfg->split_flows && cfg->base_delay - cfg->jitter > 0.0)
+        ctx->sender.fin_delay = sim_ticks(ctx, cfg->base_delay - cfg->jitter);
+    return ok;
+}
+
+// schedules the first events of the flows [flow_lo, flow_hi), which ctx will run
+void sim_start(SimContext *ctx, int flow_lo, int flow_hi) {
+    ctx->flow_lo = flow_lo;
+    ctx->flow_hi = flow_hi;
+    for (int f = flow_lo; f < flow_hi; f++)
+        sender_start(ctx, f);
+}
+
+int sim_init(SimContext *ctx, const SimConfig *cfg, unsigned long long seed, unsigned long long stream) {
+    if (!sim_alloc(ctx, cfg, seed, stream)) return 0;
+    sim_start(ctx, 0, cfg->n_flows);
+    return 1;
+}
+
+/* A partition has its own clock, queue, timers and counters, but the flow and network
+   arrays are the ones of parent: the partitions run disjoint blocks of flows, so two
+   threads never write the same entry. */
+void sim_init_partition(SimContext *part, const SimContext *parent, const SimConfig *cfg, int flow_lo, int flow_hi) {
+    memset(part, 0, sizeof(*part));
+    part->seed     = parent->seed;
+    part->ticks_per_s = parent->ticks_per_s;
+    part->stream   = parent->stream;
+    part->net      = parent->net;        // copies of the structs, the arrays inside are shared
+    part->sender   = parent->sender;
+    part->receiver = parent->receiver;
+    part->receiver.n_finished = 0;       // counts the flows of this partition only
+    part->shared   = 1;
+    part->pkt      = parent->pkt;        // rows of different flows, like the arrays above
+    trace_open(&part->trace, TRACE_OFF, NULL);   // the partitions run at the same time, no trace
+    event_queue_init(&part->queue, cfg->queue_kind, cfg->queue_arity, cfg->pool_cap);
+    timers_init(&part->timers, cfg->use_wheel, sim_ticks(part, cfg->timer_tick));
+    latency_init(&part->lat);            // merged into the parent's at the end (pdes_run)
+#ifdef SIM_PROFILE
+    profile_init(&part->prof);
+#endif
+    sim_start(part, flow_lo, flow_hi);
+}
+
+/* Events for a node whose flow is over are dropped. The FINISH normally ends both nodes of the
+   flow at once. With --pdes-split it takes Sender.fin_delay like a packet and each node ends on
+   its own, the sender when it sends it: a partition then only reads the state of its own nodes. */
+static int node_over(const SimContext *ctx, int node) {
+    int f = NODE_FLOW(node);
+    if (ctx->sender.fin_delay > 0 && node == FLOW_SENDER(f)) return ctx->sender.done[f] == 2;
+    return ctx->receiver.finished[f];
+}
+
+void sim_run(SimContext *ctx) {
+    sim_run_until(ctx, SIM_TIME_MAX);
+}
+
+void sim_run_until(SimContext *ctx, SimTime end) {
+    // this is the main part of the code where as long as we have a scheduled event in the queue we keep popping the top event
+    // everytime we pop the event we rehypify the tree and reorder the elements using a simple swap method
+    // this loop not only does it stop when the queue is empty but also we need the full duration to be over
+
+    // timers live in the timing wheel until they are due, so before running an event we move the timers
+    // that fire before it into the queue (and if the queue is empty, the next timers that are pending)
+
+    // the parallel engine runs one window of time at a time: an event at or after `end` goes back in the queue
+
+    // and so do the timers due at or after `end`: moved to the queue now, they could not be cancelled anymore by
+    // what happens before them (events another partition sends, events injected between two calls)
+    SimTime last = end == SIM_TIME_MAX ? SIM_TIME_MAX : end - 1;
+
+    while (!ctx->stop) {
+        if (event_queue_empty(&ctx->queue) && !timers_expire_until(ctx, last)) break; // no event and no timer left before end
+        Event *recent_event = pop_next_event(&ctx->queue); // we remove the event from the heap tree and returns the pointer to the most recent event (the root of the tree)
+        if (timers_expire_until(ctx, recent_event->time < last ? recent_event->time : last)) {
+            // some timers fire at the same tick: put the event back so the queue decides who runs first
+            event_queue_put_back(&ctx->queue, recent_event);
+            recent_event = pop_next_event(&ctx->queue);
+        }
+        if (recent_event->time >= end) {
+            event_queue_put_back(&ctx->queue, recent_event);
+            break;
+        }
+        if (node_over(ctx, recent_event->dst)) {
+            // the flow is over: whatever it still had pending (timeouts, late packets) is dropped
+            if (recent_event->handler == H_NET_HOP) network_transit_release(&ctx->net, recent_event->src);
+            event_release(ctx, recent_event);
+            continue;
+        }
+        ctx->now = recent_event->time;     // we update the current time by assigning it the value of the time of the event we popped to discretize time
+        PROF_HANDLER_START(t0);
+        event_dispatch(ctx, recent_event);  //  handler is a HandlerId, event_handlers[] gives the function that should handle the event
+        PROF_HANDLER_END(ctx, recent_event->handler, t0);   // before the release: a released event belongs to the pool
+        event_release(ctx, recent_event);  //The event was taken from the event pool when scheduled -> once it is handled we give it back so it can be reused
+        ctx->events++;
+    }
+}
+
+// nothing is handled or moved: the event stays in the queue, the timers in the wheel
+SimTime sim_next_time(SimContext *ctx) {
+    SimTime t = timers_next_time(&ctx->timers);   // the timers stay in the wheel
+    if (!event_queue_empty(&ctx->queue)) {
+        Event *e = pop_next_event(&ctx->queue);
+        if (e->time < t) t = e->time;
+        event_queue_put_back(&ctx->queue, e);
+    }
+    return t;
+}
+
+// adds the counters of all the flows together
+void sim_collect(const SimContext *ctx, SimResults *r) {
+    const Sender   *s  = &ctx->sender;
+    const Receiver *rv = &ctx->receiver;
+    r->sent = r->lost_local = r->unique = r->deliveries = r->invalid = 0;
+    for (int f = 0; f < s->n_flows; f++) {
+        r->sent       += s->sent[f];
+        r->lost_local += s->lost_local[f];
+        r->unique     += rv->unique_ok[f];
+        r->deliveries += rv->received_ok[f];
+        r->invalid    += rv->invalid_packets[f];
+    }
+    r->logical         = r->sent + r->lost_local;
+    r->retransmissions = r->deliveries - r->unique;
+    double sum_delay;
+    long   count_delay;
+    network_totals(&ctx->net, &sum_delay, &count_delay);
+    r->avg_delay       = count_delay > 0 ? sum_delay / count_delay : 0.0;
+    r->p99_delay       = hist_percentile(&ctx->lat.one_way, 99.0);
+    r->p99_rtt         = hist_percentile(&ctx->lat.rtt, 99.0);
+    r->p99_delivery    = hist_percentile(&ctx->lat.delivery, 99.0);
+    r->delivery_ratio  = r->logical > 0 ? (double)r->unique / r->logical : 0.0;
+    r->events          = ctx->events;
+    r->end_time        = sim_seconds(ctx, ctx->now);
+}
+
+// queue counters of a set of links with a bandwidth (network.h)
+// the per-flow table shows the first SUMMARY_FIRST flows and the SUMMARY_WORST others with the lowest delivery ratio
+#define SUMMARY_FIRST 16
+#define SUMMARY_WORST 8
+
+static double flow_ratio(const SimContext *ctx, int f) {
+    int logical = ctx->sender.sent[f] + ctx->sender.lost_local[f];
+    return logical > 0 ? (double)ctx->receiver.unique_ok[f] / logical : 0.0;
+}
+
+static void print_flow_row(const SimContext *ctx, int f) {
+    const Sender   *s  = &ctx->sender;
+    const Receiver *rv = &ctx->receiver;
+    printf("%6d %10.4f %8d %8d %8d %10d %8d %8d\n", f, sim_seconds(ctx, s->send_interval[f]),
+           s->sent[f] + s->lost_local[f], s->sent[f], s->lost_local[f], rv->unique_ok[f],
+           rv->received_ok[f] - rv->unique_ok[f], rv->invalid_packets[f]);
+}
+
+static void print_link_stats(const SimContext *ctx, const NetLinkStats *ls) {
+    double elapsed = sim_seconds(ctx, ctx->now);
+    printf("  - packets sent         : %ld (%.0f bytes), %ld tail drops (%.2f%%)\n", ls->pkts, ls->bytes, ls->drops,
+           ls->pkts + ls->drops > 0 ? 100.0 * ls->drops / (ls->pkts + ls->drops) : 0.0);
+    printf("  - queueing delay       : mean %.6f s, max %.6f s\n",
+           ls->pkts > 0 ? sim_seconds(ctx, ls->wait) / ls->pkts : 0.0, sim_seconds(ctx, ls->wait_max));
+    printf("  - queue at arrival     : mean %.0f bytes, max %.0f bytes\n",
+           ls->pkts > 0 ? ls->backlog_sum / ls->pkts : 0.0, ls->backlog_max);
+    printf("  - busiest link         : %.1f%% utilized\n", elapsed > 0.0 ? 100.0 * sim_seconds(ctx, ls->busy_max) / elapsed : 0.0);
+}
+
+void sim_print_summary(const SimContext *ctx) {
+    const Sender   *s  = &ctx->sender;
+    const Receiver *rv = &ctx->receiver;
+    SimResults r;
+    sim_collect(ctx, &r);
+
+    // once we exit the while loop it means that the simulation is over
+    printf("\nSimulation finished\n");
+    printf("Seed                     : %llu (stream %llu)\n", ctx->seed, ctx->stream);
+    // every counter is per flow: the first table adds all the flows together
+    //sent is incremented whenever the sender actually pushes a packet into the network.
+    //lost_local is incremented when the sender randomly drops packet before sending.
+    //logical = sent + lost_local is the total number of data packets the senders intended to send
+    //unique counts how many different packets were successfully received without duplicates
+    //deliveries is the total number of packets accepted at receiver including duplicates.
+    printf("Flows                    : %d (%d finished)\n", s->n_flows, rv->n_finished);
+    printf("Sender logical packets   : %ld\n", r.logical);
+    printf("  - scheduled to network : %ld\n", r.sent);
+    printf("  - local drops          : %ld\n", r.lost_local);
+
+    printf("Receiver unique packets  : %ld\n", r.unique);
+    printf("Receiver total deliveries: %ld\n", r.deliveries);
+    printf("Retransmissions received (due to timeouts) : %ld\n", r.retransmissions);
+    printf("Receiver invalid packets : %ld\n", r.invalid);
+    if (s->window > 0)
+        printf("Protocol                 : window of %d packets, cumulative ACK every %d packets or after %.4f s\n",
+               s->window, rv->ack_every, sim_seconds(ctx, rv->ack_delay));
+    else
+        printf("Protocol                 : one timer and one ACK per packet\n");
+    // goodput counts each packet once, over the whole run (handshake and the last ACKs included)
+    printf("Goodput                  : %.1f packets/s (%.3f Mbit/s of %d-byte packets)\n",
+           r.end_time > 0.0 ? r.unique / r.end_time : 0.0,
+           r.end_time > 0.0 ? r.unique * 8.0 * ctx->net.data_bytes / r.end_time / 1e6 : 0.0, ctx->net.data_bytes);
+    printf("Events per unique packet : %.2f\n", r.unique > 0 ? (double)r.events / r.unique : 0.0);
+
+    // the count delay is incremented everytime a packet is passed to the network
+    double sum_delay;
+    long   count_delay;
+    network_totals(&ctx->net, &sum_delay, &count_delay);
+    printf("Average one-way network delay: %.6f s (from %ld deliveries)\n", r.avg_delay, count_delay);
+    if (ctx->net.trace)
+        printf("Network drops (trace)    : %ld packets never delivered\n", network_drops(&ctx->net));
+    if (ctx->net.link_bw > 0.0) {
+        // one link per node (or one for all the senders): the one-way delay above includes the time spent in it
+        NetLinkStats ls;
+        network_link_totals(&ctx->net, ctx->now, &ls);
+        const char *shared = ctx->net.link_shared ? ", one shared by all the senders" : "";
+        if (ctx->net.link_buffer > 0.0)
+            printf("Bottleneck links (%.3g Mbit/s, %.0f bytes of buffer per link%s)\n",
+                   ctx->net.link_bw / 1e6, ctx->net.link_buffer, shared);
+        else
+            printf("Bottleneck links (%.3g Mbit/s, unlimited buffer%s)\n", ctx->net.link_bw / 1e6, shared);
+        print_link_stats(ctx, &ls);
+    }
+    if (ctx->net.topo) {
+        const Topology *t = ctx->net.topo;
+        printf("Topology: %d nodes, %d links, routes of %.2f hops on average (max %d)\n",
+               t->n_nodes, t->n_links, t->mean_hops, t->max_hops);
+        printf("  - lost on the links    : %ld packets\n", network_drops(&ctx->net));
+        printf("  - hop by hop           : %d of %d flows (%ld hop events), the others in one event per packet\n",
+               t->n_queued, t->n_flows, ctx->net.hop_events);
+        if (ctx->net.topo_q) {
+            NetLinkStats ls;
+            network_topo_link_totals(&ctx->net, ctx->now, &ls);
+            print_link_stats(ctx, &ls);
+        }
+    }
+    // tails of the delays: every percentile is within 0.8% of the exact one (hist.h)
+    latency_print(stdout, &ctx->lat);
+
+    if (s->n_flows > 1) {
+        // delivery ratio = unique packets received / logical packets of the flow
+        double min_ratio = 1.0, max_ratio = 0.0, sum_ratio = 0.0;
+        int worst[SUMMARY_WORST];   // flows after the first ones, lowest ratio first
+        int n_worst = 0;
+        printf("\nPer-flow summary\n");
+        printf("%6s %10s %8s %8s %8s %10s %8s %8s\n",
+               "flow", "interval", "logical", "sent", "drops", "unique", "retrans", "invalid");
+        for (int f = 0; f < s->n_flows; f++) {
+            double ratio = flow_ratio(ctx, f);
+            if (ratio < min_ratio) min_ratio = ratio;
+            if (ratio > max_ratio) max_ratio = ratio;
+            sum_ratio += ratio;
+            if (f < SUMMARY_FIRST) {
+                print_flow_row(ctx, f);
+                continue;
+            }
+            // insertion into the short sorted list, a flow that ties keeps the earlier one first
+            int k = n_worst < SUMMARY_WORST ? n_worst++ : SUMMARY_WORST;
+            for (; k > 0 && flow_ratio(ctx, worst[k - 1]) > ratio; k--)
+                if (k < SUMMARY_WORST) worst[k] = worst[k - 1];
+            if (k < SUMMARY_WORST) worst[k] = f;
+        }
+        if (n_worst > 0) {
+            printf("  ... %d more flows, the %d with the lowest delivery ratio:\n", s->n_flows - SUMMARY_FIRST, n_worst);
+            for (int k = 0; k < n_worst; k++)
+                print_flow_row(ctx, worst[k]);
+        }
+        printf("Delivery ratio per flow: min %.4f, mean %.4f, max %.4f\n",
+               min_ratio, sum_ratio / s->n_flows, max_ratio);
+    }
+
+    if (ctx->trace.binary)
+        printf("Trace: %ld records written by the writer thread (the simulation waited %ld times for room)\n",
+               ctx->trace.records, ctx->trace.waits);
+
+    printf("Timers: %ld armed, %ld cancelled, %ld fired (%ld cancels after firing)\n",
+           ctx->timers.armed, ctx->timers.cancelled, ctx->timers.fired, ctx->timers.late_cancels);
+
+    // each partition of pdes_run had a queue of its own: pdes_print_stats reports them
+    if (ctx->merged_parts > 0) return;
+
+    // how big the event pool got, useful to pick --pool-cap for long runs
+    const EventPool *pool = &ctx->queue.pool;
+    printf("Event pool: high-water %d events, %d chunks of %d (%d grown during the run), %ld allocations\n",
+           pool->high_water, pool->n_chunks, EVENT_POOL_CHUNK, pool->chunk_grows, pool->allocs);
+    printf("Zero-delay lane: %ld events scheduled for the current time skipped the priority queue\n",
+           ctx->queue.lane_events);
+}
+
+void sim_destroy(SimContext *ctx) {
+    trace_close(&ctx->trace);
+#ifdef SIM_PROFILE
+    profile_free(&ctx->prof);
+#endif
+    if (!ctx->shared) {
+        sender_free(&ctx->sender);
+        receiver_free(&ctx->receiver);
+        network_free(&ctx->net);
+    }
+    timers_destroy(&ctx->timers);
+    event_queue_destroy(&ctx->queue);
+}
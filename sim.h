@@ -0,0 +1,133 @@
+#ifndef SIM_H
+#define SIM_H
+#include "event.h"
+#include "heap_priority.h"
+#include "timer_wheel.h"
+#include "network.h"
+#include "sender.h"
+#include "receiver.h"
+#include "rng.h"
+#include "trace.h"
+#include "profile.h"
+#include "hist.h"
+
+struct Pdes;
+struct PacketLog;
+
+/*
+A simulation context holds everything one run needs: the clock, the pending events,
+the timers, the network (with the random streams of the nodes) and the flows.
+Nothing is global anymore, so several contexts can run at the same time in different
+threads (see replicate.c), each one with its own seeded random streams.
+
+A context runs the flows [flow_lo, flow_hi). Normally that is every flow, but the parallel
+engine (pdes.h) gives each partition a context of its own that shares the flow and network
+arrays of the main context and only runs its block of flows.
+*/
+
+#define MAX_LIST 64
+
+// the parameters of a run, filled from the command line in main.c
+typedef struct SimConfig {
+    double    send_interval;        // default interval between two packets of a flow
+    double    duration;             // default sending duration of a flow
+    double    base_delay;           // average one-way delay of the network
+    double    jitter;               // maximum variation around base_delay
+    double    rto;                  // retransmission timeout (seconds)
+    double    local_loss;           // probability of a local drop of each DATA packet
+    int       window;               // packets in flight per flow, 0 = per-packet timers and ACKs (sender.h)
+    int       ack_every;            // window mode: one cumulative ACK per ack_every packets in order
+    double    ack_delay;            // window mode: longest wait of a delayed ACK (seconds)
+    int       n_flows;              // number of sender/receiver pairs
+    double    intervals[MAX_LIST];  // flow f uses intervals[f % n_intervals] (if n_intervals > 0)
+    int       n_intervals;
+    double    durations[MAX_LIST];  // flow f uses durations[f % n_durations] (if n_durations > 0)
+    int       n_durations;
+    int       pool_cap;             // fixed event pool size, 0 = grow
+    QueueKind queue_kind;
+    int       queue_arity;
+    int       use_wheel;            // timeouts in the timing wheel (1) or as plain events (0)
+    double    timer_tick;
+    double    time_resolution;      // seconds per tick of the simulation clock (1e-9 = nanoseconds)
+    int         trace_level;        // TRACE_OFF, TRACE_INFO or TRACE_DEBUG (one line per event)
+    const char *trace_path;         // binary trace file, NULL = text lines on stdout
+    const NetTrace *net_trace;      // mapped network trace to replay (--net-trace), NULL = jitter model
+    double    link_bw;              // bits/s of every node's outgoing link, 0 = no bottleneck link
+    double    link_buffer;          // bytes of buffer of a link, 0 = unlimited
+    int       link_shared;          // --link-shared: one link for all the senders instead of one each
+    int       pkt_size;             // bytes of a DATA packet on the link
+    int       ctl_size;             // bytes of a SYN, SYNACK or ACK on the link
+    const Topology *topo;           // multi-hop routes (--topology), NULL = one hop per packet
+    int       split_flows;          // --pdes-split: sender and receiver in different partitions, FINISH takes base_delay - jitter
+} SimConfig;
+
+typedef struct SimContext {
+    SimTime            now;          // current simulated time in ticks (the time of the event being handled)
+    double             ticks_per_s;  // 1 / time_resolution, see sim_ticks and sim_seconds
+    int                stop;         // set when every flow of the context has finished
+    unsigned long long event_seq;    // next Event.seq
+    long               events;       // events handled so far
+    Tracer             trace;
+    EventQueue         queue;
+    TimerWheel         timers;
+    Network            net;
+    Sender             sender;
+    Receiver           receiver;
+    unsigned long long seed;         // what the run was seeded with: same seed and stream -> same run, bit for bit
+    unsigned long long stream;
+    int                flow_lo;      // flows run by this context
+    int                flow_hi;
+    int                shared;       // 1 = net/sender/receiver arrays belong to another context (a partition)
+    struct Pdes       *pdes;         // the parallel run this context is a partition of (NULL = sequential)
+    int                part;         // partition number inside pdes
+    int                merged_parts; // > 0: pdes_run merged the counters of that many partitions into this context
+    LatencyStats       lat;          // delay, RTT and time-to-delivery histograms (hist.h)
+    struct PacketLog  *pkt;          // per-packet records (--pkt-log, pktlog.h), NULL = none
+#ifdef SIM_PROFILE
+    Profile            prof;         // handler times and pending samples (profile.h)
+#endif
+} SimContext;
+
+/* Seconds <-> ticks. Every time kept in the engine is in ticks, a duration given in seconds
+   (intervals, delays, RTO) is rounded to the nearest tick when it enters the engine. */
+static inline SimTime sim_ticks(const SimContext *ctx, double seconds) {
+    return (SimTime)(seconds * ctx->ticks_per_s + 0.5);
+}
+
+static inline double sim_seconds(const SimContext *ctx, SimTime t) {
+    return (double)t / ctx->ticks_per_s;   // a division so that whole ticks give back the same seconds as before
+}
+
+// what a run produced, small enough to be copied around and merged over replications
+typedef struct SimResults {
+    long   logical;          // packets the senders tried to send (sent + local drops)
+    long   sent;
+    long   lost_local;
+    long   unique;           // different packets received
+    long   deliveries;       // packets received, duplicates included
+    long   retransmissions;  // deliveries - unique
+    long   invalid;
+    double avg_delay;        // average one-way network delay
+    double p99_delay;        // 99th percentiles of the latency histograms (seconds)
+    double p99_rtt;
+    double p99_delivery;
+    double delivery_ratio;   // unique / logical
+    long   events;
+    double end_time;         // simulated time when the run stopped
+} SimResults;
+
+void   sim_config_default(SimConfig *cfg);
+int    sim_init(SimContext *ctx, const SimConfig *cfg, unsigned long long seed, unsigned long long stream);
+// sim_init in two steps: allocate everything, then schedule the first events of flows [flow_lo, flow_hi)
+int    sim_alloc(SimContext *ctx, const SimConfig *cfg, unsigned long long seed, unsigned long long stream);
+void   sim_start(SimContext *ctx, int flow_lo, int flow_hi);
+// a context with its own queue and timers that shares the flows and network of parent (see pdes.c)
+void   sim_init_partition(SimContext *part, const SimContext *parent, const SimConfig *cfg, int flow_lo, int flow_hi);
+void   sim_run(SimContext *ctx);
+void    sim_run_until(SimContext *ctx, SimTime end);   // handles the events strictly before end
+SimTime sim_next_time(SimContext *ctx);               // time of the next event, SIM_TIME_MAX if there is none
+void   sim_collect(const SimContext *ctx, SimResults *r);
+void   sim_print_summary(const SimContext *ctx);
+void   sim_destroy(SimContext *ctx);
+
+#endif
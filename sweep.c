@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "sweep.h"
+
+// a point being run by a child
+typedef struct {
+    pid_t pid;
+    int   fd;      // read end of the pipe the child sends its SimResults through
+    int   point;
+} Branch;
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int sweep_points(const SimConfig *cfg, const double *rto, int n_rto, const double *loss, int n_loss,
+                 const double *jitter, int n_jitter, SweepPoint **points) {
+    // a missing list is the one value of the command line
+    if (n_rto == 0)    { rto    = &cfg->rto;        n_rto    = 1; }
+    if (n_loss == 0)   { loss   = &cfg->local_loss; n_loss   = 1; }
+    if (n_jitter == 0) { jitter = &cfg->jitter;     n_jitter = 1; }
+    int n = n_rto * n_loss * n_jitter;
+    SweepPoint *p = malloc(n * sizeof(SweepPoint));
+    if (!p) return 0;
+    int k = 0;
+    for (int i = 0; i < n_rto; i++)
+        for (int j = 0; j < n_loss; j++)
+            for (int l = 0; l < n_jitter; l++) {
+                p[k].rto    = rto[i];
+                p[k].loss   = loss[j];
+                p[k].jitter = jitter[l];
+                k++;
+            }
+    *points = p;
+    return n;
+}
+
+void sweep_apply(SimContext *ctx, const SweepPoint *p) {
+    ctx->sender.rto_ticks = sim_ticks(ctx, p->rto);
+    ctx->sender.loss      = p->loss;
+    network_set_delay(&ctx->net, ctx->net.base_delay, p->jitter);
+}
+
+// the child applies its point to its copy of the context and runs it to the end
+static int start_branch(SimContext *ctx, const SweepPoint *p, Branch *b) {
+    int fds[2];
+    if (pipe(fds) != 0) return 0;
+    fflush(stdout);   // or the child's copy of the buffer could be written twice
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        sweep_apply(ctx, p);
+        sim_run(ctx);
+        SimResults r;
+        sim_collect(ctx, &r);
+        // smaller than PIPE_BUF: one write that never blocks, read once the child is gone
+        ssize_t w;
+        while ((w = write(fds[1], &r, sizeof(r))) < 0 && errno == EINTR) {}
+        _exit(w == (ssize_t)sizeof(r) ? 0 : 1);   // _exit: no atexit handler or stdio flush of the parent's state
+    }
+    close(fds[1]);
+    b->pid = pid;
+    b->fd  = fds[0];
+    return 1;
+}
+
+static int finish_branch(const Branch *b, int status, SimResults *r) {
+    int ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    ssize_t got;
+    while ((got = read(b->fd, r, sizeof(*r))) < 0 && errno == EINTR) {}
+    close(b->fd);
+    return ok && got == (ssize_t)sizeof(*r);
+}
+
+void sweep_run(SimContext *ctx, SimTime branch, const SweepPoint *points, int n, int workers,
+               SimResults *results, char *ok, SweepStats *st) {
+    double start = wall_seconds();
+    sim_run_until(ctx, branch);
+    st->branch        = sim_seconds(ctx, branch);
+    st->prefix_events = ctx->events;
+    st->prefix_wall   = wall_seconds() - start;
+    st->failed        = 0;
+    if (workers < 1) workers = 1;
+    if (workers > n) workers = n;
+    st->workers = workers;
+    for (int k = 0; k < n; k++) ok[k] = 0;
+
+    Branch *live = malloc(workers * sizeof(Branch));
+    int n_live = 0, next = 0;
+    if (!live) next = n;   // nothing can be tracked: every point fails
+    while (next < n || n_live > 0) {
+        if (next < n && n_live < workers) {
+            if (start_branch(ctx, &points[next], &live[n_live])) {
+                live[n_live++].point = next++;
+                continue;
+            }
+            if (n_live == 0) {
+                // no child to wait for, so no process will be freed: this point is given up
+                perror("sweep: fork");
+                next++;
+                continue;
+            }
+            // out of processes or pipes: wait for a running branch and try again
+        }
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;   // no child left, the ones still in live cannot report anymore
+        }
+        for (int i = 0; i < n_live; i++) {
+            if (live[i].pid != pid) continue;
+            int k = live[i].point;
+            ok[k] = (char)finish_branch(&live[i], status, &results[k]);
+            live[i] = live[--n_live];
+            break;
+        }
+    }
+    for (int i = 0; i < n_live; i++) close(live[i].fd);
+    free(live);
+    for (int k = 0; k < n; k++) st->failed += !ok[k];
+    st->wall = wall_seconds() - start;
+}
+
+void print_sweep_report(const SweepPoint *points, int n, const SimResults *results, const char *ok,
+                        const SweepStats *st) {
+    printf("\nSweep: %d points branched at t = %.6f s, %d workers, %.3f s wall\n",
+           n, st->branch, st->workers, st->wall);
+    // without branching every point would handle the prefix again
+    printf("Shared prefix: %ld events in %.3f s wall, run once instead of %d times (%.3f s saved)\n",
+           st->prefix_events, st->prefix_wall, n, (n - 1) * st->prefix_wall);
+    if (st->failed > 0) printf("Failed points: %d\n", st->failed);
+    printf("%10s %8s %8s %10s %10s %12s %12s %12s %12s %10s\n", "rto (s)", "loss", "jitter", "delivery",
+           "retrans", "avg delay", "p99 delay", "p99 RTT", "p99 deliv", "events");
+    for (int k = 0; k < n; k++) {
+        const SweepPoint *p = &points[k];
+        if (!ok[k]) {
+            printf("%10.4f %8.4f %8.4f %10s\n", p->rto, p->loss, p->jitter, "failed");
+            continue;
+        }
+        const SimResults *r = &results[k];
+        printf("%10.4f %8.4f %8.4f %10.6f %10ld %12.6f %12.6f %12.6f %12.6f %10ld\n", p->rto, p->loss, p->jitter,
+               r->delivery_ratio, r->retransmissions, r->avg_delay, r->p99_delay, r->p99_rtt, r->p99_delivery,
+               r->events);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+#include "sim.h"
+
+/*
+Branching parameter sweep (sim --sweep-at T --sweep-rto LIST --sweep-loss LIST --sweep-jitter LIST).
+
+Every point of a sweep replays the same handshake and warm-up before its parameters matter.
+Here the run goes to the branch point T once, then each point is a forked child that starts
+from a copy-on-write image of that state, applies its RTO, loss and jitter, runs to the end
+and sends its SimResults back through a pipe. The children share every page they do not
+write (the event pool, the flow arrays, the histograms as long as they do not change), and
+at most `workers` of them run at the same time.
+
+The points are the cartesian product of the lists, a list that is not given is the value of
+the command line. All the branches continue the same random streams, so two points differ
+only by their parameters (common random numbers), and the point equal to the command line
+gives the same results as the plain run. Timers armed before T keep the RTO they were armed
+with, every timer armed after T uses the new one. With --window a flow estimates its RTO from
+its RTT samples (sender.h), so there is no RTO to sweep and --sweep-rto is refused.
+*/
+
+typedef struct SweepPoint {
+    double rto;      // retransmission timeout (seconds)
+    double loss;     // probability of a local drop of a DATA packet
+    double jitter;   // maximum variation around the base delay
+} SweepPoint;
+
+typedef struct SweepStats {
+    double branch;        // simulated time of the branch point (seconds)
+    long   prefix_events; // events handled before the branch, once for every point
+    double prefix_wall;   // wall time of the shared prefix (seconds)
+    double wall;          // wall time of the whole sweep, prefix included
+    int    workers;       // children running at the same time at most
+    int    failed;        // points without a result (fork failed or the child died)
+} SweepStats;
+
+// the points of the product of the lists (n = 0 means the value of cfg). Returns the count, 0 on failure.
+int  sweep_points(const SimConfig *cfg, const double *rto, int n_rto, const double *loss, int n_loss,
+                  const double *jitter, int n_jitter, SweepPoint **points);
+// the parameters of p in a running context (what a child does right after the fork)
+void sweep_apply(SimContext *ctx, const SweepPoint *p);
+/* ctx comes from sim_init: runs it to `branch`, then every point in a child, at most `workers` at once.
+   ok[k] = 1 if results[k] holds point k. The context is left at the branch point. */
+void sweep_run(SimContext *ctx, SimTime branch, const SweepPoint *points, int n, int workers,
+               SimResults *results, char *ok, SweepStats *st);
+void print_sweep_report(const SweepPoint *points, int n, const SimResults *results, const char *ok,
+                        const SweepStats *st);
+
+#endif
@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "timer_wheel.h"
+#include "sim.h"
+
+#define TW_OVERFLOW (TW_LEVELS * TW_SLOTS)
+
+static TimerHandle make_handle(int idx, unsigned int gen) {
+    return ((TimerHandle)gen << 32) | (unsigned int)idx;
+}
+
+static long long tick_of(const TimerWheel *w, SimTime time) {
+    return time / w->tick;
+}
+
+static int list_level(int list) {
+    return list == TW_OVERFLOW ? TW_LEVELS : list / TW_SLOTS;
+}
+
+// takes a node from the free list, grows the node array when it is empty
+static int alloc_node(TimerWheel *w) {
+    if (w->free_node < 0) {
+        int new_cap = w->nodes_cap ? w->nodes_cap * 2 : 1024;
+        TimerNode *nodes = realloc(w->nodes, new_cap * sizeof(TimerNode));
+        if (!nodes) {
+            fprintf(stderr, "timer_arm: cannot grow the timer wheel\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = new_cap - 1; i >= w->nodes_cap; i--) {
+            nodes[i].gen  = 1;
+            nodes[i].list = -1;
+            nodes[i].next = w->free_node;
+            w->free_node  = i;
+        }
+        w->nodes     = nodes;
+        w->nodes_cap = new_cap;
+    }
+    int n = w->free_node;
+    w->free_node = w->nodes[n].next;
+    return n;
+}
+
+static void free_node(TimerWheel *w, int n) {
+    w->nodes[n].gen++;
+    if (w->nodes[n].gen == 0) w->nodes[n].gen = 1;   // handle 0 must stay "no timer"
+    w->nodes[n].list = -1;
+    w->nodes[n].next = w->free_node;
+    w->free_node = n;
+}
+
+static void link_node(TimerWheel *w, int n, int list) {
+    TimerNode *t = &w->nodes[n];
+    t->list = list;
+    t->prev = -1;
+    t->next = w->head[list];
+    if (t->next >= 0) w->nodes[t->next].prev = n;
+    w->head[list] = n;
+    w->level_count[list_level(list)]++;
+    w->count++;
+}
+
+static void unlink_node(TimerWheel *w, int n) {
+    TimerNode *t = &w->nodes[n];
+    if (t->prev >= 0) w->nodes[t->prev].next = t->next;
+    else              w->head[t->list] = t->next;
+    if (t->next >= 0) w->nodes[t->next].prev = t->prev;
+    w->level_count[list_level(t->list)]--;
+    w->count--;
+}
+
+/* Puts the node in the lowest level whose slot range still contains both the
+   current tick and the timer's tick: level 0 if they are in the same block of 64 ticks,
+   level 1 if they are in the same block of 64*64 ticks, ... */
+static void place_node(TimerWheel *w, int n) {
+    long long t = tick_of(w, w->nodes[n].time);
+    for (int level = 0; level < TW_LEVELS; level++) {
+        int above = TW_BITS * (level + 1);
+        if ((t >> above) == (w->cur_tick >> above)) {
+            int slot = (int)((t >> (TW_BITS * level)) & (TW_SLOTS - 1));
+            link_node(w, n, level * TW_SLOTS + slot);
+            return;
+        }
+    }
+    link_node(w, n, TW_OVERFLOW);
+}
+
+// the timer is due: it becomes a normal event in the queue with the seq it got at arm time
+static void fire_node(SimContext *ctx, int n) {
+    TimerWheel *w = &ctx->timers;
+    TimerNode *t = &w->nodes[n];
+    schedule_event_with_seq(ctx, t->time, t->src, t->dst, t->packet_id, t->handler, t->seq);
+    w->fired++;
+    free_node(w, n);
+}
+
+// spreads one slot (or the overflow list) over the lower levels
+static void cascade(TimerWheel *w, int list) {
+    int n = w->head[list];
+    while (n >= 0) {
+        int next = w->nodes[n].next;
+        unlink_node(w, n);
+        place_node(w, n);
+        n = next;
+    }
+}
+
+// called every time cur_tick has moved to a new value that may be a 64^L boundary
+static void cascade_boundaries(TimerWheel *w) {
+    long long top = (long long)1 << (TW_BITS * TW_LEVELS);
+    if ((w->cur_tick & (top - 1)) == 0) cascade(w, TW_OVERFLOW);
+    for (int level = TW_LEVELS - 1; level >= 1; level--) {
+        long long span = (long long)1 << (TW_BITS * level);
+        if ((w->cur_tick & (span - 1)) == 0) {
+            int slot = (int)((w->cur_tick >> (TW_BITS * level)) & (TW_SLOTS - 1));
+            cascade(w, level * TW_SLOTS + slot);
+        }
+    }
+}
+
+static int cmp_due(const void *a, const void *b) {
+    SimTime x = ((const TimerDue *)a)->time, y = ((const TimerDue *)b)->time;
+    return (x > y) - (x < y);
+}
+
+static void due_reserve(TimerWheel *w, int n) {
+    if (n <= w->due_cap) return;
+    int new_cap = w->due_cap ? 2 * w->due_cap : 256;
+    while (new_cap < n) new_cap *= 2;
+    TimerDue *due = realloc(w->due, new_cap * sizeof(TimerDue));
+    if (!due) {
+        fprintf(stderr, "timer wheel: cannot grow the list of due timers\n");
+        exit(EXIT_FAILURE);
+    }
+    w->due     = due;
+    w->due_cap = new_cap;
+}
+
+/* The timers of the current tick, sorted by time, built the first time the tick is looked at.
+   Cancelled timers are not removed from it, they are skipped (their node has another gen). */
+static void due_build(TimerWheel *w) {
+    int list = (int)(w->cur_tick & (TW_SLOTS - 1));
+    int k = 0;
+    for (int n = w->head[list]; n >= 0; n = w->nodes[n].next) k++;
+    due_reserve(w, k);
+    k = 0;
+    for (int n = w->head[list]; n >= 0; n = w->nodes[n].next)
+        w->due[k++] = (TimerDue){ w->nodes[n].time, n, w->nodes[n].gen };
+    qsort(w->due, k, sizeof(TimerDue), cmp_due);
+    w->due_n    = k;
+    w->due_pos  = 0;
+    w->due_tick = w->cur_tick;
+}
+
+// a timer armed in the current tick after its list was built goes to its place in the list
+static void due_add(TimerWheel *w, int n) {
+    due_reserve(w, w->due_n + 1);
+    SimTime time = w->nodes[n].time;
+    int i = w->due_n;
+    while (i > w->due_pos && w->due[i - 1].time > time) {
+        w->due[i] = w->due[i - 1];
+        i--;
+    }
+    w->due[i] = (TimerDue){ time, n, w->nodes[n].gen };
+    w->due_n++;
+}
+
+// earliest timer still armed in the current tick (SIM_TIME_MAX if none)
+static SimTime due_first(TimerWheel *w) {
+    if (w->due_tick != w->cur_tick) due_build(w);
+    while (w->due_pos < w->due_n) {
+        const TimerDue *d = &w->due[w->due_pos];
+        if (w->nodes[d->node].gen == d->gen && w->nodes[d->node].list >= 0) return d->time;
+        w->due_pos++;   // cancelled
+    }
+    return SIM_TIME_MAX;
+}
+
+// fires every timer of the current tick at `time` (the one due_first returned)
+static int due_fire(SimContext *ctx, SimTime time) {
+    TimerWheel *w = &ctx->timers;
+    int moved = 0;
+    while (w->due_pos < w->due_n && w->due[w->due_pos].time == time) {
+        const TimerDue *d = &w->due[w->due_pos++];
+        if (w->nodes[d->node].gen != d->gen || w->nodes[d->node].list < 0) continue;
+        unlink_node(w, d->node);
+        fire_node(ctx, d->node);
+        moved++;
+    }
+    return moved;
+}
+
+// moves cur_tick to the next tick that can hold a timer (cur_tick's slot must be empty by now)
+static void step(TimerWheel *w) {
+    if (w->level_count[0] > 0) w->cur_tick++;
+    else                       w->cur_tick = (w->cur_tick | (TW_SLOTS - 1)) + 1;   // level 0 empty: next 64-tick boundary
+    if ((w->cur_tick & (TW_SLOTS - 1)) == 0) cascade_boundaries(w);
+}
+
+/* Fires the earliest pending timers (every timer at that time) if they are due at or before
+   `time`, and nothing else. cur_tick stops on the tick of these timers, so the events they run
+   can still arm and cancel timers in that tick: only timers that are really due ever leave
+   the wheel. Moving a whole tick (or everything up to the next event) at once would fire
+   timers early, and whether a timeout gets cancelled in time would then depend on which other
+   events happened to run around it: a partition of pdes.c (fewer flows, other events) would
+   not fire the same timeouts as the sequential run. */
+static int fire_next(SimContext *ctx, SimTime time) {
+    TimerWheel *w = &ctx->timers;
+    long long target = tick_of(w, time);
+    while (w->count > 0 && w->cur_tick <= target) {
+        if (w->level_count[0] > 0 && w->head[w->cur_tick & (TW_SLOTS - 1)] >= 0) {
+            SimTime first = due_first(w);
+            return first <= time ? due_fire(ctx, first) : 0;
+        }
+        if (w->level_count[0] == 0 && ((w->cur_tick | (TW_SLOTS - 1)) + 1) > target) return 0;
+        step(w);
+    }
+    return 0;
+}
+
+void timers_init(TimerWheel *w, int enabled, SimTime tick) {
+    w->enabled      = enabled;
+    w->tick         = tick > 0 ? tick : 1;
+    w->cur_tick     = 0;
+    w->due          = NULL;
+    w->due_n        = 0;
+    w->due_pos      = 0;
+    w->due_cap      = 0;
+    w->due_tick     = -1;
+    for (int i = 0; i <= TW_OVERFLOW; i++) w->head[i] = -1;
+    for (int l = 0; l <= TW_LEVELS; l++) w->level_count[l] = 0;
+    w->count        = 0;
+    w->nodes        = NULL;
+    w->nodes_cap    = 0;
+    w->free_node    = -1;
+    w->armed        = 0;
+    w->cancelled    = 0;
+    w->fired        = 0;
+    w->late_cancels = 0;
+}
+
+void timers_destroy(TimerWheel *w) {
+    free(w->nodes);
+    free(w->due);
+    w->due       = NULL;
+    w->due_cap   = 0;
+    w->nodes     = NULL;
+    w->nodes_cap = 0;
+    w->free_node = -1;
+}
+
+// arms a timer that calls handler at `time` unless it is cancelled before
+TimerHandle timer_arm(SimContext *ctx, SimTime time, int src, int dst, int packet_id, HandlerId handler) {
+    TimerWheel *w = &ctx->timers;
+    w->armed++;
+    unsigned long long seq = ctx->event_seq++;
+    if (!w->enabled || tick_of(w, time) < w->cur_tick) {
+        // wheel disabled, or the tick of this timer has already been processed: straight to the queue
+        schedule_event_with_seq(ctx, time, src, dst, packet_id, handler, seq);
+        w->fired++;
+        return 0;
+    }
+    int n = alloc_node(w);
+    TimerNode *t = &w->nodes[n];
+    t->time      = time;
+    t->seq       = seq;
+    t->src       = src;
+    t->dst       = dst;
+    t->packet_id = packet_id;
+    t->handler   = handler;
+    place_node(w, n);
+    if (w->due_tick == w->cur_tick && tick_of(w, time) == w->cur_tick) due_add(w, n);
+    return make_handle(n, t->gen);
+}
+
+// returns 1 if the timer was still armed and is now removed, 0 if the handle is stale
+int timer_cancel(SimContext *ctx, TimerHandle h) {
+    TimerWheel *w = &ctx->timers;
+    if (h == 0) return 0;
+    int n = (int)(h & 0xffffffffu);
+    unsigned int gen = (unsigned int)(h >> 32);
+    if (n >= w->nodes_cap || w->nodes[n].gen != gen || w->nodes[n].list < 0) {
+        w->late_cancels++;
+        return 0;
+    }
+    unlink_node(w, n);
+    free_node(w, n);
+    w->cancelled++;
+    return 1;
+}
+
+// for the end of a flow, which cancels every handle it still holds without knowing which ones fired
+int timer_discard(SimContext *ctx, TimerHandle h) {
+    TimerWheel *w = &ctx->timers;
+    if (h == 0) return 0;
+    int n = (int)(h & 0xffffffffu);
+    unsigned int gen = (unsigned int)(h >> 32);
+    if (n >= w->nodes_cap || w->nodes[n].gen != gen || w->nodes[n].list < 0) return 0;
+    return timer_cancel(ctx, h);
+}
+
+int timers_expire_until(SimContext *ctx, SimTime time) {
+    TimerWheel *w = &ctx->timers;
+    if (w->count == 0 || tick_of(w, time) < w->cur_tick) return 0;
+    return fire_next(ctx, time);
+}
+
+static SimTime list_min(const TimerWheel *w, int list) {
+    SimTime first = SIM_TIME_MAX;
+    for (int n = w->head[list]; n >= 0; n = w->nodes[n].next)
+        if (w->nodes[n].time < first) first = w->nodes[n].time;
+    return first;
+}
+
+/* Every timer of level L is in the block of 64^(L+1) ticks of cur_tick, after the slot of
+   cur_tick, and later than every timer of the levels below: the first non-empty slot from
+   cur_tick on, level by level, holds the earliest timer. Nothing moves, unlike fire_next. */
+SimTime timers_next_time(const TimerWheel *w) {
+    if (w->count == 0) return SIM_TIME_MAX;
+    for (int level = 0; level < TW_LEVELS; level++) {
+        if (w->level_count[level] == 0) continue;
+        for (int slot = (int)((w->cur_tick >> (TW_BITS * level)) & (TW_SLOTS - 1)); slot < TW_SLOTS; slot++) {
+            SimTime first = list_min(w, level * TW_SLOTS + slot);
+            if (first != SIM_TIME_MAX) return first;
+        }
+    }
+    return list_min(w, TW_OVERFLOW);
+}
@@ -0,0 +1,78 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+#include "event.h"
+
+/*
+Hierarchical timing wheel for timers that are usually cancelled (retransmission timeouts).
+
+Before, every DATA packet scheduled an snd_timeout event and most of them found the packet
+already ACKed when they fired, so the event queue was full of dead timeouts.
+Now a timeout is a timer: timer_arm() puts it in the wheel and returns a handle,
+timer_cancel() removes it in O(1) when the ACK comes back. Only timers that are still armed
+when their time comes are moved into the event queue (as a normal event with the same
+time, seq and handler it would have had), so dead timers never enter the queue.
+
+The wheel cuts simulated time in its own ticks of `tick` time units each (--timer-tick is
+given in seconds and converted). Level 0 has one slot per wheel tick,
+level L has one slot per 64^L ticks (4 levels of 64 slots cover 64^4 ticks, the rest waits
+in an overflow list). When the current tick crosses a 64^L boundary the matching level L
+slot is spread over the lower levels ("cascade").
+*/
+
+#define TW_BITS   6
+#define TW_SLOTS  (1 << TW_BITS)   // 64 slots per level
+#define TW_LEVELS 4
+
+typedef unsigned long long TimerHandle;   // 0 = no timer
+
+typedef struct {
+    SimTime      time;
+    unsigned long long seq;   // taken at arm time so a timer fires in the same order as a plain event
+    int          src;
+    int          dst;
+    int          packet_id;
+    HandlerId    handler;
+    int          prev;        // links inside the slot list (-1 = none)
+    int          next;        // also links the free nodes
+    int          list;        // which list holds the node: level * TW_SLOTS + slot, TW_OVERFLOW, or -1 if free
+    unsigned int gen;         // incremented every time the node is freed, so old handles become invalid
+} TimerNode;
+
+// one entry of the sorted list of the current tick
+typedef struct {
+    SimTime      time;
+    int          node;
+    unsigned int gen;        // the entry is stale if the node was freed since
+} TimerDue;
+
+typedef struct {
+    int        enabled;      // 0 = timers are scheduled directly as events (old behaviour, cancel does nothing)
+    SimTime    tick;         // time ticks per level-0 slot
+    long long  cur_tick;     // every tick before this one has been moved to the event queue (this one: the timers already due)
+    TimerDue  *due;          // timers of the tick cur_tick sorted by time (see fire_next in timer_wheel.c)
+    int        due_n;
+    int        due_pos;      // the ones before have been fired or cancelled
+    int        due_cap;
+    long long  due_tick;     // tick the list was built for (-1 = none)
+    int        head[TW_LEVELS * TW_SLOTS + 1];   // +1 for the overflow list
+    int        level_count[TW_LEVELS + 1];
+    int        count;        // timers currently in the wheel
+    TimerNode *nodes;
+    int        nodes_cap;
+    int        free_node;
+    long       armed;        // timer_arm calls
+    long       cancelled;    // timers removed before they fired
+    long       fired;        // timers moved to the event queue
+    long       late_cancels; // cancel calls that came after the timer had already been moved
+} TimerWheel;
+
+// the wheel of a simulation is ctx->timers
+void        timers_init(TimerWheel *w, int enabled, SimTime tick);
+void        timers_destroy(TimerWheel *w);
+TimerHandle timer_arm(struct SimContext *ctx, SimTime time, int src, int dst, int packet_id, HandlerId handler);
+int         timer_cancel(struct SimContext *ctx, TimerHandle h);
+int         timer_discard(struct SimContext *ctx, TimerHandle h);   // timer_cancel, but a stale handle is no late cancel
+int         timers_expire_until(struct SimContext *ctx, SimTime time);   // moves the earliest timers if they are due at or before time, returns how many
+SimTime     timers_next_time(const TimerWheel *w);                      // time of the earliest timer, SIM_TIME_MAX if none
+
+#endif
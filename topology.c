@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "topology.h"
+
+// skips blanks, returns NULL at the end of the statement (end of line or #)
+static char *next_field(char *s) {
+    while (*s == ' ' || *s == '\t' || *s == ',') s++;
+    return (*s == '\0' || *s == '\n' || *s == '\r' || *s == '#') ? NULL : s;
+}
+
+int topology_load(Topology *t, const char *path) {
+    memset(t, 0, sizeof(*t));
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 0;
+    }
+    int  cap = 0, ok = 1;
+    long line_no = 0;
+    char line[512];
+    while (ok && fgets(line, sizeof(line), in)) {
+        line_no++;
+        char *s = next_field(line);
+        if (!s) continue;
+        if (strncmp(s, "nodes", 5) == 0) {
+            t->n_nodes = atoi(s + 5);
+            ok = t->n_nodes > 0 && t->n_links == 0;
+        } else if (strncmp(s, "link", 4) == 0) {
+            TopoLink l = { 0, 0, 0.0, 0.0, 0.0, 0.0, 64 * 1500.0 };
+            double v[7] = { 0 };
+            int nv = 0;
+            char *p = s + 4, *end;
+            while (nv < 7 && (p = next_field(p)) != NULL) {
+                v[nv++] = strtod(p, &end);
+                if (end == p) break;
+                p = end;
+            }
+            l.a = (int)v[0];
+            l.b = (int)v[1];
+            l.delay = v[2];
+            if (nv > 3) l.jitter = v[3];
+            if (nv > 4) l.loss   = v[4];
+            if (nv > 5) l.bw     = v[5];
+            if (nv > 6) l.buffer = v[6];
+            ok = nv >= 3 && t->n_nodes > 0 && l.a >= 0 && l.a < t->n_nodes && l.b >= 0 && l.b < t->n_nodes &&
+                 l.a != l.b && l.delay >= 0.0 && l.jitter >= 0.0 && l.loss >= 0.0 && l.loss < 1.0 && l.bw >= 0.0;
+            if (ok && t->n_links == cap) {
+                cap = cap ? 2 * cap : 1024;
+                TopoLink *links = realloc(t->link, cap * sizeof(TopoLink));
+                if (!links) {
+                    fprintf(stderr, "%s: out of memory at line %ld\n", path, line_no);
+                    fclose(in);
+                    topology_free(t);
+                    return 0;
+                }
+                t->link = links;
+            }
+            if (ok) t->link[t->n_links++] = l;
+        } else {
+            ok = 0;
+        }
+    }
+    fclose(in);
+    if (!ok || t->n_nodes == 0) {
+        if (ok) fprintf(stderr, "%s: no \"nodes N\" line\n", path);
+        else    fprintf(stderr, "%s:%ld: expected \"nodes N\" then \"link A B DELAY [JITTER [LOSS [BW [BUF]]]]\"\n", path, line_no);
+        topology_free(t);
+        return 0;
+    }
+
+    // adjacency in one array (counting sort of the directed links by their first node)
+    t->adj_off = calloc((size_t)t->n_nodes + 1, sizeof(int));
+    t->adj     = malloc(2 * (size_t)t->n_links * sizeof(int) + 1);
+    if (!t->adj_off || !t->adj) {
+        fprintf(stderr, "%s: cannot allocate the adjacency of %d nodes\n", path, t->n_nodes);
+        topology_free(t);
+        return 0;
+    }
+    for (int d = 0; d < 2 * t->n_links; d++) t->adj_off[topo_link_from(t, d) + 1]++;
+    for (int u = 0; u < t->n_nodes; u++) t->adj_off[u + 1] += t->adj_off[u];
+    int *fill = malloc((size_t)t->n_nodes * sizeof(int));
+    if (!fill) {
+        topology_free(t);
+        return 0;
+    }
+    memcpy(fill, t->adj_off, (size_t)t->n_nodes * sizeof(int));
+    for (int d = 0; d < 2 * t->n_links; d++) t->adj[fill[topo_link_from(t, d)]++] = d;
+    free(fill);
+    return 1;
+}
+
+/* One side of a bidirectional Dijkstra (from the sender, or from the receiver), reused by every
+   flow. Only the nodes a search touched are reset after it, so a search costs what it explored,
+   not n_nodes. */
+typedef struct {
+    double *dist;
+    int    *via;       // directed link the best path arrives by (leaves by, on the receiver side)
+    int    *touched;
+    int     n_touched;
+    double *hd;        // binary heap of (distance, node), stale entries are skipped when popped
+    int    *hn;
+    int     hsize, hcap;
+} Side;
+
+static int side_init(Side *s, int n_nodes) {
+    memset(s, 0, sizeof(*s));
+    s->dist    = malloc((size_t)n_nodes * sizeof(double));
+    s->via     = malloc((size_t)n_nodes * sizeof(int));
+    s->touched = malloc((size_t)n_nodes * sizeof(int));
+    if (!s->dist || !s->via || !s->touched) return 0;
+    for (int u = 0; u < n_nodes; u++) s->dist[u] = INFINITY;
+    return 1;
+}
+
+static void side_reset(Side *s) {
+    for (int i = 0; i < s->n_touched; i++) s->dist[s->touched[i]] = INFINITY;
+    s->n_touched = 0;
+    s->hsize = 0;
+}
+
+static void side_free(Side *s) {
+    free(s->dist);
+    free(s->via);
+    free(s->touched);
+    free(s->hd);
+    free(s->hn);
+}
+
+static int heap_push(Side *s, double d, int u) {
+    if (s->hsize == s->hcap) {
+        int cap = s->hcap ? 2 * s->hcap : 1024;
+        double *hd = realloc(s->hd, cap * sizeof(double));
+        if (!hd) return 0;
+        s->hd = hd;
+        int *hn = realloc(s->hn, cap * sizeof(int));
+        if (!hn) return 0;
+        s->hn = hn;
+        s->hcap = cap;
+    }
+    int i = s->hsize++;
+    while (i > 0 && s->hd[(i - 1) / 2] > d) {
+        s->hd[i] = s->hd[(i - 1) / 2];
+        s->hn[i] = s->hn[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s->hd[i] = d;
+    s->hn[i] = u;
+    return 1;
+}
+
+static void heap_pop(Side *s) {
+    double d = s->hd[--s->hsize];
+    int    u = s->hn[s->hsize];
+    int i = 0;
+    while (1) {
+        int c = 2 * i + 1;
+        if (c >= s->hsize) break;
+        if (c + 1 < s->hsize && s->hd[c + 1] < s->hd[c]) c++;
+        if (s->hd[c] >= d) break;
+        s->hd[i] = s->hd[c];
+        s->hn[i] = s->hn[c];
+        i = c;
+    }
+    s->hd[i] = d;
+    s->hn[i] = u;
+}
+
+static int visit(Side *s, int u, double d, int via) {
+    if (isinf(s->dist[u])) s->touched[s->n_touched++] = u;
+    s->dist[u] = d;
+    s->via[u]  = via;
+    return heap_push(s, d, u);
+}
+
+/* Shortest path by delay from src to dst, searched from both ends at once (the links are
+   full duplex with the same delay both ways): the two searches stop once their frontiers are
+   further apart than the best path through a node both reached, which on a large graph
+   explores a small part of what a search from src alone would. Returns the node where the two
+   halves meet (-1 = unreachable, -2 = no memory). */
+static int shortest_path(const Topology *t, Side *fw, Side *bw, int src, int dst) {
+    if (!visit(fw, src, 0.0, -1) || !visit(bw, dst, 0.0, -1)) return -2;
+    double best = src == dst ? 0.0 : INFINITY;
+    int    meet = src == dst ? src : -1;
+    while (fw->hsize > 0 && bw->hsize > 0 && fw->hd[0] + bw->hd[0] < best) {
+        // grow the side with the smaller frontier
+        Side *s = fw->hsize <= bw->hsize ? fw : bw;
+        Side *o = s == fw ? bw : fw;
+        double d = s->hd[0];
+        int    u = s->hn[0];
+        heap_pop(s);
+        if (d > s->dist[u]) continue;   // stale entry
+        for (int i = t->adj_off[u]; i < t->adj_off[u + 1]; i++) {
+            int l = t->adj[i];
+            int v = topo_link_to(t, l);
+            double nd = d + t->link[l >> 1].delay;
+            if (nd < s->dist[v] && !visit(s, v, nd, l)) return -2;
+            if (nd + o->dist[v] < best) {
+                best = nd + o->dist[v];
+                meet = v;
+            }
+        }
+    }
+    return meet;
+}
+
+int topology_route_flows(Topology *t, int n_flows) {
+    Side fw, bw;
+    int ok = side_init(&fw, t->n_nodes) & side_init(&bw, t->n_nodes);
+    t->n_flows      = n_flows;
+    t->route_off    = malloc(((size_t)n_flows + 1) * sizeof(int));
+    t->route_queued = calloc((size_t)n_flows, 1);
+    ok = ok && t->route_off && t->route_queued;
+    int oom = !ok;
+
+    int cap = 0, used = 0;
+    long total_hops = 0;
+    t->max_hops = 0;
+    t->n_queued = 0;
+    for (int f = 0; ok && f < n_flows; f++) {
+        int src = (2 * f) % t->n_nodes, dst = (2 * f + 1) % t->n_nodes;
+        int meet = shortest_path(t, &fw, &bw, src, dst);
+        if (meet == -1) {
+            fprintf(stderr, "topology: node %d (receiver of flow %d) cannot be reached from node %d\n", dst, f, src);
+            ok = 0;
+        } else if (meet < 0) {
+            ok = 0;
+            oom = 1;
+        }
+        int hops = 0;
+        if (ok) {
+            for (int u = meet; u != src; u = topo_link_from(t, fw.via[u])) hops++;
+            for (int u = meet; u != dst; u = topo_link_from(t, bw.via[u])) hops++;
+        }
+        if (ok && used + hops > cap) {
+            cap = 2 * (used + hops) + 1024;
+            int *route = realloc(t->route, cap * sizeof(int));
+            if (route) {
+                t->route = route;
+            } else {
+                ok = 0;
+                oom = 1;
+            }
+        }
+        if (ok) {
+            // the sender half comes out from meet back to src, the receiver half from meet on to dst
+            t->route_off[f] = used;
+            int i = used;
+            for (int u = meet; u != src; u = topo_link_from(t, fw.via[u])) i++;
+            int j = i;
+            for (int u = meet; u != src; u = topo_link_from(t, fw.via[u])) t->route[--j] = fw.via[u];
+            for (int u = meet; u != dst; u = topo_link_from(t, bw.via[u])) t->route[i++] = bw.via[u] ^ 1;
+            for (int k = used; k < used + hops; k++)
+                if (t->link[t->route[k] >> 1].bw > 0.0) t->route_queued[f] = 1;
+            used += hops;
+            total_hops += hops;
+            if (hops > t->max_hops) t->max_hops = hops;
+            t->n_queued += t->route_queued[f];
+        }
+        side_reset(&fw);
+        side_reset(&bw);
+    }
+    if (ok) {
+        t->route_off[n_flows] = used;
+        t->mean_hops = n_flows > 0 ? (double)total_hops / n_flows : 0.0;
+    } else if (oom) {
+        fprintf(stderr, "topology: cannot allocate the routes of %d flows\n", n_flows);
+    }
+    side_free(&fw);
+    side_free(&bw);
+    return ok;
+}
+
+void topology_free(Topology *t) {
+    free(t->link);
+    free(t->adj_off);
+    free(t->adj);
+    free(t->route_off);
+    free(t->route);
+    free(t->route_queued);
+    memset(t, 0, sizeof(*t));
+}
@@ -0,0 +1,59 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+/*
+Multi-hop topology (sim --topology FILE): a graph of nodes joined by links, each link with its
+own delay, jitter, loss and optionally a bandwidth. Without it the network is one hop between
+the sender and the receiver of a flow.
+
+File, one statement per line, # starts a comment:
+  nodes N                                    N nodes numbered 0..N-1, before any link
+  link A B DELAY [JITTER [LOSS [BW [BUF]]]]  full-duplex link between A and B:
+                                             DELAY, JITTER in seconds, LOSS a probability,
+                                             BW in bits/s (0 = no queueing), BUF in bytes
+Simulation node h (2f = sender of flow f, 2f+1 = its receiver) sits on topology node h mod N.
+
+Routes are the shortest paths by delay. They are computed at startup for the flows only
+(one bidirectional Dijkstra per flow, from the sender and the receiver until the two meet,
+touching only the nodes it reaches), never for every pair of nodes, so a graph of 100k nodes
+costs its load time plus what the flows use.
+A route is stored as the list of the directed links it crosses; the way back is the same list
+walked backwards.
+
+A directed link d is link d / 2 crossed from a to b (d even) or from b to a (d odd).
+*/
+
+typedef struct TopoLink {
+    int    a, b;
+    double delay;
+    double jitter;
+    double loss;
+    double bw;       // bits/s, 0 = infinite: the link has no state and never queues
+    double buffer;   // bytes, used when bw > 0 (0 = unlimited)
+} TopoLink;
+
+typedef struct Topology {
+    int       n_nodes;
+    int       n_links;
+    TopoLink *link;
+    int      *adj_off;     // directed links leaving node u: adj[adj_off[u] .. adj_off[u+1])
+    int      *adj;
+    // routes of the flows, sender -> receiver
+    int       n_flows;
+    int      *route_off;   // directed links of flow f: route[route_off[f] .. route_off[f+1])
+    int      *route;
+    unsigned char *route_queued;   // 1 = a link of the route has a bandwidth: the packets go hop by hop
+    int       max_hops;
+    double    mean_hops;
+    int       n_queued;    // flows whose route has a link with a bandwidth
+} Topology;
+
+// return 0 (and print why) if the file cannot be read, or if a receiver cannot be reached
+int  topology_load(Topology *t, const char *path);
+int  topology_route_flows(Topology *t, int n_flows);
+void topology_free(Topology *t);
+
+static inline int topo_link_from(const Topology *t, int d) { return d & 1 ? t->link[d >> 1].b : t->link[d >> 1].a; }
+static inline int topo_link_to(const Topology *t, int d)   { return d & 1 ? t->link[d >> 1].a : t->link[d >> 1].b; }
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "trace.h"
+
+/* The writer thread: takes everything between tail and head and writes it in one fwrite
+   (two when the records wrap around the end of the ring). When the ring is empty it sleeps
+   a little instead of spinning, the simulation never waits for it unless the ring is full. */
+static void *trace_writer(void *arg) {
+    Tracer *t = arg;
+    unsigned long tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+    struct timespec nap = { 0, 100000 };   // 0.1 ms
+    while (1) {
+        unsigned long head = atomic_load_explicit(&t->head, memory_order_acquire);
+        if (head == tail) {
+            // done is set after the last record, so head is final once done is seen
+            if (atomic_load_explicit(&t->done, memory_order_acquire) &&
+                atomic_load_explicit(&t->head, memory_order_acquire) == tail)
+                break;
+            nanosleep(&nap, NULL);
+            continue;
+        }
+        while (tail != head) {
+            unsigned long start = tail & (TRACE_RING - 1);
+            unsigned long n = head - tail;
+            if (n > TRACE_RING - start) n = TRACE_RING - start;
+            fwrite(&t->ring[start], sizeof(TraceRecord), n, t->out);
+            tail += n;
+        }
+        atomic_store_explicit(&t->tail, tail, memory_order_release);
+    }
+    return NULL;
+}
+
+int trace_open(Tracer *t, int level, const char *path) {
+    t->level   = level;
+    t->binary  = 0;
+    t->out     = stdout;
+    t->ring    = NULL;
+    t->records = 0;
+    t->waits   = 0;
+    atomic_init(&t->head, 0);
+    atomic_init(&t->tail, 0);
+    atomic_init(&t->done, 0);
+    if (!path || level == TRACE_OFF) return 1;
+
+    t->out  = fopen(path, "wb");
+    t->ring = malloc(TRACE_RING * sizeof(TraceRecord));
+    if (!t->out || !t->ring) {
+        if (t->out) fclose(t->out);
+        free(t->ring);
+        t->out  = stdout;
+        t->ring = NULL;
+        return 0;
+    }
+    fwrite(TRACE_MAGIC, 1, 8, t->out);
+    if (pthread_create(&t->writer, NULL, trace_writer, t) != 0) {
+        fclose(t->out);
+        free(t->ring);
+        t->out  = stdout;
+        t->ring = NULL;
+        return 0;
+    }
+    t->binary = 1;
+    return 1;
+}
+
+void trace_close(Tracer *t) {
+    if (!t->binary) return;
+    atomic_store_explicit(&t->done, 1, memory_order_release);
+    pthread_join(t->writer, NULL);
+    fclose(t->out);
+    free(t->ring);
+    t->ring   = NULL;
+    t->out    = stdout;
+    t->binary = 0;
+}
+
+void trace_emit(Tracer *t, int level, int code, double time, int flow, int a, int b) {
+    TraceRecord r;
+    r.time  = time;
+    r.flow  = flow;
+    r.a     = a;
+    r.b     = b;
+    r.code  = (unsigned short)code;
+    r.level = (unsigned short)level;
+    t->records++;
+    if (!t->binary) {
+        trace_print(stdout, &r);
+        return;
+    }
+    // single producer: only this thread moves head, the writer only moves tail
+    unsigned long head = atomic_load_explicit(&t->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&t->tail, memory_order_acquire) == TRACE_RING) {
+        t->waits++;
+        while (head - atomic_load_explicit(&t->tail, memory_order_acquire) == TRACE_RING)
+            sched_yield();
+    }
+    t->ring[head & (TRACE_RING - 1)] = r;
+    atomic_store_explicit(&t->head, head + 1, memory_order_release);
+}
+
+void trace_print(FILE *f, const TraceRecord *r) {
+    double now = r->time;
+    int fl = r->flow;
+    switch (r->code) {
+    case TR_SND_SYN:          fprintf(f, "[%.3f] Sender %d: SEND SYN\n", now, fl); break;
+    case TR_SND_SYNACK:       fprintf(f, "[%.3f] Sender %d: RECV SYNACK -> SEND ACK, start data\n", now, fl); break;
+    case TR_SND_LOCAL_DROP:   fprintf(f, "[%.3f] Sender %d: LOCAL DROP of pkt #%d\n", now, fl, r->a); break;
+    case TR_SND_DATA:         fprintf(f, "[%.3f] Sender %d: SEND DATA #%d\n", now, fl, r->a); break;
+    case TR_SND_ACK:          fprintf(f, "[%.3f] Sender %d: RECV ACK for pkt #%d\n", now, fl, r->a); break;
+    case TR_SND_ACK_INVALID:  fprintf(f, "[%.3f] Sender %d: RECV ACK with invalid pkt id %d\n", now, fl, r->a); break;
+    case TR_SND_SYN_TIMEOUT:  fprintf(f, "[%.3f] Sender %d: SYN TIMEOUT -> retransmit SYN\n", now, fl); break;
+    case TR_SND_TIMEOUT:      fprintf(f, "[%.3f] Sender %d: TIMEOUT pkt #%d -> retransmit\n", now, fl, r->a); break;
+    case TR_RCV_SYN:          fprintf(f, "[%.3f] Receiver %d: RECV SYN -> SEND SYNACK\n", now, fl); break;
+    case TR_RCV_ACK:          fprintf(f, "[%.3f] Receiver %d: RECV ACK (connection established)\n", now, fl); break;
+    case TR_RCV_DATA_INVALID: fprintf(f, "[%.3f] Receiver %d: RECV DATA with invalid id %d\n", now, fl, r->a); break;
+    case TR_RCV_DATA:         fprintf(f, "[%.3f] Receiver %d: RECV DATA #%d -> SEND ACK\n", now, fl, r->a); break;
+    case TR_RCV_FINISH:       fprintf(f, "[%.3f] Receiver %d: RECV FINISH\n", now, fl); break;
+    case TR_RCV_ALL_FINISHED: fprintf(f, "[%.3f] Receiver: all %d flows finished -> stop simulation\n", now, r->a); break;
+    case TR_NET_CORRUPT:      fprintf(f, "[%.3f] Network: CORRUPTED pkt id %d -> %d\n", now, r->a, r->b); break;
+    case TR_LINK_DROP:        fprintf(f, "[%.3f] Network: TAIL DROP pkt id %d, link buffer of node %d full\n", now, r->a, r->b); break;
+    case TR_SND_CUM_ACK:      fprintf(f, "[%.3f] Sender %d: RECV ACK up to pkt #%d (sack 0x%02x)\n", now, fl, r->a, r->b); break;
+    case TR_RCV_DATA_HELD:    fprintf(f, "[%.3f] Receiver %d: RECV DATA #%d (ACK delayed)\n", now, fl, r->a); break;
+    case TR_NET_DROP:         fprintf(f, "[%.3f] Network: DROPPED pkt id %d to node %d (trace)\n", now, r->a, r->b); break;
+    case TR_LINK_LOSS:        fprintf(f, "[%.3f] Network: LOST pkt id %d on topology link %d\n", now, r->a, r->b); break;
+    default:                  fprintf(f, "[%.3f] unknown trace record %d\n", now, r->code); break;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+Trace of what the handlers do (one record per line of the old verbose output).
+
+A trace point is TRACE(ctx, level, code, flow, a, b). It is compiled out when level is above
+TRACE_COMPILE_LEVEL (make DEFS=-DTRACE_COMPILE_LEVEL=0 removes all of them), and at run
+time it costs one comparison when level is above ctx->trace.level.
+
+The records go either
+  - straight to stdout as text (the default, same lines as before), or
+  - as fixed-size binary records into a ring buffer of the context, which a writer thread
+    empties into a file (--trace FILE). The handlers never format anything nor wait for
+    the disk, they only copy 24 bytes. trace_decode turns the file back into the text lines.
+*/
+
+#define TRACE_OFF   0
+#define TRACE_INFO  1   // connection and flow events: SYN, SYNACK, FINISH, SYN timeouts
+#define TRACE_DEBUG 2   // every packet: DATA, ACK, drops, corruptions, retransmissions
+
+#ifndef TRACE_COMPILE_LEVEL
+#define TRACE_COMPILE_LEVEL TRACE_DEBUG
+#endif
+
+enum TraceCode {
+    TR_SND_SYN,            // flow
+    TR_SND_SYNACK,         // flow
+    TR_SND_LOCAL_DROP,     // flow, a = packet
+    TR_SND_DATA,           // flow, a = packet
+    TR_SND_ACK,            // flow, a = packet
+    TR_SND_ACK_INVALID,    // flow, a = packet id received
+    TR_SND_SYN_TIMEOUT,    // flow
+    TR_SND_TIMEOUT,        // flow, a = packet
+    TR_RCV_SYN,            // flow
+    TR_RCV_ACK,            // flow
+    TR_RCV_DATA_INVALID,   // flow, a = packet id received
+    TR_RCV_DATA,           // flow, a = packet
+    TR_RCV_FINISH,         // flow
+    TR_RCV_ALL_FINISHED,   // a = number of flows
+    TR_NET_CORRUPT,        // a = packet id, b = corrupted id
+    TR_NET_DROP,           // flow, a = packet id (-1 = control packet), b = destination node (--net-trace drop)
+    TR_LINK_DROP,          // flow, a = packet id (-1 = control packet), b = node whose link buffer was full (the sender on a shared link)
+    TR_SND_CUM_ACK,        // flow, a = next packet the receiver expects, b = selective ACK bits (window mode)
+    TR_RCV_DATA_HELD,      // flow, a = packet, its ACK is delayed (window mode)
+    TR_LINK_LOSS,          // flow, a = packet id (-1 = control packet), b = topology link that lost it
+    TR_N_CODES
+};
+
+typedef struct {
+    double         time;
+    int            flow;
+    int            a;
+    int            b;
+    unsigned short code;
+    unsigned short level;
+} TraceRecord;   // 24 bytes
+
+#define TRACE_MAGIC   "SIMTRC01"   // first 8 bytes of a binary trace, followed by the records
+#define TRACE_RING    (1 << 16)    // records in the ring of one context (power of 2)
+
+typedef struct Tracer {
+    int           level;     // run-time level, TRACE_OFF = nothing
+    int           binary;    // 0 = text on stdout, 1 = records to the writer thread
+    FILE         *out;
+    TraceRecord  *ring;
+    atomic_ulong  head;      // next record the simulation writes (only the simulation moves it)
+    atomic_ulong  tail;      // next record the writer takes (only the writer moves it)
+    atomic_int    done;      // set by trace_close, the writer empties the ring and stops
+    pthread_t     writer;
+    long          records;   // records emitted
+    long          waits;     // times the ring was full and the simulation had to wait
+} Tracer;
+
+// path NULL = text mode. Returns 0 if the file or the ring could not be set up.
+int  trace_open(Tracer *t, int level, const char *path);
+void trace_close(Tracer *t);   // waits until every record is in the file
+void trace_emit(Tracer *t, int level, int code, double time, int flow, int a, int b);
+void trace_print(FILE *f, const TraceRecord *r);   // the text line of a record
+
+#define TRACE(ctx, lvl, code, flow, a, b)                                              \
+    do {                                                                               \
+        if ((lvl) <= TRACE_COMPILE_LEVEL && (lvl) <= (ctx)->trace.level)               \
+            trace_emit(&(ctx)->trace, (lvl), (code), sim_seconds((ctx), (ctx)->now),   \
+                       (flow), (a), (b));                                              \
+    } while (0)
+
+#endif
@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+/* Prints a binary trace written with sim --trace FILE as the text lines of the normal output.
+   usage: trace_decode FILE [LEVEL]   (LEVEL: 1 = connection events only, 2 = everything) */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s TRACE_FILE [LEVEL]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int level = argc > 2 ? atoi(argv[2]) : TRACE_DEBUG;
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    char magic[8];
+    if (fread(magic, 1, 8, in) != 8 || memcmp(magic, TRACE_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s: not a simulator trace\n", argv[1]);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    // records are read by blocks, the file can be much bigger than the memory
+    TraceRecord buf[4096];
+    size_t n;
+    while ((n = fread(buf, sizeof(TraceRecord), 4096, in)) > 0)
+        for (size_t i = 0; i < n; i++)
+            if (buf[i].level <= level) trace_print(stdout, &buf[i]);
+    fclose(in);
+    return 0;
+}